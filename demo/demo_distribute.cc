@@ -28,6 +28,7 @@
 #include <cstring>
 #include <cassert>
 
+#include "rdmini/running_stats.h"
 #include "rdmini/sampler.h"
 #include "rdmini/timer.h"
 #include "rdmini/util/iterator.h"
@@ -367,66 +368,6 @@ void distribute_generic(unsigned c, RNG &R,
     for (auto i: remainder) ++bin[i];
 }
 
-// Running statistics: mean, variance, extrema.
-
-struct running_stats {
-    running_stats() { clear(); }
-
-    double mean() const { return m; }
-    double variance() const { return n<2?0:m2/(n-1); }
-    double cv()  const { return std::sqrt(variance())/mean(); }
-    double min() const { return xmin; }
-    double max() const { return xmax; }
-
-    void clear() { 
-        n=0;
-        m=0;
-        m2=0;
-        xmin=0;
-        xmax=0;
-    }
-
-    void insert(double x) {
-        double s=x-m;
-
-        ++n;
-        m+=s/n;
-        m2+=s*(x-m);
-
-        if (!n || xmin>x) xmin=x;
-        if (!n || xmax<x) xmax=x;
-    }
-
-    int n;
-    double m,m2;
-    double xmin,xmax;
-};
-
-struct running_cov {
-    running_cov() { clear(); }
-
-    double covariance() { return n<1?0:cn/n; }
-
-    void clear() {
-        n=0;
-        mx=my=cn=0;
-    }
-
-    void insert(double x,double y) {
-        double dx=x-mx;
-        double dy=y-my;
-
-        ++n;
-        mx+=dx/n;
-        my+=dy/n;
-
-        cn+=(x-mx)*dy;
-    }
-
-    int n;
-    double mx,my,cn;
-};
-
 // Distribution harness:
 //
 // 1. Print output headers for raw output
@@ -469,8 +410,8 @@ void run_test(const cl_args &A) {
 
     std::vector<unsigned> bin(A.b,0);
 
-    std::vector<running_stats> stats; // track mean and cv
-    std::vector<running_cov> cov;     // track covariances
+    std::vector<rdmini::running_stats> stats; // track mean and cv
+    std::vector<rdmini::running_cov> cov;     // track covariances
     if (A.summary) {
         stats.resize(A.b);
         if (A.covariances) cov.resize((A.b*(A.b-1))/2);
@@ -540,7 +481,7 @@ void run_test(const cl_args &A) {
         if (A.covariances) std::cout << ",rmin,rmax";
         std::cout << "\n";
 
-        std::vector<running_stats> cor_stats;
+        std::vector<rdmini::running_stats> cor_stats;
         if (A.covariances) {
             cor_stats.resize(A.b);
             size_t cov_index=0;
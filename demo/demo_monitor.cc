@@ -0,0 +1,231 @@
+/** Live progress of running simulations
+ *
+ * Attaches to the telemetry file published by demo_sim -M, and reports
+ * the progress of the run at regular intervals: instances running and
+ * complete, the range of their simulated times, and the event rate; or,
+ * with -a, the current state of every started instance as CSV.
+ *
+ * The simulation is not slowed or synchronised by monitoring: records
+ * are read through their sequence locks, and the file may be read by
+ * any number of monitors at once.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <thread>
+
+#include "rdmini/telemetry.h"
+#include "rdmini/rdmini_version.h"
+
+const char *demo_monitor_version="0.0.1";
+
+struct fatal_error: std::exception {
+    fatal_error(const std::string &what_str_): what_str(what_str_) {}
+    const char *what() const throw() { return what_str.c_str(); }
+
+private:
+    std::string what_str;
+};
+
+struct usage_error: fatal_error {
+    usage_error(const std::string &what_str_): fatal_error(what_str_) {}
+};
+
+const char *usage_text=
+    "[OPTION] telemetry-file\n"
+    "  -i SECONDS  Report every SECONDS seconds (default 1)\n"
+    "  -n N        Stop after N reports\n"
+    "  -a          Report the state of every started instance\n"
+    "\n"
+    "  -h          Print usage information\n"
+    "  -V          Print version information\n"
+    "\nReports continue until every instance is complete, or for N reports.\n"
+    "Summary lines give the elapsed time, the numbers of running and\n"
+    "complete instances, the minimum, mean and maximum simulated time over\n"
+    "started instances (and the percentage of the end time, if known), the\n"
+    "total number of events and the event rate since the previous report.\n"
+    "With -a, each report is a CSV table of instance,status,time,events and\n"
+    "the published observables.\n";
+
+struct cl_args {
+    std::string telemetry_file;
+    double interval=1;
+    size_t n_reports=0;
+    bool all_instances=false;
+
+    bool help=false;
+    bool version=false;
+};
+
+cl_args parse_cl_args(int argc,char **argv) {
+    cl_args A;
+
+    enum parse_state_enum { no_opt, opt_i, opt_n } parse_state = no_opt;
+    bool has_opt_i=false;
+    bool has_opt_n=false;
+    bool has_file=false;
+
+    int i=0;
+    while (++i<argc) {
+        const char *arg=argv[i];
+        switch (parse_state) {
+        case no_opt:
+            if (arg[0]=='-') {
+                switch (arg[1]) {
+                case 'i':
+                    parse_state=opt_i;
+                    break;
+                case 'n':
+                    parse_state=opt_n;
+                    break;
+                case 'a':
+                    A.all_instances=true;
+                    break;
+                case 'h':
+                    A.help=true; // and return!
+                    return A;
+                case 'V':
+                    A.version=true; // and return!
+                    return A;
+                default:
+                    throw usage_error("unrecognized option "+std::string(arg));
+                }
+            }
+            else {
+                if (has_file) throw usage_error("unexpected argument");
+                A.telemetry_file=arg;
+                has_file=true;
+            }
+            break;
+        case opt_i:
+            if (has_opt_i)
+                throw usage_error("-i specified multiple times");
+            A.interval=std::stod(arg);
+            if (!(A.interval>0))
+                throw usage_error("report interval must be positive");
+            has_opt_i=true;
+            parse_state=no_opt;
+            break;
+        case opt_n:
+            if (has_opt_n)
+                throw usage_error("-n specified multiple times");
+            A.n_reports=std::stoul(arg);
+            has_opt_n=true;
+            parse_state=no_opt;
+            break;
+        }
+    }
+
+    if (parse_state!=no_opt)
+        throw usage_error("missing option argument");
+
+    if (!A.help && !A.version && !has_file)
+        throw usage_error("missing telemetry file");
+
+    return A;
+}
+
+const char *status_name(rdmini::telemetry_format::status_type s) {
+    switch (s) {
+    case rdmini::telemetry_format::running: return "running";
+    case rdmini::telemetry_format::complete: return "complete";
+    default: return "pending";
+    }
+}
+
+int main(int argc, char **argv) {
+    const char *basename=strrchr(argv[0],'/');
+    basename=basename?basename+1:argv[0];
+
+    try {
+        cl_args A=parse_cl_args(argc,argv);
+
+        if (A.help) {
+            std::cout << "Usage: " << basename << " " << usage_text;
+            return 0;
+        }
+
+        if (A.version) {
+            std::cout << basename << " version " << demo_monitor_version << "\n";
+            std::cout << "rdmini library version " << rdmini::rdmini_version << "\n";
+            return 0;
+        }
+
+        rdmini::telemetry_reader R(A.telemetry_file);
+        rdmini::telemetry_reader::snapshot s;
+
+        typedef std::chrono::steady_clock clock;
+        auto start=clock::now();
+        auto next_report=start;
+        double last_elapsed=0;
+        uint64_t last_events=0;
+
+        for (size_t report=1; ; ++report) {
+            double elapsed=std::chrono::duration<double>(clock::now()-start).count();
+
+            size_t n_running=0,n_complete=0,n_torn=0;
+            double t_min=std::numeric_limits<double>::infinity(),t_max=0,t_sum=0;
+            uint64_t events=0;
+
+            if (A.all_instances) {
+                std::cout << "instance,status,time,events";
+                for (const auto &name: R.observable_names()) std::cout << ',' << name;
+                std::cout << "\n";
+            }
+
+            for (size_t i=0; i<R.n_instances(); ++i) {
+                if (!R.read(i,s)) {
+                    ++n_torn;
+                    continue;
+                }
+                if (s.status==rdmini::telemetry_format::pending) continue;
+
+                ++(s.status==rdmini::telemetry_format::complete?n_complete:n_running);
+                t_min=std::min(t_min,s.t);
+                t_max=std::max(t_max,s.t);
+                t_sum+=s.t;
+                events+=s.n_events;
+
+                if (A.all_instances) {
+                    std::cout << i << ',' << status_name(s.status) << ',' << s.t << ',' << s.n_events;
+                    for (double v: s.observables) std::cout << ',' << v;
+                    std::cout << "\n";
+                }
+            }
+
+            size_t n_started=n_running+n_complete;
+            std::cout << "# " << elapsed << "s: running " << n_running << ", complete " << n_complete << "/" << R.n_instances();
+            if (n_started) {
+                std::cout << ", time " << t_min << " " << t_sum/n_started << " " << t_max;
+                if (R.t_end()>0) std::cout << " (" << std::min(100.0,100*t_min/R.t_end()) << "%)";
+            }
+            std::cout << ", events " << events;
+            if (report>1 && elapsed>last_elapsed) std::cout << " (" << (events-last_events)/(elapsed-last_elapsed) << "/s)";
+            if (n_torn) std::cout << ", unreadable " << n_torn;
+            std::cout << std::endl;
+
+            last_elapsed=elapsed;
+            last_events=events;
+
+            if (n_complete==R.n_instances() || (A.n_reports && report>=A.n_reports)) break;
+
+            next_report+=std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(A.interval));
+            std::this_thread::sleep_until(next_report);
+        }
+    }
+    catch (usage_error &E) {
+        std::cerr << basename << ": " << E.what() << "\n";
+        std::cerr << "Usage: " << basename << " " << usage_text;
+        return 2;
+    }
+    catch (std::exception &E) {
+        std::cerr << basename << ": " << E.what() << "\n";
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,309 @@
+/** Reconstruct trajectories from event traces
+ *
+ * Reads an event trace written by demo_sim -e, and replays the recorded
+ * events of each instance from the initial state of the model, writing
+ * samples in the CSV format of demo_sim. No random numbers are drawn:
+ * the samples are those of the recorded run, at any sample interval, and
+ * observables not defined in that run can be derived from the trace.
+ */
+
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#include "rdmini/event_trace.h"
+#include "rdmini/parallel_ssa.h"
+#include "rdmini/rdmodel.h"
+#include "rdmini/util/output_buffer.h"
+#include "rdmini/rdmini_version.h"
+
+const char *demo_replay_version="0.0.1";
+
+using ssa=rdmini::parallel_ssa<3>;
+
+struct fatal_error: std::exception {
+    fatal_error(const std::string &what_str_): what_str(what_str_) {}
+    const char *what() const throw() { return what_str.c_str(); }
+
+private:
+    std::string what_str;
+};
+
+struct usage_error: fatal_error {
+    usage_error(const std::string &what_str_): fatal_error(what_str_) {}
+};
+
+const char *usage_text=
+    "[OPTION] [model-file]\n"
+    "  -e FILE     Replay the event trace FILE (required)\n"
+    "  -m MODEL    Load the model named MODEL\n"
+    "  -t TIME     Replay to TIME simulated seconds (required)\n"
+    "  -d TIME     Sample every TIME seconds\n"
+    "  -i N        Replay only instance N\n"
+    "  -O OBS      Define observable OBS (as demo_sim)\n"
+    "  -X          Write observables instead of population counts\n"
+    "\n"
+    "  -h          Print usage information\n"
+    "  -V          Print version information\n"
+    "\nThe model must be that of the recorded run. Samples are taken as by\n"
+    "demo_sim -t TIME -d TIME; events after the last recorded event of an\n"
+    "instance are taken not to have occurred.\n";
+
+struct cl_args {
+    std::string model_file;
+    std::string model_name;
+    std::string event_file;
+    double t_end=0;
+    double sample_delta=0;
+    bool has_instance=false;
+    uint64_t instance=0;
+    std::vector<std::string> observables;
+    bool observables_only=false;
+
+    bool help=false;
+    bool version=false;
+};
+
+cl_args parse_cl_args(int argc,char **argv) {
+    cl_args A;
+
+    enum parse_state_enum { no_opt, opt_e, opt_m, opt_t, opt_d, opt_i, opt_O } parse_state = no_opt;
+    bool has_opt_e=false;
+    bool has_opt_m=false;
+    bool has_opt_t=false;
+    bool has_opt_d=false;
+    bool has_file=false;
+
+    int i=0;
+    while (++i<argc) {
+        const char *arg=argv[i];
+        switch (parse_state) {
+        case no_opt:
+            if (arg[0]=='-') {
+                switch (arg[1]) {
+                case 'e':
+                    parse_state=opt_e;
+                    break;
+                case 'm':
+                    parse_state=opt_m;
+                    break;
+                case 't':
+                    parse_state=opt_t;
+                    break;
+                case 'd':
+                    parse_state=opt_d;
+                    break;
+                case 'i':
+                    parse_state=opt_i;
+                    break;
+                case 'O':
+                    parse_state=opt_O;
+                    break;
+                case 'X':
+                    A.observables_only=true;
+                    break;
+                case 'h':
+                    A.help=true; // and return!
+                    return A;
+                case 'V':
+                    A.version=true; // and return!
+                    return A;
+                default:
+                    throw usage_error("unrecognized option "+std::string(arg));
+                }
+            }
+            else {
+                if (has_file) throw usage_error("unexpected argument");
+                A.model_file=arg;
+                has_file=true;
+            }
+            break;
+        case opt_e:
+            if (has_opt_e)
+                throw usage_error("-e specified multiple times");
+            A.event_file=arg;
+            has_opt_e=true;
+            parse_state=no_opt;
+            break;
+        case opt_m:
+            if (has_opt_m)
+                throw usage_error("-m specified multiple times");
+            A.model_name=arg;
+            has_opt_m=true;
+            parse_state=no_opt;
+            break;
+        case opt_t:
+            if (has_opt_t)
+                throw usage_error("-t specified multiple times");
+            A.t_end=std::stod(arg);
+            has_opt_t=true;
+            parse_state=no_opt;
+            break;
+        case opt_d:
+            if (has_opt_d)
+                throw usage_error("-d specified multiple times");
+            A.sample_delta=std::stod(arg);
+            if (!(A.sample_delta>0))
+                throw usage_error("sample interval must be positive");
+            has_opt_d=true;
+            parse_state=no_opt;
+            break;
+        case opt_i:
+            if (A.has_instance)
+                throw usage_error("-i specified multiple times");
+            A.instance=std::stoull(arg);
+            A.has_instance=true;
+            parse_state=no_opt;
+            break;
+        case opt_O:
+            A.observables.push_back(arg);
+            parse_state=no_opt;
+            break;
+        }
+    }
+
+    if (parse_state!=no_opt)
+        throw usage_error("missing option argument");
+
+    if (!A.help && !A.version) {
+        if (!has_opt_e) throw usage_error("missing event trace");
+        if (!has_opt_t) throw usage_error("missing end time");
+    }
+
+    return A;
+}
+
+// write one sample of instance slot 0, as demo_sim
+void emit_state(rdmini::output_buffer &B,const ssa &S,uint64_t instance,double t,size_t n_cells,bool observables_only) {
+    if (observables_only) {
+        B.put_uint(instance);
+        B.put(',');
+        B.put_double(t);
+        for (double v: S.observables(0)) {
+            B.put(',');
+            if (v==std::floor(v) && std::fabs(v)<9.0e15) B.put_int((int64_t)v);
+            else B.put_double(v);
+        }
+        B.put('\n');
+        return;
+    }
+
+    auto counts=S.counts(0);
+    size_t n_species=counts.size()/n_cells;
+    size_t offset=0;
+    for (size_t cell=0; cell<n_cells; ++cell) {
+        B.put_uint(instance);
+        B.put(',');
+        B.put_double(t);
+        B.put(',');
+        B.put_uint(cell);
+        for (size_t s=0; s<n_species; ++s) {
+            B.put(',');
+            B.put_int((ssa::count_type)counts[offset++]);
+        }
+        B.put('\n');
+    }
+}
+
+int main(int argc, char **argv) {
+    const char *basename=strrchr(argv[0],'/');
+    basename=basename?basename+1:argv[0];
+
+    try {
+        cl_args A=parse_cl_args(argc,argv);
+
+        if (A.help) {
+            std::cout << "Usage: " << basename << " " << usage_text;
+            return 0;
+        }
+
+        if (A.version) {
+            std::cout << basename << " version " << demo_replay_version << "\n";
+            std::cout << "rdmini library version " << rdmini::rdmini_version << "\n";
+            return 0;
+        }
+
+        rdmini::rd_model M;
+        if (A.model_file.empty() || A.model_file=="-")
+            M=rdmini::rd_model_read(std::cin,A.model_name);
+        else {
+            std::ifstream file(A.model_file);
+            if (!file) throw fatal_error("unable to open file for reading");
+
+            M=rdmini::rd_model_read(file,A.model_name);
+        }
+
+        for (const auto &spec: A.observables) {
+            try {
+                M.observables.insert(rdmini::parse_observable(M,spec));
+            }
+            catch (rdmini::model_io_error &E) {
+                throw usage_error(E.what());
+            }
+        }
+        if (A.observables_only && M.observables.empty()) throw usage_error("-X requires observables");
+
+        rdmini::event_trace trace(A.event_file);
+
+        ssa S(1,M);
+        if (trace.n_processes()!=S.process_count() || trace.n_populations()!=S.population_size())
+            throw fatal_error("event trace does not match model");
+
+        std::vector<uint64_t> instances;
+        if (A.has_instance) instances.push_back(A.instance);
+        else instances=trace.instances();
+
+        // sample times follow the arithmetic of demo_sim -t -d
+        double dt=A.sample_delta>0?A.sample_delta:A.t_end;
+        std::vector<double> sample_times;
+        for (double t=0; t<A.t_end; ) sample_times.push_back(t+=dt);
+
+        rdmini::output_buffer B;
+        if (A.observables_only) {
+            B.write("instance,time");
+            for (const auto &obs: M.observables) B.stream() << ',' << obs.name;
+        }
+        else {
+            B.write("instance,time,cell");
+            for (const auto &species: M.species) B.stream() << ',' << species.name;
+        }
+        B.put('\n');
+
+        for (auto i: instances) {
+            S.reset_instance(0,0);
+            emit_state(B,S,i,0,M.n_cells(),A.observables_only);
+
+            // events and stimuli at a sample time precede the sample
+            auto sample=[&](double t) {
+                S.apply_stimuli(0,t);
+                emit_state(B,S,i,t,M.n_cells(),A.observables_only);
+            };
+
+            size_t next=0;
+            trace.replay(i,[&](uint32_t k,double t) {
+                for (; next<sample_times.size() && sample_times[next]<t; ++next) sample(sample_times[next]);
+                if (next<sample_times.size()) S.replay(0,k,t);
+            });
+            for (; next<sample_times.size(); ++next) sample(sample_times[next]);
+
+            if (B.size()>=(1<<20)) B.write_to(STDOUT_FILENO);
+        }
+        B.write_to(STDOUT_FILENO);
+    }
+    catch (usage_error &E) {
+        std::cerr << basename << ": " << E.what() << "\n";
+        std::cerr << "Usage: " << basename << " " << usage_text;
+        return 2;
+    }
+    catch (std::exception &E) {
+        std::cerr << basename << ": " << E.what() << "\n";
+        return 1;
+    }
+
+    return 0;
+}
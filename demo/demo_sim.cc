@@ -1,19 +1,60 @@
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <cerrno>
 #include <cstring>
 #include <cstddef>
+#include <cstdint>
+#include <exception>
 #include <iostream>
 #include <fstream>
 #include <sstream>
+#include <set>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 #include "rdmini/timer.h"
+#include "rdmini/delta_codec.h"
+#include "rdmini/ensemble_summary.h"
+#include "rdmini/event_trace.h"
+#include "rdmini/telemetry.h"
+#include "rdmini/timeline.h"
 #include "rdmini/rdmodel.h"
 #include "rdmini/parallel_ssa.h"
+#include "rdmini/philox.h"
+#include "rdmini/running_stats.h"
+#include "rdmini/trajectory_file.h"
+#include "rdmini/trajectory_sampling.h"
+#include "rdmini/variates.h"
+#include "rdmini/util/arena.h"
+#include "rdmini/util/numa.h"
+#include "rdmini/util/output_buffer.h"
+#include "rdmini/util/spsc_queue.h"
+#include "rdmini/util/work_stealing.h"
 #include "rdmini/rdmini_version.h"
 
 const char *demo_sim_version="0.0.2";
 
 // fix maximum order of reactions here:
-using ssa=rdmini::parallel_ssa<3>;
+using ssa=rdmini::parallel_ssa<3,rdmini::event_recording_observer>;
 namespace timer=rdmini::timer;
 
 // throw to clean-up and exit
@@ -30,6 +71,31 @@ struct usage_error: fatal_error {
     usage_error(const std::string &what_str_): fatal_error(what_str_) {}
 };
 
+// upper bound on ensemble size when running to a target RSE
+constexpr size_t default_max_adaptive_instances=1<<20;
+
+// default number of instances per wave in adaptive runs
+size_t default_wave_size() {
+#ifdef _OPENMP
+    return 16*omp_get_max_threads();
+#else
+    return 16;
+#endif
+}
+
+// default number of instance slots in streaming mode
+size_t default_slots() {
+#ifdef _OPENMP
+    return omp_get_max_threads();
+#else
+    return 1;
+#endif
+}
+
+// default number of slices into which each instance's run is split
+// for work-stealing scheduling
+constexpr size_t default_slices_per_instance=16;
+
 // usage info
 const char *usage_text=
     "[OPTION] [model-file]\n"
@@ -38,12 +104,89 @@ const char *usage_text=
     "  -t TIME     Run simulation for TIME simulated seconds\n"
     "  -d N/TIME   Sample simulation every N steps or TIME seconds\n"
     "  -P N        Run N independent instances\n"
+    "  -R TARGET   Run instances until TARGET is met (see below)\n"
+    "  -w N        Launch instances in waves of N (with -R)\n"
+    "  -S N        Stream instances through N reusable instance slots\n"
+    "  -s SEED     Seed random number generation with SEED (default 0)\n"
+    "  -k N        Schedule instances in slices of N sample intervals\n"
+    "  -A          Pin threads to CPUs\n"
+    "  -H          Back per-instance state with huge pages\n"
+    "  -F K        Run instances in K worker processes\n"
+    "  -o FILE     Write samples to FILE in binary trajectory format\n"
+    "  -O OBS      Define observable OBS (see below)\n"
+    "  -X          Write observables instead of population counts\n"
+    "  -E          Write ensemble summaries of observables instead of samples\n"
+    "  -b LO:HI:N  Include histograms of N bins over [LO,HI) in summaries\n"
+    "  -e FILE     Record the events of each instance to FILE\n"
+    "  -M FILE     Publish live progress of each instance to FILE\n"
+    "  -p          Print a profile of the run by region\n"
+    "  -J FILE     Write a profile of the run by region to FILE as JSON\n"
+    "  -C          Count hardware events in profiled regions (implies -p)\n"
+    "  -T FILE     Write a timeline of thread activity to FILE\n"
     "  -v          Verbose output\n"
     "  -B          Batch output\n"
     "\n"
     "  -h          Print usage information\n"
     "  -V          Print version information\n"
-    "\nOne of -n or -t must be specified.\n";
+    "\nOne of -n or -t must be specified.\n"
+    "\nTargets have the form SPECIES[@TIME]:RSE, and are met when the relative\n"
+    "standard error of the mean total count of SPECIES at TIME (default: the\n"
+    "end time) is at most RSE. -R may be given multiple times, and requires -t.\n"
+    "An observable may be named in place of SPECIES.\n"
+    "With -R, -P gives the maximum number of instances to run (default 1048576).\n"
+    "Without -P, the run stops after the first wave if the samples of a target\n"
+    "are all zero, as its RSE is then infinite.\n"
+    "\nWith -S, or with -R, at most N instances are held in memory at once, and\n"
+    "each trajectory is written out when it completes. The default number of\n"
+    "slots is the number of threads.\n"
+    "\nOtherwise, instance runs are split into slices that are distributed\n"
+    "between threads by work stealing; by default each run is split into 16.\n"
+    "\nEach instance (or slot) is allocated by, and preferentially run on, a\n"
+    "fixed thread; with -A, threads are pinned to CPUs so that this placement\n"
+    "is NUMA-local.\n"
+    "\nWith -F, instances are divided between K forked worker processes, which\n"
+    "share the threads; trajectories are collected in shared memory and written\n"
+    "out in instance order once all workers have finished. With -E, each worker\n"
+    "summarises its own instances, and the summaries are merged. Trajectories\n"
+    "lost to a failed worker are reported, and the exit status is then 1.\n"
+    "\nObservables are weighted sums of species counts over sets of cells, and\n"
+    "are defined in the model file or with -O NAME=TERMS[@CELLSETS], where TERMS\n"
+    "is a list of [WEIGHT*]SPECIES joined by '+', and CELLSETS a comma-separated\n"
+    "list of cell set names (default: all cells); for example\n"
+    "-O 'CaTotal=Ca+2*CaB@spines'. With -X, each sample is one line of the\n"
+    "observable values; -X cannot be combined with -F or -o.\n"
+    "\nWith -E, for each sample time and observable (by default, the total\n"
+    "count of each species), the number of instances, mean, variance, extrema\n"
+    "and estimated quantiles over the ensemble are written as one CSV line,\n"
+    "followed by any histogram: counts below LO, in each bin, and at or above\n"
+    "HI. Summaries are accumulated as samples are produced, without storing\n"
+    "trajectories. -E requires -t, and cannot be combined with -o.\n"
+    "\nEvent traces written with -e record the process and time of every event\n"
+    "of each instance; demo_replay reconstructs trajectories from them. -e\n"
+    "cannot be combined with -F.\n"
+    "\nWith -M, the time, event count and observables of each instance are\n"
+    "published to a shared-memory telemetry file (e.g. in /dev/shm) at every\n"
+    "sample; demo_monitor displays progress from it while the run proceeds.\n"
+    "\nWith -p or -J, time and calls are accumulated by nested region\n"
+    "(initialisation, advance and its event selection and application, and\n"
+    "output) per thread, and summed over threads at the end of the run; the\n"
+    "printed profile goes to stderr. Worker processes of -F are not profiled.\n"
+    "With -C, cycles, instructions, cache, branch and last-level cache misses\n"
+    "are also counted per region where the system allows (see perf_event_open),\n"
+    "and reported with IPC and counts per SSA event over all advance calls.\n"
+    "\nTimelines written with -T are in Chrome trace format, for viewing in\n"
+    "Perfetto or chrome://tracing: a track per thread, with spans for the\n"
+    "initialisation phases, each slice of an instance's run (or each instance,\n"
+    "with -S or -R), output formatting and writes, and waits for work, at\n"
+    "barriers and for I/O. Each thread keeps its latest 65536 spans.\n"
+    "\nIn builds with SSA hot-path counters (make HOT_COUNTERS=1), a summary of\n"
+    "event, notification, selection and draw counts, and the processes with\n"
+    "most events, is written to stderr after the run (not with -F).\n"
+    "\nWith -v, the memory held by the simulator and model is written to\n"
+    "stderr by table, shared and per instance, with an estimate of the number\n"
+    "of instances that fit in physical memory (not with -F).\n"
+    "\nBinary trajectory files written with -o can be converted to CSV with\n"
+    "demo_traj2csv; state dumps from -v are not included.\n";
 
 struct cl_args {
     std::string model_file;
@@ -54,6 +197,26 @@ struct cl_args {
     int verbosity=0;
     bool batch=false;
     int n_instances=1;
+    bool has_max_instances=false;
+    std::vector<std::string> targets;
+    size_t wave_size=0;
+    size_t n_slots=0;
+    uint64_t seed=0;
+    size_t slice_intervals=0;
+    bool pin_threads=false;
+    bool huge_pages=false;
+    size_t n_processes=0;
+    std::string output_file;
+    std::string event_file;
+    std::string telemetry_file;
+    bool profile=false;
+    bool profile_counters=false;
+    std::string profile_file;
+    std::string trace_file;
+    std::vector<std::string> observables;
+    bool observables_only=false;
+    bool summary=false;
+    std::string histogram;
 
     bool help=false;
     bool version=false;
@@ -62,12 +225,23 @@ struct cl_args {
 cl_args parse_cl_args(int argc,char **argv) {
     cl_args A;
 
-    enum parse_state_enum { no_opt, opt_m, opt_n, opt_t, opt_d, opt_P } parse_state = no_opt;
+    enum parse_state_enum { no_opt, opt_m, opt_n, opt_t, opt_d, opt_P, opt_R, opt_w, opt_S, opt_s, opt_k, opt_F, opt_o, opt_O, opt_b, opt_e, opt_M, opt_J, opt_T } parse_state = no_opt;
     bool has_opt_m=false;
     bool has_opt_n=false;
     bool has_opt_t=false;
     bool has_opt_d=false;
     bool has_opt_P=false;
+    bool has_opt_w=false;
+    bool has_opt_S=false;
+    bool has_opt_s=false;
+    bool has_opt_k=false;
+    bool has_opt_F=false;
+    bool has_opt_o=false;
+    bool has_opt_b=false;
+    bool has_opt_e=false;
+    bool has_opt_M=false;
+    bool has_opt_J=false;
+    bool has_opt_T=false;
     bool has_file=false;
 
     int i=0;
@@ -92,12 +266,70 @@ cl_args parse_cl_args(int argc,char **argv) {
                 case 'P':
                     parse_state=opt_P;
                     break;
+                case 'R':
+                    parse_state=opt_R;
+                    break;
+                case 'w':
+                    parse_state=opt_w;
+                    break;
+                case 'S':
+                    parse_state=opt_S;
+                    break;
+                case 's':
+                    parse_state=opt_s;
+                    break;
+                case 'k':
+                    parse_state=opt_k;
+                    break;
+                case 'F':
+                    parse_state=opt_F;
+                    break;
+                case 'o':
+                    parse_state=opt_o;
+                    break;
+                case 'O':
+                    parse_state=opt_O;
+                    break;
+                case 'X':
+                    A.observables_only=true;
+                    break;
+                case 'E':
+                    A.summary=true;
+                    break;
+                case 'b':
+                    parse_state=opt_b;
+                    break;
+                case 'e':
+                    parse_state=opt_e;
+                    break;
+                case 'M':
+                    parse_state=opt_M;
+                    break;
+                case 'p':
+                    A.profile=true;
+                    break;
+                case 'C':
+                    A.profile=true;
+                    A.profile_counters=true;
+                    break;
+                case 'J':
+                    parse_state=opt_J;
+                    break;
+                case 'T':
+                    parse_state=opt_T;
+                    break;
                 case 'v':
                     ++A.verbosity;
                     break;
                 case 'B':
                     A.batch=true;
                     break;
+                case 'A':
+                    A.pin_threads=true;
+                    break;
+                case 'H':
+                    A.huge_pages=true;
+                    break;
                 case 'h':
                     A.help=true; // and return!
                     return A;
@@ -147,6 +379,100 @@ cl_args parse_cl_args(int argc,char **argv) {
                 throw usage_error("-P specified multiple times");
             A.n_instances=std::stoi(arg);
             has_opt_P=true;
+            A.has_max_instances=true;
+            parse_state=no_opt;
+            break;
+        case opt_R:
+            A.targets.push_back(arg);
+            parse_state=no_opt;
+            break;
+        case opt_w:
+            if (has_opt_w)
+                throw usage_error("-w specified multiple times");
+            A.wave_size=std::stoull(arg);
+            if (A.wave_size==0)
+                throw usage_error("wave size must be positive");
+            has_opt_w=true;
+            parse_state=no_opt;
+            break;
+        case opt_S:
+            if (has_opt_S)
+                throw usage_error("-S specified multiple times");
+            A.n_slots=std::stoull(arg);
+            if (A.n_slots==0)
+                throw usage_error("number of slots must be positive");
+            has_opt_S=true;
+            parse_state=no_opt;
+            break;
+        case opt_s:
+            if (has_opt_s)
+                throw usage_error("-s specified multiple times");
+            A.seed=std::stoull(arg);
+            has_opt_s=true;
+            parse_state=no_opt;
+            break;
+        case opt_k:
+            if (has_opt_k)
+                throw usage_error("-k specified multiple times");
+            A.slice_intervals=std::stoull(arg);
+            if (A.slice_intervals==0)
+                throw usage_error("slice length must be positive");
+            has_opt_k=true;
+            parse_state=no_opt;
+            break;
+        case opt_F:
+            if (has_opt_F)
+                throw usage_error("-F specified multiple times");
+            A.n_processes=std::stoull(arg);
+            if (A.n_processes==0)
+                throw usage_error("number of processes must be positive");
+            has_opt_F=true;
+            parse_state=no_opt;
+            break;
+        case opt_o:
+            if (has_opt_o)
+                throw usage_error("-o specified multiple times");
+            A.output_file=arg;
+            has_opt_o=true;
+            parse_state=no_opt;
+            break;
+        case opt_O:
+            A.observables.push_back(arg);
+            parse_state=no_opt;
+            break;
+        case opt_b:
+            if (has_opt_b)
+                throw usage_error("-b specified multiple times");
+            A.histogram=arg;
+            has_opt_b=true;
+            parse_state=no_opt;
+            break;
+        case opt_e:
+            if (has_opt_e)
+                throw usage_error("-e specified multiple times");
+            A.event_file=arg;
+            has_opt_e=true;
+            parse_state=no_opt;
+            break;
+        case opt_M:
+            if (has_opt_M)
+                throw usage_error("-M specified multiple times");
+            A.telemetry_file=arg;
+            has_opt_M=true;
+            parse_state=no_opt;
+            break;
+        case opt_J:
+            if (has_opt_J)
+                throw usage_error("-J specified multiple times");
+            A.profile_file=arg;
+            has_opt_J=true;
+            parse_state=no_opt;
+            break;
+        case opt_T:
+            if (has_opt_T)
+                throw usage_error("-T specified multiple times");
+            A.trace_file=arg;
+            has_opt_T=true;
             parse_state=no_opt;
             break;
         }
@@ -159,124 +485,983 @@ cl_args parse_cl_args(int argc,char **argv) {
 }
 
 
-// TODO: consider ni independent data structures for thread friendliness.
+// Pre-sized output region shared between the worker processes of a
+// multi-process run and their parent. Each instance has a fixed-size
+// record: the number of samples written, a completion flag, and space for
+// n_samples samples, each a time and the population counts. Only the
+// worker running an instance writes its record; the parent reads records
+// after the workers have exited.
+
+struct shared_results {
+    typedef uint32_t count_type;
+
+    shared_results(size_t n_instances_,size_t n_samples_,size_t n_pop_):
+        n_instances(n_instances_), n_samples(n_samples_), n_pop(n_pop_)
+    {
+        sample_stride=rdmini::round_up(sizeof(double)+n_pop*sizeof(count_type),sizeof(double));
+        instance_stride=rdmini::round_up(sizeof(instance_header)+n_samples*sample_stride);
+        size=std::max((size_t)1,n_instances*instance_stride);
+
+        void *p=mmap(nullptr,size,PROT_READ|PROT_WRITE,MAP_SHARED|MAP_ANONYMOUS,-1,0);
+        if (p==MAP_FAILED) throw fatal_error("unable to map shared result region");
+        base=static_cast<char *>(p);
+    }
+
+    shared_results(const shared_results &)=delete;
+    shared_results &operator=(const shared_results &)=delete;
+
+    ~shared_results() { munmap(base,size); }
+
+    struct instance_header {
+        uint64_t n_written;
+        uint64_t complete;
+    };
+
+    instance_header &header(size_t instance) {
+        return *reinterpret_cast<instance_header *>(base+instance*instance_stride);
+    }
+
+    double &sample_time(size_t instance,size_t k) {
+        return *reinterpret_cast<double *>(sample(instance,k));
+    }
+
+    count_type *sample_counts(size_t instance,size_t k) {
+        return reinterpret_cast<count_type *>(sample(instance,k)+sizeof(double));
+    }
+
+    size_t n_instances,n_samples,n_pop;
+    size_t sample_stride,instance_stride;
+
+private:
+    char *base;
+    size_t size;
+
+    char *sample(size_t instance,size_t k) {
+        return base+instance*instance_stride+sizeof(instance_header)+k*sample_stride;
+    }
+};
+
+// Shared region for multi-process ensemble summaries: for each worker
+// process, the number of instances it completed and its summaries, as
+// packed by ensemble_summary::pack(). Its size depends on the number of
+// workers, sample times and observables, but not on the number of
+// instances.
+
+struct shared_summaries {
+    shared_summaries(size_t n_workers_,size_t packed_size_):
+        n_workers(n_workers_), packed_size(packed_size_)
+    {
+        worker_stride=rdmini::round_up(sizeof(worker_header)+packed_size);
+        size=std::max((size_t)1,n_workers*worker_stride);
+
+        void *p=mmap(nullptr,size,PROT_READ|PROT_WRITE,MAP_SHARED|MAP_ANONYMOUS,-1,0);
+        if (p==MAP_FAILED) throw fatal_error("unable to map shared summary region");
+        base=static_cast<char *>(p);
+    }
+
+    shared_summaries(const shared_summaries &)=delete;
+    shared_summaries &operator=(const shared_summaries &)=delete;
+
+    ~shared_summaries() { munmap(base,size); }
+
+    struct worker_header {
+        uint64_t n_complete;  // zero until the summaries are packed
+    };
+
+    worker_header &header(size_t w) {
+        return *reinterpret_cast<worker_header *>(base+w*worker_stride);
+    }
+
+    char *packed(size_t w) { return base+w*worker_stride+sizeof(worker_header); }
+
+    size_t n_workers,packed_size;
+    size_t worker_stride;
+
+private:
+    char *base;
+    size_t size;
+};
+
+// Asynchronous output of samples. Each simulation thread appends samples
+// to its own current block; a full block, or the block at the end of a
+// slice, is handed to the writer thread through that thread's lock-free
+// queue, and returned empty for reuse through a second queue. Blocks are
+// numbered in order of submission and formatted strictly in that order,
+// so the samples of any one instance are written in order however its
+// slices were scheduled. Formatted output is written to a file descriptor
+// by a separate I/O thread with double buffering: the writer fills one
+// buffer while the other is being written. In deferred mode, nothing is written until
+// finish(): samples are held in order, with the counts of each instance
+// delta encoded against its previous sample (see rdmini/delta_codec.h),
+// and formatted at the end.
+// The optional trailer function writes any final output (after the last
+// sample) on the writer thread.
+
+class async_sample_writer {
+public:
+    typedef ssa::count_type count_type;
+    typedef std::function<void (rdmini::output_buffer &,size_t,double,const count_type *)> format_function;
+    typedef std::function<void (rdmini::output_buffer &)> trailer_function;
+
+    static constexpr size_t block_records=256;
+    static constexpr size_t queue_blocks=256;
+    static constexpr size_t flush_bytes=1<<20;
+
+    async_sample_writer(int fd_,size_t width_,format_function format_,size_t n_producers,bool deferred_=false,
+                        trailer_function trailer_=nullptr):
+        fd(fd_), width(width_), format(format_), trailer(trailer_), deferred(deferred_), front(flush_bytes), back(flush_bytes)
+    {
+        for (size_t i=0; i<n_producers; ++i) producers.emplace_back(new producer);
+
+        io_thread=std::thread([this]() { run_io(); });
+        writer_thread=std::thread([this]() { run_writer(); });
+    }
+
+    async_sample_writer(const async_sample_writer &)=delete;
+    async_sample_writer &operator=(const async_sample_writer &)=delete;
+
+    ~async_sample_writer() {
+        try {
+            finish();
+        }
+        catch (...) {}
+
+        for (auto &p: producers) {
+            sample_block *b;
+            while (p->free.try_pop(b)) delete b;
+            delete p->current;
+        }
+    }
+
+    // append a sample from producer thread w
+    template <typename Counts>
+    void append(size_t w,size_t instance,double t,const Counts &counts) {
+        sample_block *b=current(w);
+        b->records.push_back(record{instance,t,b->counts.size(),width});
+        b->counts.insert(b->counts.end(),counts.begin(),counts.end());
+        if (b->records.size()>=block_records) submit(w);
+    }
+
+    // append free text from producer thread w
+    void append_text(size_t w,const char *text,size_t len) {
+        sample_block *b=current(w);
+        b->records.push_back(record{no_instance,0,b->text.size(),len});
+        b->text.append(text,len);
+        if (b->records.size()>=block_records) submit(w);
+    }
+
+    void append_text(size_t w,const std::string &text) { append_text(w,text.data(),text.size()); }
+
+    // hand producer thread w's current block to the writer
+    void submit(size_t w) {
+        producer &p=*producers[w];
+        if (!p.current || p.current->records.empty()) return;
+
+        p.current->seq=next_seq++;
+        while (!p.full.try_push(p.current)) std::this_thread::yield();
+        p.current=nullptr;
+    }
+
+    // Submit any partial blocks, wait for all output to be written, and
+    // stop the writer and I/O threads. Producers must be idle. Rethrows
+    // any error from writing the output.
+    void finish() {
+        if (!writer_thread.joinable()) return;
+
+        for (size_t w=0; w<producers.size(); ++w) submit(w);
+        stopping=true;
+        writer_thread.join();
+        io_thread.join();
+
+        if (io_error) std::rethrow_exception(io_error);
+    }
+
+private:
+    static constexpr size_t no_instance=SIZE_MAX;
+
+    // a sample (counts at offset, width long), or text (at offset, width long)
+    struct record {
+        size_t instance;
+        double t;
+        size_t offset;
+        size_t width;
+    };
+
+    struct sample_block {
+        uint64_t seq=0;
+        std::vector<record> records;
+        std::vector<count_type> counts;
+        std::string text;
+
+        void clear() {
+            records.clear();
+            counts.clear();
+            text.clear();
+        }
+    };
+
+    struct producer {
+        producer(): full(queue_blocks), free(queue_blocks) {}
+
+        rdmini::spsc_queue<sample_block *> full;  // to the writer
+        rdmini::spsc_queue<sample_block *> free;  // back from the writer
+        sample_block *current=nullptr;
+    };
+
+    int fd;
+    size_t width;
+    format_function format;
+    trailer_function trailer;
+    bool deferred;
+
+    // deferred samples: records index text, or encoded counts in data
+    std::vector<record> deferred_records;
+    std::vector<unsigned char> deferred_data;
+    std::string deferred_text;
+    std::unordered_map<size_t,rdmini::delta_encoder<count_type>> deferred_encoders;
+
+    std::vector<std::unique_ptr<producer>> producers;
+    std::atomic<uint64_t> next_seq{0};
+    std::atomic<bool> stopping{false};
+    std::thread writer_thread,io_thread;
+
+    // double buffer: `front` is filled by the writer, `back` is written by
+    // the I/O thread while io_pending.
+    rdmini::output_buffer front,back;
+    bool io_pending=false,writer_done=false;
+    std::exception_ptr io_error;
+    std::mutex io_mutex;
+    std::condition_variable io_cv;
+
+    sample_block *current(size_t w) {
+        producer &p=*producers[w];
+        if (!p.current && !p.free.try_pop(p.current)) p.current=new sample_block;
+        return p.current;
+    }
+
+    void format_block(const sample_block &b) {
+        for (const auto &r: b.records) {
+            if (r.instance==no_instance) front.write(b.text.data()+r.offset,r.width);
+            else format(front,r.instance,r.t,&b.counts[r.offset]);
+        }
+    }
+
+    void defer_block(const sample_block &b) {
+        for (const auto &r: b.records) {
+            if (r.instance==no_instance) {
+                deferred_records.push_back(record{no_instance,0,deferred_text.size(),r.width});
+                deferred_text.append(b.text,r.offset,r.width);
+            }
+            else {
+                auto i=deferred_encoders.find(r.instance);
+                if (i==deferred_encoders.end())
+                    i=deferred_encoders.emplace(r.instance,rdmini::delta_encoder<count_type>(width)).first;
+
+                deferred_records.push_back(record{r.instance,r.t,deferred_data.size(),0});
+                i->second.encode(deferred_data,&b.counts[r.offset]);
+            }
+        }
+    }
+
+    // decode and format the deferred samples in order
+    void format_deferred() {
+        std::unordered_map<size_t,rdmini::delta_decoder<count_type>> decoders;
+        const unsigned char *end=deferred_data.data()+deferred_data.size();
+
+        for (const auto &r: deferred_records) {
+            if (r.instance==no_instance) front.write(deferred_text.data()+r.offset,r.width);
+            else {
+                auto i=decoders.find(r.instance);
+                if (i==decoders.end())
+                    i=decoders.emplace(r.instance,rdmini::delta_decoder<count_type>(width)).first;
+
+                const unsigned char *p=deferred_data.data()+r.offset;
+                format(front,r.instance,r.t,i->second.decode(p,end));
+            }
+            if (front.size()>=flush_bytes) hand_off();
+        }
+    }
+
+    // pass the front buffer to the I/O thread once any previous write is done
+    void hand_off() {
+        rdmini::timeline::span trace("wait io");
+        std::unique_lock<std::mutex> lock(io_mutex);
+        io_cv.wait(lock,[this]() { return !io_pending; });
+        front.swap(back);
+        io_pending=true;
+        io_cv.notify_all();
+    }
+
+    void run_writer() {
+        static const timer::region_id r_format=timer::profile_region("format");
+        rdmini::timeline::name_thread("writer");
+        uint64_t seq=0;
+        unsigned idle=0;
+        for (;;) {
+            bool found=false;
+            for (auto &p: producers) {
+                sample_block **head=p->full.front();
+                if (!head || (*head)->seq!=seq) continue;
+
+                sample_block *b=*head;
+                p->full.pop();
+                if (deferred) defer_block(*b);
+                else {
+                    timer::profile_scope profile(r_format);
+                    rdmini::timeline::span trace("format");
+                    format_block(*b);
+                }
+                b->clear();
+                if (!p->free.try_push(b)) delete b;
+
+                ++seq;
+                found=true;
+            }
+
+            if (!deferred && front.size()>=flush_bytes) hand_off();
+
+            if (found) idle=0;
+            else if (stopping && seq==next_seq) break;
+            else if (++idle<64) std::this_thread::yield();
+            else std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+
+        if (deferred) {
+            timer::profile_scope profile(r_format);
+            rdmini::timeline::span trace("format");
+            format_deferred();
+        }
+        if (trailer) trailer(front);
+        if (!front.empty()) hand_off();
+
+        std::lock_guard<std::mutex> lock(io_mutex);
+        writer_done=true;
+        io_cv.notify_all();
+    }
+
+    void run_io() {
+        static const timer::region_id r_write=timer::profile_region("write");
+        rdmini::timeline::name_thread("io");
+        std::unique_lock<std::mutex> lock(io_mutex);
+        for (;;) {
+            io_cv.wait(lock,[this]() { return io_pending || writer_done; });
+            if (!io_pending) break;
+
+            lock.unlock();
+            try {
+                timer::profile_scope profile(r_write);
+                rdmini::timeline::span trace("write");
+                if (!io_error) back.write_to(fd);
+            }
+            catch (...) {
+                io_error=std::current_exception();
+            }
+            back.clear();
+            lock.lock();
+
+            io_pending=false;
+            io_cv.notify_all();
+        }
+    }
+};
+
+// Options for the output of samples.
+
+struct output_params {
+    bool batch=false;             // hold output until the end of the run
+    bool binary=false;            // binary trajectory format instead of CSV
+    bool observables_only=false;  // observable values instead of counts
+    bool summary=false;           // ensemble summaries instead of samples
+    double dt=0;                  // sample interval (summaries)
+    size_t hist_bins=0;           // histogram bins in summaries, if any,
+    double hist_lo=0,hist_hi=0;   // over [hist_lo,hist_hi)
+};
+
 struct emit_sim {
-    explicit emit_sim(const rdmini::rd_model &M, size_t ni, bool batch_=false, size_t expected_samples=0): n_species(M.n_species()), n_cells(M.n_cells()), n_instances(ni), batch(batch_) {
+    explicit emit_sim(const rdmini::rd_model &M, size_t ni, const output_params &Q=output_params()):
+        n_species(M.n_species()), n_cells(M.n_cells()), n_instances(ni),
+        batch(Q.batch), binary(Q.binary), observables_only(Q.observables_only)
+    {
+        if (Q.summary) {
+            std::vector<std::string> names;
+            for (const auto &obs: M.observables) names.push_back(obs.name);
+            summary.reset(new rdmini::ensemble_summary(names,Q.dt,rdmini::worker_count(),Q.hist_bins,Q.hist_lo,Q.hist_hi));
+        }
+
         // prepare csv-style header
         std::stringstream s;
-        s << "instance,time,cell";
-
-        for (size_t i=0; i<n_species; ++i) 
-            s << ',' << M.species[i].name;
-        
-        s << '\n';
+        if (observables_only) {
+            s << "instance,time";
+            for (const auto &obs: M.observables) s << ',' << obs.name;
+            s << '\n';
+        }
+        else s << rdmini::counts_csv_header(M);
         header=s.str();
 
-        if (batch) {
-            batch_sample_width=n_species*n_cells;
-            batch_samples.reserve(n_instances*expected_samples);
-            batch_count_data.reserve(n_instances*batch_sample_width*expected_samples);
-        }
+        for (size_t i=0; i<n_species; ++i) species_names.push_back(M.species[i].name);
+        for (size_t c=0; c<n_cells; ++c) cell_names.push_back(std::to_string(c));
     }
-    
+
     std::ostream &emit_header(std::ostream &O) {
-        return batch?O:O << header;
+        return batch || binary || summary?O:O << header;
     }
 
-    template <typename PSim>
-    std::ostream &emit_state(std::ostream &O, size_t instance, double t, const PSim &sim) {
-        if (!batch) {
-            for (size_t i=0; i<n_cells; ++i) {
-                O << instance << ',' << t << ',' << i;
-                for (size_t j=0; j<n_species; ++j)
-                    O << ',' << sim.count(instance,j,i);
-                O << '\n';
-            }
+    // Start asynchronous output of samples to file descriptor fd from up
+    // to n_threads threads, identified by rdmini::worker_id(). With batch
+    // output, nothing is written until flush().
+    void start_output(int fd, size_t n_threads=rdmini::worker_count()) {
+        if (summary) return;
+        else if (binary) {
+            encoder.reset(new rdmini::trajectory_encoder(species_names,cell_names));
+            writer.reset(new async_sample_writer(fd,n_species*n_cells,
+                [this](rdmini::output_buffer &B,size_t instance,double t,const ssa::count_type *counts) { encoder->append(B.stream(),instance,t,counts); },
+                n_threads,batch,
+                [this](rdmini::output_buffer &B) { encoder->finish(B.stream()); }));
         }
         else {
-            // consider exposing access to ssa population counts by population index directly
-            #pragma omp critical
-            {
-                size_t offset=batch_count_data.size();
-                batch_sample b={instance, t, offset}; 
-                batch_samples.push_back(b);
+            writer.reset(new async_sample_writer(fd,n_species*n_cells,
+                [this](rdmini::output_buffer &B,size_t instance,double t,const ssa::count_type *counts) { emit_counts(B,instance,t,counts); },
+                n_threads,batch));
+        }
+    }
 
-                batch_count_data.resize(offset+batch_sample_width);
-                const auto &counts=sim.counts(instance);
+    // write one sample of population counts, indexed by cell then species
+    template <typename Counts>
+    void emit_counts(rdmini::output_buffer &B, size_t instance, double t, const Counts &counts) {
+        rdmini::put_counts_csv<ssa::count_type>(B,instance,t,counts,n_cells,n_species);
+    }
 
-                assert(batch_sample_width==counts.size());
-                std::copy(counts.begin(),counts.end(),&batch_count_data[offset]);
+    // write one sample of observable values
+    template <typename Values>
+    void emit_observables(rdmini::output_buffer &B, size_t instance, double t, const Values &values) {
+        B.put_uint(instance);
+        B.put(',');
+        B.put_double(t);
+        for (double v: values) {
+            B.put(',');
+            // integral sums in full, rather than to six digits
+            if (v==std::floor(v) && std::fabs(v)<9.0e15) B.put_int((int64_t)v);
+            else B.put_double(v);
+        }
+        B.put('\n');
+    }
+
+    // emit state of simulator slot `slot`, reported as instance `instance`
+    template <typename PSim>
+    std::ostream &emit_state(std::ostream &O, size_t instance, double t, const PSim &sim, size_t slot) {
+        static const timer::region_id r_output=timer::profile_region("output");
+        timer::profile_scope profile(r_output);
+
+        if (summary) summary->insert(rdmini::worker_id(),t,sim.observables(slot));
+        else if (observables_only) {
+            // few values: format on this thread and pass on as text
+            static thread_local rdmini::output_buffer B(256);
+            B.clear();
+            emit_observables(B,instance,t,sim.observables(slot));
+
+            assert(writer);
+            writer->append_text(rdmini::worker_id(),B.data(),B.size());
+        }
+        else if (shared) {
+            // record in the shared region; only this instance's thread writes it
+            auto &h=shared->header(instance);
+            if (h.n_written<shared->n_samples) {
+                size_t k=h.n_written++;
+                shared->sample_time(instance,k)=t;
+                const auto &counts=sim.counts(slot);
+                std::copy(counts.begin(),counts.end(),shared->sample_counts(instance,k));
             }
         }
+        else {
+            assert(writer);
+            writer->append(rdmini::worker_id(),instance,t,sim.counts(slot));
+        }
 	return O;
     }
 
+    template <typename PSim>
+    std::ostream &emit_state(std::ostream &O, size_t instance, double t, const PSim &sim) {
+        return emit_state(O,instance,t,sim,instance);
+    }
+
+    // Pass the samples emitted by this thread, followed by any other text
+    // written for the slice (not kept in binary output), to the writer.
+    // Slices must end before the same instance is resumed on another thread.
+    void end_slice(const std::string &text="") {
+        if (!writer) return;
+
+        size_t w=rdmini::worker_id();
+        if (!text.empty() && !binary) writer->append_text(w,text);
+        writer->submit(w);
+    }
+
+    // O must write to the output file descriptor
     template <typename PSim>
     std::ostream &flush(std::ostream &O, const PSim &sim) {
-        if (!batch) return O;
-
-        O << header;
-        for (const auto &sample: batch_samples) {
-            size_t offset=sample.count_data_offset;
-            for (size_t cell=0; cell<n_cells; ++cell) {
-                O << sample.instance << ',' << sample.t << ',' << cell;
-                for (size_t s=0; s<n_species; ++s) O << ',' << batch_count_data[offset++];
-                O << '\n';
-            }
+        static const timer::region_id r_flush=timer::profile_region("flush");
+        timer::profile_scope profile(r_flush);
+        rdmini::timeline::span trace("flush");
+
+        if (summary) {
+            summary->write(O);
+            return O << std::flush;
+        }
+        if (batch && !binary) O << header << std::flush;
+        if (writer) {
+            writer->finish();
+            writer.reset();
         }
         return O;
     }
 
-    bool batch;
+    // write out the completed instances in the shared region, in order
+    void emit_shared(int fd) {
+        static const timer::region_id r_write=timer::profile_region("write");
+        timer::profile_scope profile(r_write);
+        rdmini::timeline::span trace("write");
+
+        rdmini::trajectory_encoder traj(species_names,cell_names);
+        rdmini::output_buffer B(async_sample_writer::flush_bytes);
+        if (!binary) B.write(header);
+
+        for (size_t i=0; i<shared->n_instances; ++i) {
+            const auto &h=shared->header(i);
+            if (!h.complete) continue;
+            for (size_t k=0; k<h.n_written; ++k) {
+                if (binary) traj.append(B.stream(),i,shared->sample_time(i,k),shared->sample_counts(i,k));
+                else emit_counts(B,i,shared->sample_time(i,k),shared->sample_counts(i,k));
+            }
+            if (B.size()>=async_sample_writer::flush_bytes) B.write_to(fd);
+        }
+
+        if (binary) traj.finish(B.stream());
+        B.write_to(fd);
+    }
+
+    // shared result region for multi-process runs, or null
+    shared_results *shared=nullptr;
+
     size_t n_species,n_cells,n_instances;
+    bool batch;
+    bool binary;  // binary trajectory format instead of CSV
+    bool observables_only;  // observable values instead of counts
     std::string header;
+    std::vector<std::string> species_names,cell_names;
 
-    struct batch_sample {
-        size_t instance;
-        double t;
-        size_t count_data_offset;
-    };
-    size_t batch_sample_width;
+    std::unique_ptr<rdmini::trajectory_encoder> encoder;
+    std::unique_ptr<async_sample_writer> writer;
+    std::unique_ptr<rdmini::ensemble_summary> summary;
+};
+
+// Relative standard error target on the mean total count of a species
+// at a given time, used to determine the ensemble size adaptively.
+
+struct rse_target {
+    std::string spec;
+    size_t species_id;
+    long observable_id=-1;  // observable in place of species, if >=0
+    double t;
+    double rse;
+    rdmini::running_stats stats;
+
+    bool met() const { return stats.rse()<=rse; }
+};
 
-    std::vector<batch_sample> batch_samples;
-    std::vector<size_t> batch_count_data;
+rse_target parse_target(const std::string &spec,const rdmini::rd_model &M,double t_end) {
+    rse_target target;
+    target.spec=spec;
+
+    auto colon=spec.rfind(':');
+    if (colon==std::string::npos) throw usage_error("missing RSE in target "+spec);
+    target.rse=std::stod(spec.substr(colon+1));
+    if (!(target.rse>0)) throw usage_error("RSE must be positive in target "+spec);
+
+    std::string name=spec.substr(0,colon);
+    target.t=t_end;
+
+    auto at=name.find('@');
+    if (at!=std::string::npos) {
+        target.t=std::stod(name.substr(at+1));
+        name.resize(at);
+    }
+    if (target.t<0 || target.t>t_end) throw usage_error("target time out of range in "+spec);
+
+    auto s_id=M.species.index(name);
+    if (s_id>=0) target.species_id=(size_t)s_id;
+    else {
+        target.observable_id=M.observables.index(name);
+        if (target.observable_id<0) throw usage_error("unknown species or observable in target "+spec);
+    }
+
+    return target;
+}
+
+template <typename PSim>
+double species_total(const PSim &sim,size_t instance,size_t species_id,size_t n_cells) {
+    double total=0;
+    for (size_t c=0; c<n_cells; ++c) total+=sim.count(instance,species_id,c);
+    return total;
+}
+
+// Parameters common to every trajectory in a run.
+
+struct run_params: rdmini::sampling_params {
+    bool verbose=false;
+    rdmini::event_recorder *events=nullptr;  // records events by slot, if set
+    rdmini::telemetry_writer *telemetry=nullptr;  // publishes progress by instance, if set
 };
 
-void run_sim_by_steps(ssa &S,emit_sim &emitter,size_t n,size_t dn,bool verbose) {
+using rdmini::instance_rng;
+using rdmini::make_instance_rng;
+using rdmini::trajectory_cursor;
+
+// Publish the progress of a trajectory at the end of a sample interval,
+// if monitored.
+
+void publish_progress(const ssa &S,const trajectory_cursor &c,const run_params &P,bool complete=false) {
+    if (P.telemetry) S.publish(c.slot,*P.telemetry,c.instance,complete);
+}
+
+// Run at most max_intervals sample intervals of a trajectory from its
+// cursor, writing samples to O; return true if the trajectory is complete.
+//
+// If targets are supplied (sorted by time), the value of each target
+// observable is written to target_values[i] for target i.
+
+bool run_intervals(ssa &S,trajectory_cursor &c,instance_rng &g,emit_sim &emitter,std::ostream &O,const run_params &P,
+                   size_t max_intervals,const std::vector<rse_target> &targets={},double *target_values=nullptr)
+{
+    auto sample=[&](double t,bool last) {
+        emitter.emit_state(O,c.instance,t,S,c.slot);
+        if (P.verbose) O << S;
+        publish_progress(S,c,P,last);
+    };
+
+    if (P.n_events>0) return rdmini::sample_intervals_by_steps(S,c,g,P,max_intervals,sample);
+
+    size_t n_targets=target_values?targets.size():0;
+    return rdmini::sample_intervals_by_time(S,c,g,P,max_intervals,sample,
+        [&](double t_next) {
+            // advance exactly to any target times within this sample interval
+            for (; c.next_target<n_targets && targets[c.next_target].t<=t_next; ++c.next_target) {
+                const auto &target=targets[c.next_target];
+                S.advance(c.slot,target.t,g);
+                target_values[c.next_target]=target.observable_id>=0?
+                    S.observable(c.slot,(size_t)target.observable_id):
+                    species_total(S,c.slot,target.species_id,emitter.n_cells);
+            }
+        });
+}
+
+// Simulate the whole trajectory of instance `instance` in simulator slot
+// `slot` from its current state, writing samples to O.
+
+void run_instance(ssa &S,size_t slot,size_t instance,emit_sim &emitter,std::ostream &O,const run_params &P,
+                  const std::vector<rse_target> &targets={},double *target_values=nullptr)
+{
+    instance_rng g=make_instance_rng(P,instance);
+    trajectory_cursor c(slot,instance);
+    run_intervals(S,c,g,emitter,O,P,SIZE_MAX,targets,target_values);
+}
+
+// Run all instances of S, each split into slices of slice_intervals
+// sample intervals. Slices are scheduled by work stealing, so that
+// threads left without instances of their own take over pending slices
+// of others; slices of any one instance run in order, and each slice's
+// samples are passed to the emitter's writer at the end of the slice. The RNG state of each
+// instance is kept with it between slices, and each instance is
+// requeued on the thread that owns its state.
+
+//
+// Slot p of S simulates instance first_instance+p.
+
+void run_sim(ssa &S,emit_sim &emitter,const run_params &P,size_t slice_intervals,size_t first_instance=0) {
     size_t N=S.instances();
 
-    #pragma omp parallel for
-    for (size_t p=0; p<N; ++p) {
-        std::minstd_rand g(p*20000);
+    std::vector<instance_rng> rngs(N);
+    rdmini::parallel_for_owned(N,[&](size_t p) { rngs[p]=make_instance_rng(P,first_instance+p); });
 
-        double t;
-        for (size_t i=0; i<n; i+=dn) {
-            for (size_t j=0; j<dn; ++j)
-                t=S.advance(p,g);
+    std::vector<trajectory_cursor> tasks;
+    for (size_t p=0; p<N; ++p) tasks.push_back(trajectory_cursor(p,first_instance+p));
+
+    if (P.events) {
+        for (size_t p=0; p<N; ++p) P.events->start(p,first_instance+p,S.time(p));
+    }
+
+    rdmini::run_work_stealing(tasks,
+        [&](trajectory_cursor &c,size_t) {
+            rdmini::timeline::span trace("slice",c.instance);
+            std::ostringstream out;
+            bool done=run_intervals(S,c,rngs[c.slot],emitter,out,P,slice_intervals);
+
+            if (emitter.shared) {
+                if (done) emitter.shared->header(c.instance).complete=1;
+            }
+            else emitter.end_slice(out.str());
+
+            return !done;
+        },
+        [&](size_t slot,size_t n_workers) { return S.instance_owner(slot,n_workers); });
+}
+
+// Number of samples (including the initial state) in each trajectory.
+
+size_t samples_per_instance(const run_params &P) {
+    size_t n=1;
+    if (P.n_events>0) {
+        for (size_t i=0; i<P.n_events; i+=P.dn) ++n;
+    }
+    else {
+        // follows the time arithmetic of rdmini::sample_intervals_by_time
+        for (double t=0; t<P.t_end; t+=P.dt) ++n;
+    }
+    return n;
+}
+
+// Options for multi-process runs.
+
+struct process_params {
+    size_t n_workers=1;
+    size_t slice_intervals=1;
+    bool huge_pages=false;
+    bool pin_threads=false;
+};
+
+// Run instances [0,n_instances) in forked worker processes, each running a
+// contiguous shard of instances with its own simulator and thread team,
+// and recording samples in a shared region pre-sized for every trajectory.
+// Once all workers have exited, the parent writes out each completed
+// trajectory in instance order. A worker that fails or crashes loses only
+// the trajectories it had not completed; failures are reported on stderr.
+// With ensemble summaries, each worker instead reduces its own samples and
+// packs the summaries into its slot of a shared region, whose size does
+// not grow with the number of instances; the parent merges and writes
+// them, and a failed worker loses its whole shard.
+// Returns the number of completed instances.
+//
+// The parent must not have started an OpenMP thread team before calling.
+
+size_t run_sim_multiprocess(const rdmini::rd_model &M,emit_sim &emitter,int out_fd,const run_params &P,size_t n_instances,const process_params &Q) {
+    size_t n_samples=samples_per_instance(P);
+    std::unique_ptr<shared_results> results;
+    std::unique_ptr<shared_summaries> summaries;
+    if (emitter.summary) summaries.reset(new shared_summaries(Q.n_workers,emitter.summary->packed_size(n_samples)));
+    else {
+        results.reset(new shared_results(n_instances,n_samples,M.n_species()*M.n_cells()));
+        emitter.shared=results.get();
+    }
+
+    size_t threads_per_worker=std::max((size_t)1,rdmini::worker_count()/Q.n_workers);
+
+    std::vector<pid_t> workers(Q.n_workers,-1);
+    for (size_t w=0; w<Q.n_workers; ++w) {
+        auto shard=rdmini::owned_block(w,Q.n_workers,n_instances);
+
+        pid_t pid=fork();
+        if (pid<0) {
+            std::cerr << "#worker " << w << ": fork failed: " << strerror(errno) << "\n";
+            continue;
+        }
+        if (pid>0) {
+            workers[w]=pid;
+            continue;
+        }
+
+        // worker process
+        int rc=0;
+        try {
+#ifdef _OPENMP
+            omp_set_num_threads((int)threads_per_worker);
+#endif
+            if (Q.pin_threads) rdmini::pin_threads(w*threads_per_worker);
+
+            size_t n=shard.second-shard.first;
+            if (n>0) {
+                ssa S(n,M,0,Q.huge_pages);
+                for (size_t p=0; p<n; ++p) emitter.emit_state(std::cout,shard.first+p,0,S,p);
+                run_sim(S,emitter,P,Q.slice_intervals,shard.first);
 
-            emitter.emit_state(std::cout,p,t,S);
-            if (verbose) std::cout << S;
+                if (summaries) {
+                    emitter.summary->pack(summaries->packed(w),n_samples);
+                    summaries->header(w).n_complete=n;
+                }
+            }
+        }
+        catch (std::exception &E) {
+            std::cerr << "#worker " << w << ": " << E.what() << "\n";
+            rc=1;
         }
+        _exit(rc);
     }
+
+    for (size_t w=0; w<Q.n_workers; ++w) {
+        if (workers[w]<0) continue;
+
+        int status=0;
+        while (waitpid(workers[w],&status,0)<0 && errno==EINTR) {}
+
+        auto shard=rdmini::owned_block(w,Q.n_workers,n_instances);
+        if (WIFSIGNALED(status))
+            std::cerr << "#worker " << w << " (instances " << shard.first << "-" << shard.second-1 << "): killed by signal " << WTERMSIG(status) << "\n";
+        else if (WIFEXITED(status) && WEXITSTATUS(status)!=0)
+            std::cerr << "#worker " << w << " (instances " << shard.first << "-" << shard.second-1 << "): exit status " << WEXITSTATUS(status) << "\n";
+    }
+
+    size_t n_complete=0;
+    if (summaries) {
+        for (size_t w=0; w<Q.n_workers; ++w) {
+            size_t n=summaries->header(w).n_complete;
+            if (n) emitter.summary->merge_packed(summaries->packed(w),n_samples);
+            n_complete+=n;
+        }
+        // (summaries are only written to stdout)
+        emitter.summary->write(std::cout);
+        std::cout << std::flush;
+    }
+    else {
+        emitter.emit_shared(out_fd);
+
+        for (size_t i=0; i<n_instances; ++i) n_complete+=results->header(i).complete!=0;
+        emitter.shared=nullptr;
+    }
+
+    return n_complete;
 }
 
-void run_sim_by_time(ssa &S,emit_sim &emitter,double t_end,double dt,bool verbose) {
-    size_t N=S.instances();
+// Stream instances [first,last) through the instance slots of S, so that
+// memory use is bounded by the number of slots rather than the number of
+// instances. Each slot is reset to the initial model state and reused
+// when its trajectory finishes; run_instance(slot,instance,O) simulates
+// one trajectory, and each completed trajectory is passed to the emitter's
+// writer.
+// Slots are run by the threads that own them.
+
+template <typename RunInstance>
+void run_sim_streaming(ssa &S,emit_sim &emitter,size_t first,size_t last,const run_params &P,RunInstance run_instance) {
+    size_t n_slots=S.instances();
+    size_t next_instance=first;
 
-    #pragma omp parallel for
-    for (size_t p=0; p<N; ++p) {
-        std::minstd_rand g(p*20000); // fix this seeding stuff
+    rdmini::parallel_for_owned(n_slots,[&](size_t slot) {
+        std::ostringstream out;
+        for (;;) {
+            size_t instance;
+            #pragma omp atomic capture
+            instance=next_instance++;
 
-        double t=0;
-        while (t<t_end) {
-            t=S.advance(p,t+dt,g);
+            if (instance>=last) break;
 
-            emitter.emit_state(std::cout,p,t,S);
-            if (verbose) std::cout << S;
+            rdmini::timeline::span trace("instance",instance);
+            S.reset_instance(slot,0);
+            if (P.events) P.events->start(slot,instance,0);
+            emitter.emit_state(std::cout,instance,0,S,slot);
+            run_instance(slot,instance,out);
+
+            emitter.end_slice(out.str());
+            out.str("");
         }
+    });
+}
+
+void run_sim_streaming(ssa &S,emit_sim &emitter,size_t n_instances,const run_params &P) {
+    run_sim_streaming(S,emitter,0,n_instances,P,
+        [&](size_t slot,size_t instance,std::ostream &O) { run_instance(S,slot,instance,emitter,O,P); });
+}
+
+// Launch waves of instances until all targets are met, or until
+// max_instances have been run; returns the number of instances run.
+// Waves are streamed through the instance slots of S.
+//
+// The RSE of a target whose samples are all zero is infinite; with
+// stop_if_zero, the run stops at the end of the wave, with a warning,
+// rather than running max_instances.
+
+size_t run_sim_adaptive(ssa &S,emit_sim &emitter,const run_params &P,
+                        std::vector<rse_target> &targets,size_t max_instances,size_t wave_size,bool stop_if_zero)
+{
+    size_t n_targets=targets.size();
+    std::vector<double> target_values;
+
+    size_t n_run=0;
+    while (n_run<max_instances) {
+        size_t n=std::min(wave_size,max_instances-n_run);
+
+        rdmini::timeline::span trace("wave",n_run);
+        target_values.assign(n*n_targets,0);
+        run_sim_streaming(S,emitter,n_run,n_run+n,P,
+            [&](size_t slot,size_t instance,std::ostream &O) {
+                run_instance(S,slot,instance,emitter,O,P,targets,&target_values[(instance-n_run)*n_targets]);
+            });
+
+        // accumulate in instance order for reproducible estimates
+        for (size_t p=0; p<n; ++p)
+            for (size_t i=0; i<n_targets; ++i) targets[i].stats.insert(target_values[p*n_targets+i]);
+
+        n_run+=n;
+        if (std::all_of(targets.begin(),targets.end(),[](const rse_target &x) { return x.met(); })) break;
+
+        if (stop_if_zero) {
+            auto zero=std::find_if(targets.begin(),targets.end(),
+                [](const rse_target &x) { return x.stats.max()==0 && x.stats.min()==0; });
+            if (zero!=targets.end()) {
+                std::cerr << "#warning: target " << zero->spec << " is zero in all " << n_run
+                          << " instances and cannot be met; give -P to run more\n";
+                break;
+            }
+        }
+    }
+    return n_run;
+}
+
+
+// Memory held by the simulator, the instances' RNG states and the
+// model, by table, and the number of instances that would fit in
+// physical memory.
+
+void print_memory_report(std::ostream &O,const ssa &S,const rdmini::rd_model &M) {
+    rdmini::memory_usage m=S.memory_report();
+    m.add("rng state",0,sizeof(instance_rng));
+    m.add("",M.memory_report());
+    O << m;
+
+    long pages=sysconf(_SC_PHYS_PAGES),page_size=sysconf(_SC_PAGE_SIZE);
+    if (pages>0 && page_size>0) {
+        size_t physical=(size_t)pages*(size_t)page_size;
+        O << "#  about " << m.instances_within(physical) << " instances fit in " << physical << " bytes of physical memory\n";
     }
 }
 
+// Summary of SSA internals, if counted (built with HOT_COUNTERS=1).
+
+constexpr size_t hot_process_report_size=10;
+
+void print_hot_counters(std::ostream &O,const ssa &S,const rdmini::rd_model &M) {
+    if (!rdmini::hot_counters::enabled) return;
+
+    rdmini::hot_counters::print_report(O,rdmini::hot_counters::collect(),S.process_count(),hot_process_report_size,
+        [&](size_t k) { return S.process_name(M,k); });
+}
+
+// Hardware event counts per SSA event, over all advance regions.
+
+void print_event_counts(std::ostream &O,const timer::profile_node &root) {
+    timer::perf_counts counts;
+    uint64_t n_events=0;
+
+    for (const auto &r: root.children) {
+        if (r.name!="advance") continue;
+        counts+=r.counts;
+        for (const auto &c: r.children)
+            if (c.name=="apply") n_events+=c.calls;
+    }
+    if (!counts.valid || !n_events) return;
+
+    O << "#per event:";
+    for (int e=0; e<timer::n_perf_events; ++e) {
+        auto id=(timer::perf_event_id)e;
+        if (counts.has(id)) O << " " << timer::perf_event_name(id) << "=" << (double)counts.value[e]/n_events;
+    }
+    O << " ipc=" << counts.ipc() << "\n";
+}
 
 int main(int argc, char **argv) {
     const char *basename=strrchr(argv[0],'/');
@@ -297,17 +1482,111 @@ int main(int argc, char **argv) {
             return 0;
         }
 
+        // region profile, reported on successful completion
+
+        std::ofstream profile_file;
+        if (!A.profile_file.empty()) {
+            profile_file.open(A.profile_file);
+            if (!profile_file) throw fatal_error("unable to open profile file for writing");
+        }
+        timer::profile_enable(A.profile || profile_file.is_open(),A.profile_counters);
+        if (A.profile_counters && !timer::this_thread_counters().available())
+            std::cerr << basename << ": warning: hardware event counters unavailable\n";
+
+        // timeline, written on successful completion
+
+        std::ofstream trace_file;
+        if (!A.trace_file.empty()) {
+            trace_file.open(A.trace_file);
+            if (!trace_file) throw fatal_error("unable to open timeline file for writing");
+            rdmini::timeline::enable();
+            rdmini::timeline::name_thread("main");
+        }
+
+        auto report_profile=[&]() {
+            if (trace_file.is_open()) {
+                rdmini::timeline::write_chrome_trace(trace_file);
+                if (!trace_file) throw fatal_error("error writing timeline file");
+            }
+            if (A.profile) {
+                timer::print_profile(std::cerr);
+                if (A.profile_counters) print_event_counts(std::cerr,timer::profile_report());
+            }
+            if (profile_file.is_open()) {
+                timer::write_profile_json(profile_file);
+                if (!profile_file) throw fatal_error("error writing profile file");
+            }
+        };
+
         // read in model specification
 
         rdmini::rd_model M;
+        {
+            static const timer::region_id r_read=timer::profile_region("read model");
+            timer::profile_scope profile(r_read);
+            rdmini::timeline::span trace("read model");
 
-        if (A.model_file.empty() || A.model_file=="-")
-            M=rdmini::rd_model_read(std::cin,A.model_name);
-        else {
-            std::ifstream file(A.model_file);
-            if (!file) throw fatal_error("unable to open file for reading");
+            if (A.model_file.empty() || A.model_file=="-")
+                M=rdmini::rd_model_read(std::cin,A.model_name);
+            else {
+                std::ifstream file(A.model_file);
+                if (!file) throw fatal_error("unable to open file for reading");
 
-            M=rdmini::rd_model_read(file,A.model_name);
+                M=rdmini::rd_model_read(file,A.model_name);
+            }
+        }
+
+        for (const auto &spec: A.observables) {
+            try {
+                M.observables.insert(rdmini::parse_observable(M,spec));
+            }
+            catch (rdmini::model_io_error &E) {
+                throw usage_error(E.what());
+            }
+        }
+
+        if (A.observables_only) {
+            if (M.observables.empty()) throw usage_error("-X requires observables");
+            if (A.n_processes>0 || !A.output_file.empty()) throw usage_error("-X cannot be combined with -F or -o");
+        }
+
+        output_params out;
+        out.batch=A.batch;
+        out.binary=!A.output_file.empty();
+        out.observables_only=A.observables_only;
+        out.summary=A.summary;
+
+        if (A.summary) {
+            if (A.n_events>0) throw usage_error("-E requires -t");
+            if (!A.output_file.empty()) throw usage_error("-E cannot be combined with -o");
+
+            // summarise species totals if no observables are defined
+            if (M.observables.empty()) {
+                for (size_t s=0; s<M.n_species(); ++s)
+                    M.observables.insert(rdmini::observable_info{M.species[s].name,{{s,1.0}},{}});
+            }
+        }
+
+        if (!A.histogram.empty()) {
+            if (!A.summary) throw usage_error("-b requires -E");
+
+            std::istringstream spec(A.histogram);
+            char c1=0,c2=0;
+            if (!(spec >> out.hist_lo >> c1 >> out.hist_hi >> c2 >> out.hist_bins) || c1!=':' || c2!=':' || !spec.eof() ||
+                !(out.hist_hi>out.hist_lo) || out.hist_bins==0)
+                throw usage_error("invalid histogram specification "+A.histogram);
+        }
+
+        // (multi-process runs pin threads in each worker)
+        if (A.pin_threads && !A.n_processes && !rdmini::pin_threads())
+            std::cerr << basename << ": warning: unable to pin threads\n";
+
+        // open output: CSV to stdout, or binary trajectory file
+
+        int out_fd=STDOUT_FILENO;
+        if (out.binary) {
+            out_fd=open(A.output_file.c_str(),O_WRONLY|O_CREAT|O_TRUNC,0666);
+            if (out_fd<0) throw fatal_error("unable to open file for writing");
         }
 
         // set up data emitter and timer
@@ -324,33 +1603,177 @@ int main(int argc, char **argv) {
             expected_samples=1+(size_t)(A.t_end/A.sample_delta);
         }
 
-        emit_sim emitter(M,A.n_instances,A.batch,expected_samples);
-        emitter.emit_header(std::cout);
+        run_params P;
+        P.n_events=A.n_events;
+        P.dn=(size_t)A.sample_delta;
+        P.t_end=A.t_end;
+        P.dt=A.sample_delta;
+        P.seed=A.seed;
+        P.verbose=A.verbosity>0;
+
+        out.dt=A.sample_delta;
+
+        size_t slice_intervals=A.slice_intervals;
+        if (!slice_intervals)
+            slice_intervals=std::max((size_t)1,(expected_samples-1+default_slices_per_instance-1)/default_slices_per_instance);
+
+        if (A.n_processes>0 && (A.n_slots>0 || !A.targets.empty() || !A.event_file.empty()))
+            throw usage_error("-F cannot be combined with -S, -R or -e");
+
+        // event recording, by simulator slot
+        std::ofstream event_file;
+        std::unique_ptr<rdmini::event_recorder> events;
+
+        auto record_events=[&](ssa &S) {
+            if (A.event_file.empty()) return;
+
+            event_file.open(A.event_file,std::ios::binary);
+            if (!event_file) throw fatal_error("unable to open event file for writing");
+            events.reset(new rdmini::event_recorder(event_file,S.instances(),S.process_count(),S.population_size()));
+            P.events=events.get();
+            S.observer().recorder=events.get();
+        };
+
+        auto finish_events=[&]() {
+            if (!events) return;
+
+            events->finish();
+            if (!event_file) throw fatal_error("error writing event file");
+        };
+
+        // live telemetry, by instance
+        std::unique_ptr<rdmini::telemetry_writer> telemetry;
+        if (!A.telemetry_file.empty()) {
+            size_t n_records=A.targets.empty() || A.has_max_instances?A.n_instances:default_max_adaptive_instances;
+            std::vector<std::string> names;
+            for (const auto &obs: M.observables) names.push_back(obs.name);
+
+            telemetry.reset(new rdmini::telemetry_writer(A.telemetry_file,n_records,names,P.t_end));
+            P.telemetry=telemetry.get();
+        }
+
+        if (!A.targets.empty()) {
+            if (A.n_events>0) throw usage_error("-R requires -t");
+
+            std::vector<rse_target> targets;
+            for (const auto &spec: A.targets) targets.push_back(parse_target(spec,M,A.t_end));
+            std::stable_sort(targets.begin(),targets.end(),
+                [](const rse_target &a,const rse_target &b) { return a.t<b.t; });
+
+            size_t max_instances=A.has_max_instances?A.n_instances:default_max_adaptive_instances;
+            size_t wave_size=A.wave_size?A.wave_size:default_wave_size();
+            size_t n_slots=std::min(wave_size,A.n_slots?A.n_slots:default_slots());
+
+            emit_sim emitter(M,wave_size,out);
+            emitter.emit_header(std::cout) << std::flush;
+            emitter.start_output(out_fd);
+
+            ssa S(n_slots,M,0,A.huge_pages);
+            record_events(S);
+            if (A.verbosity) print_memory_report(std::cerr,S,M);
+            size_t n_run;
+            {
+                auto _(timer::guard(T));
+                n_run=run_sim_adaptive(S,emitter,P,targets,max_instances,wave_size,!A.has_max_instances);
+            }
+            emitter.flush(std::cout,S);
+            finish_events();
+            print_hot_counters(std::cerr,S,M);
+
+            std::cerr << "#instances: " << n_run << "\n";
+            for (const auto &target: targets) {
+                std::cerr << "#target " << target.spec << ": mean=" << target.stats.mean()
+                          << " rse=" << target.stats.rse() << (target.met()?"":" (not met)") << "\n";
+            }
+            std::cerr << "#elapsed time: " << T.time()*1.0e9 << " [nano s] \n";
+            report_profile();
+            return 0;
+        }
+
+        if (A.n_slots>0) {
+            // stream instances through a bounded pool of instance slots
+            size_t n_slots=std::min(A.n_slots,(size_t)A.n_instances);
+
+            emit_sim emitter(M,A.n_instances,out);
+            emitter.emit_header(std::cout) << std::flush;
+            emitter.start_output(out_fd);
+
+            ssa S(n_slots,M,0,A.huge_pages);
+            record_events(S);
+            if (A.verbosity) print_memory_report(std::cerr,S,M);
+            {
+                auto _(timer::guard(T));
+                run_sim_streaming(S,emitter,A.n_instances,P);
+            }
+            emitter.flush(std::cout,S);
+            finish_events();
+            print_hot_counters(std::cerr,S,M);
+
+            std::cerr << "#elapsed time: " << T.time()*1.0e9 << " [nano s] \n";
+            report_profile();
+            return 0;
+        }
+
+        if (A.n_processes>0) {
+            // fork worker processes; output is collected in shared memory
+            process_params Q;
+            Q.n_workers=A.n_processes;
+            Q.slice_intervals=slice_intervals;
+            Q.huge_pages=A.huge_pages;
+            Q.pin_threads=A.pin_threads;
+
+            out.batch=false;
+            emit_sim emitter(M,A.n_instances,out);
+
+            size_t n_complete;
+            {
+                auto _(timer::guard(T));
+                n_complete=run_sim_multiprocess(M,emitter,out_fd,P,A.n_instances,Q);
+            }
+
+            if (n_complete<(size_t)A.n_instances) {
+                std::cerr << "#incomplete instances: " << A.n_instances-n_complete << "\n";
+                rc=1;
+            }
+            std::cerr << "#elapsed time: " << T.time()*1.0e9 << " [nano s] \n";
+            report_profile();
+            return rc;
+        }
+
+        emit_sim emitter(M,A.n_instances,out);
+        emitter.emit_header(std::cout) << std::flush;
+        emitter.start_output(out_fd);
 
         // set up simulator
             
-        ssa S(A.n_instances,M,0);
+        ssa S(A.n_instances,M,0,A.huge_pages);
+        record_events(S);
+        if (A.verbosity) print_memory_report(std::cerr,S,M);
 
         // emit initial state
 
-        for (size_t i=0; i<A.n_instances; ++i)
-            emitter.emit_state(std::cout,i,0,S);
+        {
+            rdmini::timeline::span trace("initial state");
+            for (size_t i=0; i<A.n_instances; ++i)
+                emitter.emit_state(std::cout,i,0,S);
+        }
 
-        if (A.verbosity) std::cout << S;
+        std::ostringstream state;
+        if (A.verbosity) state << S;
+        emitter.end_slice(state.str());
 
         // run simulation
 
-        if (A.n_events>0) {
-            auto _(timer::guard(T));
-            run_sim_by_steps(S,emitter,A.n_events,(size_t)A.sample_delta,A.verbosity>0);
-        }
-        else {
+        {
             auto _(timer::guard(T));
-            run_sim_by_time(S,emitter,A.t_end,A.sample_delta,A.verbosity>0);
+            run_sim(S,emitter,P,slice_intervals);
         }
         emitter.flush(std::cout,S);
+        finish_events();
+        print_hot_counters(std::cerr,S,M);
 
         std::cerr << "#elapsed time: " << T.time()*1.0e9 << " [nano s] \n";
+        report_profile();
     }
     catch (usage_error &E) {
         std::cerr << basename << ": " << E.what() << "\n";
@@ -0,0 +1,647 @@
+/** Simulation daemon
+ *
+ * Serves simulation jobs over a Unix domain socket. Parsed models, and
+ * simulators built from them, are cached between jobs, so that repeated
+ * jobs on the same model do not re-read the model or, if a large enough
+ * simulator is idle, rebuild its process tables. Idle simulators are
+ * kept up to a bound on their memory. Instances of all jobs are run on
+ * one shared pool of threads.
+ *
+ * A job is a sequence of lines of the form KEY VALUE, terminated by a
+ * line 'run':
+ *
+ *     model FILE [NAME]   model file (path on the server) and model name
+ *     instances N         number of independent instances (default 1)
+ *     time T              run each instance for T simulated seconds, or
+ *     steps N             run each instance for N events
+ *     sample D            sample every D seconds or steps
+ *     seed S              RNG seed (default 0)
+ *
+ * The reply is CSV in the same format as demo_sim, each instance's
+ * trajectory written in one piece as it completes, followed by a line
+ * '#done instances=N elapsed=SECONDS', or by '#error: MESSAGE' on
+ * failure. Trajectories are identical to those of demo_sim with the
+ * same seed. A job consisting of the line 'shutdown' stops the server.
+ *
+ * With -c, demo_simd is a client: it sends a job read from standard input
+ * to the server and copies the reply to standard output.
+ */
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "rdmini/rdmodel.h"
+#include "rdmini/parallel_ssa.h"
+#include "rdmini/trajectory_sampling.h"
+#include "rdmini/util/output_buffer.h"
+#include "rdmini/rdmini_version.h"
+
+const char *demo_simd_version="0.0.1";
+
+using ssa=rdmini::parallel_ssa<3>;
+
+struct fatal_error: std::exception {
+    fatal_error(const std::string &what_str_): what_str(what_str_) {}
+    const char *what() const throw() { return what_str.c_str(); }
+
+private:
+    std::string what_str;
+};
+
+struct usage_error: fatal_error {
+    usage_error(const std::string &what_str_): fatal_error(what_str_) {}
+};
+
+const char *usage_text=
+    "[OPTION] SOCKET\n"
+    "  -j N        Run jobs on N threads (default: number of CPUs)\n"
+    "  -m MIB      Keep up to MIB MiB of idle simulators (default 1024)\n"
+    "  -c          Send job on standard input to server at SOCKET\n"
+    "\n"
+    "  -h          Print usage information\n"
+    "  -V          Print version information\n"
+    "\nJobs are lines KEY VALUE, ending with the line 'run':\n"
+    "  model FILE [NAME]   Model file (on the server) and model name\n"
+    "  instances N         Number of instances (default 1)\n"
+    "  time T | steps N    Run for T simulated seconds or N events\n"
+    "  sample D            Sample every D seconds or events\n"
+    "  seed S              RNG seed (default 0)\n"
+    "The job 'shutdown' stops the server.\n";
+
+struct cl_args {
+    std::string socket_path;
+    size_t n_threads=0;
+    size_t cache_mib=1024;
+    bool client=false;
+
+    bool help=false;
+    bool version=false;
+};
+
+cl_args parse_cl_args(int argc,char **argv) {
+    cl_args A;
+
+    enum parse_state_enum { no_opt, opt_j, opt_m } parse_state = no_opt;
+    bool has_socket=false;
+
+    int i=0;
+    while (++i<argc) {
+        const char *arg=argv[i];
+        switch (parse_state) {
+        case no_opt:
+            if (arg[0]=='-') {
+                switch (arg[1]) {
+                case 'j':
+                    parse_state=opt_j;
+                    break;
+                case 'm':
+                    parse_state=opt_m;
+                    break;
+                case 'c':
+                    A.client=true;
+                    break;
+                case 'h':
+                    A.help=true; // and return!
+                    return A;
+                case 'V':
+                    A.version=true; // and return!
+                    return A;
+                default:
+                    throw usage_error("unrecognized option "+std::string(arg));
+                }
+            }
+            else {
+                if (has_socket) throw usage_error("unexpected argument");
+                A.socket_path=arg;
+                has_socket=true;
+            }
+            break;
+        case opt_j:
+            A.n_threads=std::stoull(arg);
+            if (A.n_threads==0) throw usage_error("number of threads must be positive");
+            parse_state=no_opt;
+            break;
+        case opt_m:
+            A.cache_mib=std::stoull(arg);
+            parse_state=no_opt;
+            break;
+        }
+    }
+
+    if (parse_state!=no_opt)
+        throw usage_error("missing option argument");
+
+    if (!has_socket)
+        throw usage_error("missing socket path");
+
+    return A;
+}
+
+// Write all of buf to fd; false on error (e.g. client gone).
+
+bool write_all(int fd,const char *p,size_t n) {
+    while (n>0) {
+        ssize_t k=send(fd,p,n,MSG_NOSIGNAL);
+        if (k<0) {
+            if (errno==EINTR) continue;
+            return false;
+        }
+        p+=k;
+        n-=k;
+    }
+    return true;
+}
+
+bool write_all(int fd,const std::string &buf) {
+    return write_all(fd,buf.data(),buf.size());
+}
+
+// Fixed pool of threads running queued tasks in order of submission.
+
+class thread_pool {
+public:
+    explicit thread_pool(size_t n) {
+        for (size_t i=0; i<n; ++i) threads.emplace_back([this]() { work(); });
+    }
+
+    ~thread_pool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping=true;
+        }
+        cv.notify_all();
+        for (auto &t: threads) t.join();
+    }
+
+    void submit(std::function<void ()> task) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            tasks.push_back(std::move(task));
+        }
+        cv.notify_one();
+    }
+
+private:
+    std::vector<std::thread> threads;
+    std::deque<std::function<void ()>> tasks;
+    std::mutex mutex;
+    std::condition_variable cv;
+    bool stopping=false;
+
+    void work() {
+        for (;;) {
+            std::function<void ()> task;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                cv.wait(lock,[this]() { return stopping || !tasks.empty(); });
+                if (tasks.empty()) return;
+
+                task=std::move(tasks.front());
+                tasks.pop_front();
+            }
+            task();
+        }
+    }
+};
+
+// Cache of parsed models, keyed by file and model name, and of idle
+// simulators built from them. A cached model is re-read if its file has
+// been modified. A job takes the smallest idle simulator of its model
+// with at least as many instances as the job, and runs in its leading
+// slots, or else a new simulator; the process tables are rebuilt only
+// for the latter. Idle simulators are kept up to max_idle_bytes in all,
+// and up to max_models models, evicting the least recently used first.
+
+class model_cache {
+public:
+    typedef std::unique_ptr<ssa> ssa_ptr;
+
+    static constexpr size_t max_models=16;
+
+    struct entry {
+        time_t mtime;
+        rdmini::rd_model M;
+    };
+
+    explicit model_cache(size_t max_idle_bytes_): max_idle_bytes(max_idle_bytes_) {}
+
+    // Return model and a simulator with at least n_instances instances,
+    // building either as required; the simulator must be returned with
+    // release().
+    std::pair<std::shared_ptr<const entry>,ssa_ptr> acquire(const std::string &path,const std::string &name,size_t n_instances) {
+        struct stat st;
+        if (stat(path.c_str(),&st)!=0) throw fatal_error("unable to open model file "+path);
+
+        std::shared_ptr<const entry> e;
+        ssa_ptr sim;
+        std::vector<ssa_ptr> evicted;  // freed once the lock is released
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            std::string key=path+'\0'+name;
+
+            auto m=std::find_if(models.begin(),models.end(),[&](const model_slot &x) { return x.first==key; });
+            if (m!=models.end() && m->second->mtime!=st.st_mtime) {
+                evict_idle(m->second,evicted);
+                models.erase(m);
+                m=models.end();
+            }
+            if (m==models.end()) {
+                std::ifstream file(path);
+                if (!file) throw fatal_error("unable to open model file "+path);
+
+                std::shared_ptr<entry> fresh(new entry);
+                fresh->mtime=st.st_mtime;
+                fresh->M=rdmini::rd_model_read(file,name);
+                models.emplace_front(key,fresh);
+
+                if (models.size()>max_models) {
+                    evict_idle(models.back().second,evicted);
+                    models.pop_back();
+                }
+            }
+            else models.splice(models.begin(),models,m);
+            e=models.front().second;
+
+            auto best=idle.end();
+            for (auto i=idle.begin(); i!=idle.end(); ++i) {
+                size_t n=i->sim->instances();
+                if (i->model==e && n>=n_instances && (best==idle.end() || n<best->sim->instances())) best=i;
+            }
+            if (best!=idle.end()) {
+                idle_bytes-=best->bytes;
+                sim=std::move(best->sim);
+                idle.erase(best);
+            }
+        }
+
+        if (!sim) sim.reset(new ssa(n_instances,e->M,0));
+        return std::make_pair(e,std::move(sim));
+    }
+
+    void release(const std::shared_ptr<const entry> &e,ssa_ptr sim) {
+        size_t bytes=sim->memory_report().total_bytes();
+        if (bytes>max_idle_bytes) return;
+
+        std::vector<ssa_ptr> evicted;
+        std::lock_guard<std::mutex> lock(mutex);
+        // keep only simulators of models still cached
+        if (std::find_if(models.begin(),models.end(),[&](const model_slot &x) { return x.second==e; })==models.end()) return;
+
+        idle.push_front(idle_simulator{e,std::move(sim),bytes});
+        idle_bytes+=bytes;
+        while (idle_bytes>max_idle_bytes) {
+            idle_bytes-=idle.back().bytes;
+            evicted.push_back(std::move(idle.back().sim));
+            idle.pop_back();
+        }
+    }
+
+private:
+    typedef std::pair<std::string,std::shared_ptr<const entry>> model_slot;
+
+    struct idle_simulator {
+        std::shared_ptr<const entry> model;
+        ssa_ptr sim;
+        size_t bytes;
+    };
+
+    std::mutex mutex;
+    size_t max_idle_bytes;
+    size_t idle_bytes=0;
+    std::list<model_slot> models;       // most recently used first
+    std::list<idle_simulator> idle;     // most recently released first
+
+    void evict_idle(const std::shared_ptr<const entry> &e,std::vector<ssa_ptr> &evicted) {
+        for (auto i=idle.begin(); i!=idle.end(); ) {
+            if (i->model!=e) ++i;
+            else {
+                idle_bytes-=i->bytes;
+                evicted.push_back(std::move(i->sim));
+                i=idle.erase(i);
+            }
+        }
+    }
+};
+
+struct job_spec {
+    std::string model_file;
+    std::string model_name;
+    size_t n_instances=1;
+    double t_end=0;
+    size_t n_events=0;
+    double sample_delta=0;
+    uint64_t seed=0;
+};
+
+// Read request lines from fd up to 'run' or 'shutdown'; returns false
+// for shutdown.
+
+bool read_job(int fd,job_spec &job) {
+    std::string text;
+    char buf[4096];
+    bool has_run=false,has_t=false,has_n=false;
+
+    std::string line;
+    for (;;) {
+        size_t eol=text.find('\n');
+        if (eol==std::string::npos) {
+            ssize_t k=read(fd,buf,sizeof(buf));
+            if (k<0 && errno==EINTR) continue;
+            if (k<=0) {
+                if (text.empty()) break;
+                eol=text.size();
+                text+='\n';
+            }
+            else {
+                text.append(buf,k);
+                continue;
+            }
+        }
+
+        line=text.substr(0,eol);
+        text.erase(0,eol+1);
+
+        std::istringstream in(line);
+        std::string key;
+        if (!(in >> key) || key[0]=='#') continue;
+
+        if (key=="run") { has_run=true; break; }
+        if (key=="shutdown") return false;
+
+        if (key=="model") {
+            // model name is optional
+            if (!(in >> job.model_file)) throw fatal_error("bad value for model");
+            if (!(in >> job.model_name)) job.model_name.clear();
+            continue;
+        }
+        if (key=="instances") in >> job.n_instances;
+        else if (key=="time") { in >> job.t_end; has_t=true; }
+        else if (key=="steps") { in >> job.n_events; has_n=true; }
+        else if (key=="sample") in >> job.sample_delta;
+        else if (key=="seed") in >> job.seed;
+        else throw fatal_error("unrecognized request key "+key);
+
+        if (in.fail()) throw fatal_error("bad value for "+key);
+    }
+
+    if (!has_run) throw fatal_error("incomplete job");
+    if (job.model_file.empty()) throw fatal_error("no model specified");
+    if (has_t==has_n) throw fatal_error("one of time or steps must be specified");
+    if (job.n_instances==0) throw fatal_error("number of instances must be positive");
+
+    if (has_n) {
+        if (job.n_events==0) throw fatal_error("number of steps must be positive");
+        if (job.sample_delta<1) job.sample_delta=1;
+    }
+    else {
+        if (!(job.t_end>0)) throw fatal_error("time must be positive");
+        if (!(job.sample_delta>0)) job.sample_delta=job.t_end;
+    }
+    return true;
+}
+
+// Simulate instance `instance` of a job from its initial state in
+// simulator slot `slot`, as demo_sim would with the same seed, formatting
+// the samples into B.
+
+void run_instance(ssa &S,const rdmini::rd_model &M,const job_spec &job,size_t slot,size_t instance,rdmini::output_buffer &B) {
+    rdmini::sampling_params P;
+    P.n_events=job.n_events;
+    P.dn=(size_t)job.sample_delta;
+    P.t_end=job.t_end;
+    P.dt=job.sample_delta;
+    P.seed=job.seed;
+
+    auto sample=[&](double t,bool) {
+        rdmini::put_counts_csv<ssa::count_type>(B,instance,t,S.counts(slot),M.n_cells(),M.n_species());
+    };
+
+    S.reset_instance(slot,0);
+    sample(0,false);
+
+    rdmini::instance_rng g=rdmini::make_instance_rng(P,instance);
+    rdmini::trajectory_cursor c(slot,instance);
+    rdmini::sample_intervals(S,c,g,P,SIZE_MAX,sample);
+}
+
+// Run one job on the pool, streaming results to fd.
+
+void run_job(int fd,const job_spec &job,model_cache &cache,thread_pool &pool) {
+    auto t0=std::chrono::steady_clock::now();
+
+    auto acquired=cache.acquire(job.model_file,job.model_name,job.n_instances);
+    auto &M=acquired.first->M;
+    ssa &S=*acquired.second;
+
+    std::mutex out_mutex;
+    std::condition_variable done_cv;
+    size_t remaining=job.n_instances;
+    std::string error;  // first failure of an instance, if any
+    bool ok=write_all(fd,rdmini::counts_csv_header(M));
+
+    // an instance that fails is reported once all have finished; the
+    // exception must not escape the pool thread
+    for (size_t i=0; i<job.n_instances; ++i) {
+        pool.submit([&,i]() {
+            rdmini::output_buffer out;
+            std::string failure;
+            try {
+                run_instance(S,M,job,i,i,out);
+            }
+            catch (std::exception &E) {
+                failure="instance "+std::to_string(i)+": "+E.what();
+            }
+            catch (...) {
+                failure="instance "+std::to_string(i)+": unknown error";
+            }
+
+            std::lock_guard<std::mutex> lock(out_mutex);
+            if (!failure.empty()) {
+                if (error.empty()) error=failure;
+            }
+            else if (ok) ok=write_all(fd,out.data(),out.size());
+            if (--remaining==0) done_cv.notify_all();
+        });
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(out_mutex);
+        done_cv.wait(lock,[&]() { return remaining==0; });
+    }
+    cache.release(acquired.first,std::move(acquired.second));
+
+    if (!error.empty()) throw fatal_error(error);
+
+    std::chrono::duration<double> elapsed=std::chrono::steady_clock::now()-t0;
+    std::ostringstream done;
+    done << "#done instances=" << job.n_instances << " elapsed=" << elapsed.count() << "\n";
+    if (ok) write_all(fd,done.str());
+}
+
+int open_socket(const std::string &path,bool listen_mode) {
+    sockaddr_un addr;
+    std::memset(&addr,0,sizeof(addr));
+    addr.sun_family=AF_UNIX;
+    if (path.size()>=sizeof(addr.sun_path)) throw fatal_error("socket path too long");
+    std::strcpy(addr.sun_path,path.c_str());
+
+    int fd=socket(AF_UNIX,SOCK_STREAM,0);
+    if (fd<0) throw fatal_error("unable to create socket");
+
+    if (listen_mode) {
+        unlink(path.c_str());
+        if (bind(fd,(sockaddr *)&addr,sizeof(addr))!=0 || listen(fd,64)!=0) {
+            close(fd);
+            throw fatal_error("unable to listen on "+path+": "+strerror(errno));
+        }
+    }
+    else if (connect(fd,(sockaddr *)&addr,sizeof(addr))!=0) {
+        close(fd);
+        throw fatal_error("unable to connect to "+path+": "+strerror(errno));
+    }
+    return fd;
+}
+
+int run_client(const std::string &path) {
+    int fd=open_socket(path,false);
+
+    std::ostringstream request;
+    request << std::cin.rdbuf();
+    if (!write_all(fd,request.str())) throw fatal_error("unable to send job");
+    shutdown(fd,SHUT_WR);
+
+    // copy reply, noting any error report
+    int rc=0;
+    std::string tail;
+    char buf[65536];
+    for (;;) {
+        ssize_t k=read(fd,buf,sizeof(buf));
+        if (k<0 && errno==EINTR) continue;
+        if (k<=0) break;
+        std::cout.write(buf,k);
+        tail.append(buf,k);
+        if (tail.size()>256) tail.erase(0,tail.size()-256);
+    }
+    close(fd);
+
+    if (tail.find("\n#error")!=std::string::npos || tail.compare(0,6,"#error")==0) rc=1;
+    return rc;
+}
+
+void run_server(const std::string &path,size_t n_threads,size_t cache_bytes) {
+    int listen_fd=open_socket(path,true);
+
+    model_cache cache(cache_bytes);
+    thread_pool pool(n_threads);
+
+    std::mutex conn_mutex;
+    std::condition_variable conn_cv;
+    size_t n_connections=0;
+    bool stopping=false;
+
+    // a shutdown job sets stopping and shuts down the listening socket,
+    // failing the pending accept
+    for (;;) {
+        int fd=accept(listen_fd,nullptr,nullptr);
+        if (fd<0) {
+            if (errno==EINTR) continue;
+
+            std::lock_guard<std::mutex> lock(conn_mutex);
+            if (stopping) break;
+            throw fatal_error("accept failed");
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(conn_mutex);
+            ++n_connections;
+        }
+
+        std::thread([&,fd]() {
+            try {
+                job_spec job;
+                if (read_job(fd,job)) run_job(fd,job,cache,pool);
+                else {
+                    {
+                        std::lock_guard<std::mutex> lock(conn_mutex);
+                        stopping=true;
+                    }
+                    shutdown(listen_fd,SHUT_RDWR);
+                }
+            }
+            catch (std::exception &E) {
+                write_all(fd,std::string("#error: ")+E.what()+"\n");
+            }
+            close(fd);
+
+            std::lock_guard<std::mutex> lock(conn_mutex);
+            if (--n_connections==0) conn_cv.notify_all();
+        }).detach();
+
+        std::lock_guard<std::mutex> lock(conn_mutex);
+        if (stopping) break;
+    }
+
+    // wait for jobs in progress before tearing down the pool
+    std::unique_lock<std::mutex> lock(conn_mutex);
+    conn_cv.wait(lock,[&]() { return n_connections==0; });
+
+    close(listen_fd);
+    unlink(path.c_str());
+}
+
+int main(int argc, char **argv) {
+    const char *basename=strrchr(argv[0],'/');
+    basename=basename?basename+1:argv[0];
+    int rc=0;
+
+    try {
+        cl_args A=parse_cl_args(argc,argv);
+
+        if (A.help) {
+            std::cout << "Usage: " << basename << " " << usage_text;
+            return 0;
+        }
+
+        if (A.version) {
+            std::cout << basename << " version " << demo_simd_version << "\n";
+            std::cout << "rdmini library version " << rdmini::rdmini_version << "\n";
+            return 0;
+        }
+
+        if (A.client) return run_client(A.socket_path);
+
+        size_t n_threads=A.n_threads?A.n_threads:std::max(1u,std::thread::hardware_concurrency());
+        run_server(A.socket_path,n_threads,A.cache_mib<<20);
+    }
+    catch (usage_error &E) {
+        std::cerr << basename << ": " << E.what() << "\n";
+        std::cerr << "Usage: " << basename << " " << usage_text;
+        rc=2;
+    }
+    catch (std::exception &E) {
+        std::cerr << basename << ": " << E.what() << "\n";
+        rc=1;
+    }
+
+    return rc;
+}
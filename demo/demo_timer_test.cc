@@ -28,5 +28,22 @@ int main() {
         sleep(4.8);
     }
     std::cout << "After sleep(4.8) (using guard): T.time()=" << T.time() << "\n";
+
+    timer::perf_counter_group C;
+    if (!C.available()) {
+        std::cout << "Hardware event counters unavailable.\n";
+        return 0;
+    }
+    {
+        auto _=timer::guard(C);
+        volatile double x=0;
+        for (int i=0; i<1000000; ++i) x+=i;
+    }
+    std::cout << "After 10^6 additions (using guard):";
+    for (int e=0; e<timer::n_perf_events; ++e) {
+        auto id=(timer::perf_event_id)e;
+        if (C.counts().has(id)) std::cout << " " << timer::perf_event_name(id) << "=" << C.counts().value[e];
+    }
+    std::cout << " IPC=" << C.counts().ipc() << "\n";
 }
 
@@ -0,0 +1,192 @@
+/** Convert binary trajectory files to CSV
+ *
+ * Reads a trajectory file written by demo_sim -o and writes its samples
+ * in the CSV format of demo_sim, ordered by instance and then time.
+ * With -i, only the given instance is written; with -t, only the last
+ * sample at or before the given time of each instance.
+ */
+
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "rdmini/trajectory_file.h"
+#include "rdmini/rdmini_version.h"
+
+const char *demo_traj2csv_version="0.0.1";
+
+struct fatal_error: std::exception {
+    fatal_error(const std::string &what_str_): what_str(what_str_) {}
+    const char *what() const throw() { return what_str.c_str(); }
+
+private:
+    std::string what_str;
+};
+
+struct usage_error: fatal_error {
+    usage_error(const std::string &what_str_): fatal_error(what_str_) {}
+};
+
+const char *usage_text=
+    "[OPTION] trajectory-file\n"
+    "  -i N        Write only instance N\n"
+    "  -t TIME     Write only the state of each instance at TIME\n"
+    "  -s          Print a summary of the file instead of samples\n"
+    "\n"
+    "  -h          Print usage information\n"
+    "  -V          Print version information\n";
+
+struct cl_args {
+    std::string file;
+    bool has_instance=false;
+    uint64_t instance=0;
+    bool has_time=false;
+    double t=0;
+    bool summary=false;
+
+    bool help=false;
+    bool version=false;
+};
+
+cl_args parse_cl_args(int argc,char **argv) {
+    cl_args A;
+
+    enum parse_state_enum { no_opt, opt_i, opt_t } parse_state = no_opt;
+    bool has_file=false;
+
+    int i=0;
+    while (++i<argc) {
+        const char *arg=argv[i];
+        switch (parse_state) {
+        case no_opt:
+            if (arg[0]=='-') {
+                switch (arg[1]) {
+                case 'i':
+                    parse_state=opt_i;
+                    break;
+                case 't':
+                    parse_state=opt_t;
+                    break;
+                case 's':
+                    A.summary=true;
+                    break;
+                case 'h':
+                    A.help=true; // and return!
+                    return A;
+                case 'V':
+                    A.version=true; // and return!
+                    return A;
+                default:
+                    throw usage_error("unrecognized option "+std::string(arg));
+                }
+            }
+            else {
+                if (has_file) throw usage_error("unexpected argument");
+                A.file=arg;
+                has_file=true;
+            }
+            break;
+        case opt_i:
+            if (A.has_instance)
+                throw usage_error("-i specified multiple times");
+            A.instance=std::stoull(arg);
+            A.has_instance=true;
+            parse_state=no_opt;
+            break;
+        case opt_t:
+            if (A.has_time)
+                throw usage_error("-t specified multiple times");
+            A.t=std::stod(arg);
+            A.has_time=true;
+            parse_state=no_opt;
+            break;
+        }
+    }
+
+    if (parse_state!=no_opt)
+        throw usage_error("missing option argument");
+
+    if (!has_file && !A.help && !A.version)
+        throw usage_error("missing trajectory file");
+
+    return A;
+}
+
+typedef rdmini::trajectory_file::count_type count_type;
+
+// write one sample, as demo_sim
+void emit_counts(std::ostream &O,const rdmini::trajectory_file &F,uint64_t instance,double t,const count_type *counts) {
+    size_t n_species=F.species().size();
+    size_t offset=0;
+    for (size_t cell=0; cell<F.cells().size(); ++cell) {
+        O << instance << ',' << t << ',' << F.cells()[cell];
+        for (size_t s=0; s<n_species; ++s) O << ',' << counts[offset++];
+        O << '\n';
+    }
+}
+
+int main(int argc, char **argv) {
+    const char *basename=strrchr(argv[0],'/');
+    basename=basename?basename+1:argv[0];
+
+    try {
+        cl_args A=parse_cl_args(argc,argv);
+
+        if (A.help) {
+            std::cout << "Usage: " << basename << " " << usage_text;
+            return 0;
+        }
+
+        if (A.version) {
+            std::cout << basename << " version " << demo_traj2csv_version << "\n";
+            std::cout << "rdmini library version " << rdmini::rdmini_version << "\n";
+            return 0;
+        }
+
+        rdmini::trajectory_file F(A.file);
+
+        std::vector<uint64_t> instances;
+        if (A.has_instance) instances.push_back(A.instance);
+        else instances=F.instances();
+
+        if (A.summary) {
+            std::cout << "species: " << F.species().size() << "\n";
+            std::cout << "cells: " << F.cells().size() << "\n";
+            std::cout << "instances: " << instances.size() << "\n";
+            std::cout << "samples: " << F.n_samples() << "\n";
+            std::cout << "chunks: " << F.n_chunks() << "\n";
+            return 0;
+        }
+
+        std::cout << "instance,time,cell";
+        for (const auto &name: F.species()) std::cout << ',' << name;
+        std::cout << '\n';
+
+        if (A.has_time) {
+            std::vector<count_type> counts(F.width());
+            double t;
+            for (auto i: instances)
+                if (F.find(i,A.t,t,counts.data())) emit_counts(std::cout,F,i,t,counts.data());
+        }
+        else {
+            rdmini::trajectory_file::sample_columns samples;
+            for (auto i: instances) {
+                F.read_instance(i,samples);
+                for (size_t k=0; k<samples.size(); ++k)
+                    emit_counts(std::cout,F,i,samples.t[k],samples.sample_counts(k,F.width()));
+            }
+        }
+    }
+    catch (usage_error &E) {
+        std::cerr << basename << ": " << E.what() << "\n";
+        std::cerr << "Usage: " << basename << " " << usage_text;
+        return 2;
+    }
+    catch (std::exception &E) {
+        std::cerr << basename << ": " << E.what() << "\n";
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,160 @@
+#ifndef DELTA_CODEC_H_
+#define DELTA_CODEC_H_
+
+/** Sparse delta encoding of sequences of population count vectors.
+ *
+ * Successive samples of one trajectory usually differ in few of their
+ * counts. Each sample is encoded as a varint header h followed by:
+ *
+ *   h==0 (keyframe): every count, as a zigzag varint;
+ *   h==n+1 (delta):  n changed counts, each as a varint index gap from
+ *                    the previous changed index (the first from -1)
+ *                    followed by the zigzag varint change in value.
+ *
+ * The first sample, every keyframe_interval-th sample after a keyframe,
+ * and any sample that changes half or more of the counts are written as
+ * keyframes, so that decoding can start at any keyframe.
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "rdmini/exceptions.h"
+
+namespace rdmini {
+
+inline uint64_t zigzag_encode(int64_t x) {
+    return ((uint64_t)x<<1)^(uint64_t)(x>>63);
+}
+
+inline int64_t zigzag_decode(uint64_t u) {
+    return (int64_t)(u>>1)^-(int64_t)(u&1);
+}
+
+/** Append x as a little-endian base-128 varint to a byte container. */
+
+template <typename Out>
+void put_varint(Out &out,uint64_t x) {
+    while (x>=0x80) {
+        out.push_back((unsigned char)(x|0x80));
+        x>>=7;
+    }
+    out.push_back((unsigned char)x);
+}
+
+/** Read a varint from [p,end), advancing p. */
+
+inline uint64_t get_varint(const unsigned char *&p,const unsigned char *end) {
+    uint64_t x=0;
+    for (unsigned shift=0; shift<64; shift+=7) {
+        if (p==end) throw invalid_value("truncated varint");
+        unsigned char b=*p++;
+        x|=(uint64_t)(b&0x7f)<<shift;
+        if (!(b&0x80)) return x;
+    }
+    throw invalid_value("overlong varint");
+}
+
+template <typename Count>
+class delta_encoder {
+public:
+    static constexpr size_t default_keyframe_interval=64;
+
+    explicit delta_encoder(size_t width_,size_t keyframe_interval_=default_keyframe_interval):
+        prev(width_), changed(width_), keyframe_interval(keyframe_interval_?keyframe_interval_:1) {}
+
+    size_t width() const { return prev.size(); }
+
+    /** Encode the next sample, width() counts from counts, onto out. */
+    template <typename Out,typename Counts>
+    void encode(Out &out,const Counts &counts) {
+        size_t w=width();
+        size_t n_changed=0;
+        if (since_keyframe>0 && since_keyframe<keyframe_interval) {
+            for (size_t i=0; i<w; ++i)
+                if ((Count)counts[i]!=prev[i]) changed[n_changed++]=i;
+        }
+
+        if (since_keyframe==0 || since_keyframe>=keyframe_interval || 2*n_changed>=w) {
+            put_varint(out,0);
+            for (size_t i=0; i<w; ++i) {
+                prev[i]=(Count)counts[i];
+                put_varint(out,zigzag_encode(prev[i]));
+            }
+            since_keyframe=1;
+            return;
+        }
+
+        put_varint(out,n_changed+1);
+        size_t last=(size_t)-1;
+        for (size_t k=0; k<n_changed; ++k) {
+            size_t i=changed[k];
+            Count x=(Count)counts[i];
+            put_varint(out,i-last-1);
+            put_varint(out,zigzag_encode((int64_t)x-(int64_t)prev[i]));
+            prev[i]=x;
+            last=i;
+        }
+        ++since_keyframe;
+    }
+
+    /** Make the next sample a keyframe. */
+    void reset() { since_keyframe=0; }
+
+private:
+    std::vector<Count> prev;
+    std::vector<size_t> changed;
+    size_t keyframe_interval;
+    size_t since_keyframe=0;
+};
+
+template <typename Count>
+constexpr size_t delta_encoder<Count>::default_keyframe_interval;
+
+template <typename Count>
+class delta_decoder {
+public:
+    explicit delta_decoder(size_t width_): current(width_) {}
+
+    size_t width() const { return current.size(); }
+
+    /** True if the sample encoded at p is a keyframe. */
+    static bool is_keyframe(const unsigned char *p) { return *p==0; }
+
+    /** Decode one sample from [p,end), advancing p; returns the counts.
+     * Decoding must start at a keyframe. */
+    const Count *decode(const unsigned char *&p,const unsigned char *end) {
+        size_t w=width();
+        uint64_t h=get_varint(p,end);
+        if (h==0) {
+            for (size_t i=0; i<w; ++i) current[i]=(Count)zigzag_decode(get_varint(p,end));
+            has_keyframe=true;
+            return current.data();
+        }
+
+        if (!has_keyframe) throw invalid_value("delta decoding must start at a keyframe");
+        if (h-1>w) throw invalid_value("corrupt delta sample");
+
+        size_t i=(size_t)-1;
+        for (uint64_t k=1; k<h; ++k) {
+            i+=get_varint(p,end)+1;
+            if (i>=w) throw invalid_value("corrupt delta sample");
+            current[i]=(Count)((int64_t)current[i]+zigzag_decode(get_varint(p,end)));
+        }
+        return current.data();
+    }
+
+    const Count *values() const { return current.data(); }
+
+    /** Require the next sample to be a keyframe. */
+    void reset() { has_keyframe=false; }
+
+private:
+    std::vector<Count> current;
+    bool has_keyframe=false;
+};
+
+} // namespace rdmini
+
+#endif // ndef DELTA_CODEC_H_
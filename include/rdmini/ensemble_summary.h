@@ -0,0 +1,249 @@
+#ifndef ENSEMBLE_SUMMARY_H_
+#define ENSEMBLE_SUMMARY_H_
+
+/** Ensemble summaries of observables.
+ *
+ * For each sample time and observable, the samples of every instance
+ * are reduced to moments and extrema, a quantile sketch and optionally
+ * a fixed-bin histogram. Each thread reduces the samples it produces
+ * into its own accumulators, and these are merged when the summaries
+ * are written. Samples are matched by time, which is a multiple of the
+ * sample interval; a thread may produce them in any order.
+ *
+ * Summaries can also be packed into a fixed number of bytes of plain
+ * data, independent of the number of samples, and merged from there, so
+ * that processes can reduce their samples separately (see demo_sim -F).
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "rdmini/exceptions.h"
+#include "rdmini/running_stats.h"
+#include "rdmini/tdigest.h"
+#include "rdmini/util/output_buffer.h"
+
+namespace rdmini {
+
+class ensemble_summary {
+public:
+    /** Quantiles reported for each sample time and observable. */
+    static const std::vector<double> &quantiles() {
+        static const std::vector<double> q={0.01,0.05,0.25,0.5,0.75,0.95,0.99};
+        return q;
+    }
+
+    /** Summaries of the named observables, sampled every dt, from up to
+     * n_threads threads; with hist_bins>0, also histograms with that
+     * many bins over [hist_lo,hist_hi). */
+    ensemble_summary(const std::vector<std::string> &names_,double dt_,size_t n_threads,
+                     size_t hist_bins_=0,double hist_lo_=0,double hist_hi_=0):
+        dt(dt_), hist_bins(hist_bins_), hist_lo(hist_lo_), hist_hi(hist_hi_), names(names_),
+        max_centroids(tdigest().max_centroids())
+    {
+        for (size_t i=0; i<n_threads; ++i) threads.emplace_back(new thread_summary);
+    }
+
+    size_t n_observables() const { return names.size(); }
+
+    /** Add a sample of every observable at time t from thread w. */
+    template <typename Values>
+    void insert(size_t w,double t,const Values &values) {
+        thread_summary &T=*threads[w];
+        size_t k=(size_t)std::llround(t/dt);
+        if (k>=T.times.size()) {
+            T.times.resize(k+1);
+            T.summaries.resize((k+1)*names.size(),make_summary());
+        }
+        T.times[k]=t;
+
+        summary *S=&T.summaries[k*names.size()];
+        for (double v: values) {
+            S->stats.insert(v);
+            S->digest.insert(v);
+            if (hist_bins) S->hist.insert(v);
+            ++S;
+        }
+    }
+
+    /** Bytes taken by pack() for up to n_times sample times. */
+    size_t packed_size(size_t n_times) const {
+        return n_times*(sizeof(double)+names.size()*packed_record_size());
+    }
+
+    /** Merge per-thread summaries of sample times [0,n_times) and store
+     * them as plain data in the packed_size(n_times) bytes at p, e.g. in
+     * memory shared with another process. */
+    void pack(char *p,size_t n_times) const {
+        thread_summary all=merged();
+        if (all.times.size()>n_times) throw invalid_value("too many sample times to pack summary");
+        resize(all,n_times);
+
+        std::memcpy(p,all.times.data(),n_times*sizeof(double));
+        p+=n_times*sizeof(double);
+        for (const summary &S: all.summaries) {
+            packed_head head={S.stats,S.digest.min(),S.digest.max(),0};
+            const auto &centroids=S.digest.centroids();
+            head.n_centroids=centroids.size();
+            if (head.n_centroids>max_centroids) throw invalid_value("too many t-digest centroids to pack summary");
+
+            std::memcpy(p,&head,sizeof(head));
+            if (!centroids.empty()) std::memcpy(p+sizeof(head),centroids.data(),centroids.size()*sizeof(tdigest::centroid));
+            if (hist_bins) std::memcpy(p+hist_offset(),S.hist.counts.data(),(hist_bins+2)*sizeof(size_t));
+            p+=packed_record_size();
+        }
+    }
+
+    /** Merge summaries stored by pack() into these. */
+    void merge_packed(const char *p,size_t n_times) {
+        thread_summary &T=*threads[0];
+        if (T.times.size()<n_times) resize(T,n_times);
+
+        const char *times=p;
+        p+=n_times*sizeof(double);
+        for (size_t k=0; k<n_times; ++k) {
+            for (size_t o=0; o<names.size(); ++o) {
+                packed_head head;
+                std::memcpy(&head,p,sizeof(head));
+                if (head.stats.count()>0) {
+                    std::memcpy(&T.times[k],times+k*sizeof(double),sizeof(double));
+
+                    summary &S=T.summaries[k*names.size()+o];
+                    S.stats.merge(head.stats);
+
+                    std::vector<tdigest::centroid> centroids(head.n_centroids);
+                    if (!centroids.empty()) std::memcpy(centroids.data(),p+sizeof(head),centroids.size()*sizeof(tdigest::centroid));
+                    S.digest.merge(centroids.begin(),centroids.end(),head.digest_min,head.digest_max);
+
+                    if (hist_bins) {
+                        fixed_histogram X=make_summary().hist;
+                        std::memcpy(X.counts.data(),p+hist_offset(),(hist_bins+2)*sizeof(size_t));
+                        S.hist.merge(X);
+                    }
+                }
+                p+=packed_record_size();
+            }
+        }
+    }
+
+    /** Merge per-thread summaries and write as CSV. */
+    void write(std::ostream &O) {
+        thread_summary all=merged();
+
+        output_buffer B;
+        B.write("time,observable,n,mean,variance,min,max");
+        for (double q: quantiles()) B.stream() << ",q" << q*100;
+        if (hist_bins) {
+            B.write(",under");
+            for (size_t i=0; i<hist_bins; ++i) B.stream() << ",h" << i;
+            B.write(",over");
+        }
+        B.put('\n');
+
+        for (size_t k=0; k<all.times.size(); ++k) {
+            for (size_t o=0; o<names.size(); ++o) {
+                const summary &S=all.summaries[k*names.size()+o];
+                if (S.stats.count()==0) continue;
+
+                B.put_double(all.times[k]);
+                B.put(',');
+                B.write(names[o]);
+                B.put(',');
+                B.put_uint(S.stats.count());
+                for (double x: {S.stats.mean(),S.stats.variance(),S.stats.min(),S.stats.max()}) {
+                    B.put(',');
+                    B.put_double(x);
+                }
+                for (double q: quantiles()) {
+                    B.put(',');
+                    B.put_double(S.digest.quantile(q));
+                }
+                if (hist_bins) {
+                    for (auto c: S.hist.counts) {
+                        B.put(',');
+                        B.put_uint(c);
+                    }
+                }
+                B.put('\n');
+            }
+        }
+        O.write(B.data(),B.size());
+    }
+
+private:
+    struct summary {
+        running_stats stats;
+        tdigest digest;
+        fixed_histogram hist;
+    };
+
+    struct thread_summary {
+        std::vector<double> times;
+        std::vector<summary> summaries;  // by time, then observable
+    };
+
+    double dt;
+    size_t hist_bins;
+    double hist_lo,hist_hi;
+    std::vector<std::string> names;
+    std::vector<std::unique_ptr<thread_summary>> threads;
+    size_t max_centroids;  // bound on the centroids of a packed digest
+
+    summary make_summary() const {
+        summary S;
+        if (hist_bins) S.hist=fixed_histogram(hist_lo,hist_hi,hist_bins);
+        return S;
+    }
+
+    void resize(thread_summary &T,size_t n_times) const {
+        T.times.resize(n_times);
+        T.summaries.resize(n_times*names.size(),make_summary());
+    }
+
+    thread_summary merged() const {
+        thread_summary all;
+        for (auto &T: threads) {
+            if (T->times.size()>all.times.size()) resize(all,T->times.size());
+            for (size_t k=0; k<T->times.size(); ++k) {
+                if (T->summaries[k*names.size()].stats.count()==0) continue;
+                all.times[k]=T->times[k];
+                for (size_t o=0; o<names.size(); ++o) {
+                    summary &S=all.summaries[k*names.size()+o];
+                    const summary &X=T->summaries[k*names.size()+o];
+                    S.stats.merge(X.stats);
+                    S.digest.merge(X.digest);
+                    if (hist_bins) S.hist.merge(X.hist);
+                }
+            }
+        }
+        return all;
+    }
+
+    // Packed summary of one sample time and observable: the statistics
+    // and digest extrema, followed by max_centroids digest centroids
+    // and any histogram counts.
+    struct packed_head {
+        running_stats stats;
+        double digest_min,digest_max;
+        uint64_t n_centroids;
+    };
+
+    size_t hist_offset() const {
+        return sizeof(packed_head)+max_centroids*sizeof(tdigest::centroid);
+    }
+
+    size_t packed_record_size() const {
+        return hist_offset()+(hist_bins?(hist_bins+2)*sizeof(size_t):0);
+    }
+};
+
+} // namespace rdmini
+
+#endif // ndef ENSEMBLE_SUMMARY_H_
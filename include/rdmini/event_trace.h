@@ -0,0 +1,212 @@
+#ifndef EVENT_TRACE_H_
+#define EVENT_TRACE_H_
+
+/** Event traces.
+ *
+ * An event trace records, for each instance of an ensemble, the sequence
+ * of processes fired and the times at which they fired. A trajectory can
+ * be reconstructed exactly from its initial state by applying the
+ * recorded events in order (see parallel_ssa::replay()), with no random
+ * number generation or process selection.
+ *
+ * The layout, in native byte order, is:
+ *
+ *   header   magic "RDEVTR1", version, and the numbers of processes and
+ *            populations of the simulator that recorded the trace;
+ *   chunks   a chunk header (instance, number of events, the instance
+ *            time before the first event and at the last event, and
+ *            payload size), then the events, padded to 8 bytes.
+ *
+ * Each event is a pair of varints (see delta_codec.h): the process
+ * index, and the difference between the bit patterns of the event time
+ * and of the preceding time. As event times are non-negative and
+ * non-decreasing, this difference is in proportion to the waiting time,
+ * and reconstructs the time exactly.
+ *
+ * Chunks of different instances may be interleaved; the chunks of any
+ * one instance are in time order.
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "rdmini/delta_codec.h"
+#include "rdmini/exceptions.h"
+#include "rdmini/ssa_observer.h"
+#include "rdmini/util/arena.h"
+
+namespace rdmini {
+
+namespace event_trace_format {
+    constexpr char file_magic[8]="RDEVTR1";
+    constexpr uint32_t version=1;
+
+    struct file_header {
+        char magic[8];
+        uint32_t version;
+        uint32_t flags;
+        uint64_t n_processes;
+        uint64_t n_populations;
+    };
+
+    struct chunk_header {
+        uint64_t instance;
+        uint64_t n_events;
+        double t_start;
+        double t_last;
+        uint64_t size;
+        uint64_t reserved;
+    };
+
+    inline uint64_t time_bits(double t) {
+        uint64_t b;
+        std::memcpy(&b,&t,sizeof(b));
+        return b;
+    }
+
+    inline double bits_time(uint64_t b) {
+        double t;
+        std::memcpy(&t,&b,sizeof(t));
+        return t;
+    }
+}
+
+/** Records the events of the instances running in a set of simulator
+ * slots, writing a chunk to the output stream whenever a slot has
+ * buffered chunk_events events.
+ *
+ * Different slots may record concurrently; writes to the stream are
+ * serialised. The events of any one slot must be recorded by one thread
+ * at a time. */
+
+class event_recorder {
+public:
+    static constexpr size_t default_chunk_events=4096;
+
+    event_recorder(std::ostream &O,size_t n_slots,size_t n_processes,size_t n_populations,
+                   size_t chunk_events=default_chunk_events);
+
+    event_recorder(const event_recorder &)=delete;
+    event_recorder &operator=(const event_recorder &)=delete;
+
+    /** Begin recording instance in slot from time t0, writing out any
+     * events pending from the slot's previous instance. */
+    void start(size_t slot,uint64_t instance,double t0);
+
+    /** Record that process k fired at time t in slot. */
+    void record(size_t slot,uint32_t k,double t) {
+        slot_buffer &b=slots[slot];
+        uint64_t tb=event_trace_format::time_bits(t);
+
+        put_varint(b.data,k);
+        put_varint(b.data,tb-b.t_bits);
+        b.t_bits=tb;
+        if (++b.n_events>=chunk_events) write_chunk(b);
+    }
+
+    /** Write out the pending events of slot. */
+    void flush(size_t slot);
+
+    /** Write out all pending events and flush the stream. */
+    void finish();
+
+    uint64_t bytes_written() const { return offset; }
+
+private:
+    struct alignas(cache_line_size) slot_buffer {
+        uint64_t instance=0;
+        uint64_t n_events=0;
+        double t_start=0;
+        uint64_t t_bits=0;
+        std::vector<unsigned char> data;
+    };
+
+    std::ostream &O;
+    size_t chunk_events;
+    std::vector<slot_buffer,aligned_allocator<slot_buffer>> slots;
+
+    std::mutex mutex;
+    uint64_t offset=0;
+
+    void put(const void *data,size_t n);
+    void write_chunk(slot_buffer &b);
+};
+
+/** Observer policy for parallel_ssa (see ssa_observer.h) that records
+ * the events of each simulator instance into the same slot of recorder,
+ * if set. */
+
+struct event_recording_observer: null_observer {
+    event_recorder *recorder=nullptr;
+
+    event_recording_observer() {}
+    explicit event_recording_observer(event_recorder *recorder_): recorder(recorder_) {}
+
+    template <typename K>
+    void on_event(size_t slot,K k,double t,double) {
+        if (recorder) recorder->record(slot,k,t);
+    }
+};
+
+/** Memory-mapped event trace reader. */
+
+class event_trace {
+public:
+    explicit event_trace(const std::string &path);
+    ~event_trace();
+
+    event_trace(const event_trace &)=delete;
+    event_trace &operator=(const event_trace &)=delete;
+
+    size_t n_processes() const { return n_proc; }
+    size_t n_populations() const { return n_pop; }
+
+    /** Distinct instances in the trace, in increasing order. */
+    std::vector<uint64_t> instances() const;
+
+    /** Number of events recorded for instance. */
+    size_t n_events(uint64_t instance) const;
+
+    /** Call f(k,t) for each event of instance, in order, with process
+     * index k and time t; returns the number of events. */
+    template <typename F>
+    size_t replay(uint64_t instance,F f) const {
+        auto i=index.find(instance);
+        if (i==index.end()) return 0;
+
+        size_t n=0;
+        for (const auto *c: i->second) {
+            const unsigned char *p=reinterpret_cast<const unsigned char *>(c+1);
+            const unsigned char *end=p+c->size;
+            uint64_t tb=event_trace_format::time_bits(c->t_start);
+
+            for (uint64_t e=0; e<c->n_events; ++e) {
+                uint64_t k=get_varint(p,end);
+                tb+=get_varint(p,end);
+                if (k>=n_proc) throw trajectory_io_error("process index out of range in event trace");
+                f((uint32_t)k,event_trace_format::bits_time(tb));
+            }
+            n+=c->n_events;
+        }
+        return n;
+    }
+
+private:
+    const char *base=nullptr;
+    size_t size=0;
+    size_t n_proc=0,n_pop=0;
+
+    // chunks of each instance, in order
+    std::map<uint64_t,std::vector<const event_trace_format::chunk_header *>> index;
+};
+
+} // namespace rdmini
+
+#endif // ndef EVENT_TRACE_H_
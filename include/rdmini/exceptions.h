@@ -41,6 +41,20 @@ struct invalid_model: std::runtime_error {
     invalid_model(const char *m): std::runtime_error(m) {}
 };
 
+/** Thrown when a trajectory file or event trace cannot be read or is malformed */
+
+struct trajectory_io_error: std::runtime_error {
+    trajectory_io_error(const std::string &what_arg): std::runtime_error(what_arg) {}
+    trajectory_io_error(const char *m): std::runtime_error(m) {}
+};
+
+/** Thrown when a telemetry region cannot be created, mapped or read */
+
+struct telemetry_error: std::runtime_error {
+    telemetry_error(const std::string &what_arg): std::runtime_error(what_arg) {}
+    telemetry_error(const char *m): std::runtime_error(m) {}
+};
+
 } // namespace rdmini
 
 #endif // ndef RDMINI_EXCEPTIONS_H_
@@ -0,0 +1,173 @@
+#ifndef HOT_COUNTERS_H_
+#define HOT_COUNTERS_H_
+
+/** Counters of SSA internals on the hot path.
+ *
+ * Counts events by process, propensity notifications per event, the
+ * scan length of each selection, propensity updates (and those that
+ * left the propensity unchanged), and selector draws, in per-thread
+ * counters summed when a report is made.
+ *
+ * Counting is compiled in only if RDMINI_HOT_COUNTERS is defined
+ * (`make HOT_COUNTERS=1`, after `make clean`); otherwise the counting
+ * macros expand to nothing, and the instrumented code is unchanged.
+ * The definition must be the same in every translation unit that
+ * instantiates the simulator templates.
+ */
+
+#include <algorithm>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace rdmini {
+namespace hot_counters {
+
+#ifdef RDMINI_HOT_COUNTERS
+constexpr bool enabled=true;
+#else
+constexpr bool enabled=false;
+#endif
+
+enum counter_id {
+    events,             // events applied
+    notifies,           // propensity notifications from applied events
+    selections,         // inverse CDF selections
+    scan_steps,         // propensities scanned by selections
+    propensity_updates, // propensities recomputed and updated in a selector
+    unchanged_updates,  // updates that left the propensity unchanged
+    draws,              // next events drawn for stale selectors
+    stimulus_redraws,   // pending events redrawn after a stimulus
+    n_counters
+};
+
+struct counters {
+    uint64_t count[n_counters]={};
+    std::vector<uint64_t> process_events;   // by process
+    std::vector<uint64_t> process_notifies; // by process
+
+    void event(size_t k,size_t n_notify) {
+        if (k>=process_events.size()) {
+            process_events.resize(k+1);
+            process_notifies.resize(k+1);
+        }
+        ++process_events[k];
+        process_notifies[k]+=n_notify;
+        ++count[events];
+        count[notifies]+=n_notify;
+    }
+
+    counters &operator+=(const counters &x) {
+        for (int c=0; c<n_counters; ++c) count[c]+=x.count[c];
+
+        size_t n=std::max(process_events.size(),x.process_events.size());
+        process_events.resize(n);
+        process_notifies.resize(n);
+        for (size_t k=0; k<x.process_events.size(); ++k) {
+            process_events[k]+=x.process_events[k];
+            process_notifies[k]+=x.process_notifies[k];
+        }
+        return *this;
+    }
+};
+
+namespace impl {
+    struct registry_type {
+        std::mutex mutex;
+        std::vector<std::unique_ptr<counters>> threads;
+    };
+
+    inline registry_type &registry() {
+        static registry_type R;
+        return R;
+    }
+}
+
+/** Counters of the calling thread. */
+inline counters &this_thread() {
+    static thread_local counters *p=nullptr;
+    if (!p) {
+        auto &R=impl::registry();
+        std::lock_guard<std::mutex> lock(R.mutex);
+        R.threads.emplace_back(new counters);
+        p=R.threads.back().get();
+    }
+    return *p;
+}
+
+/** Sum of the counters of all threads; counting threads must be quiescent. */
+inline counters collect() {
+    counters total;
+    auto &R=impl::registry();
+    std::lock_guard<std::mutex> lock(R.mutex);
+    for (const auto &t: R.threads) total+=*t;
+    return total;
+}
+
+/** Zero the counters of all threads; counting threads must be quiescent. */
+inline void reset() {
+    auto &R=impl::registry();
+    std::lock_guard<std::mutex> lock(R.mutex);
+    for (auto &t: R.threads) *t=counters();
+}
+
+/** Print the totals of C, with per-event and per-selection ratios, and
+ * the top_n of n_processes processes by event count, labelled by
+ * name(k). Lines are prefixed with '#'. */
+template <typename ProcessName>
+void print_report(std::ostream &O,const counters &C,size_t n_processes,size_t top_n,ProcessName name) {
+    auto ratio=[](uint64_t a,uint64_t b) { return b? (double)a/b: 0.0; };
+    const uint64_t *n=C.count;
+
+    O << "#hot counters:\n";
+    O << "#  events " << n[events] << ", notifies " << n[notifies]
+      << " (" << ratio(n[notifies],n[events]) << " per event)\n";
+    O << "#  propensity updates " << n[propensity_updates] << " (" << ratio(n[propensity_updates],n[events])
+      << " per event, " << 100*ratio(n[unchanged_updates],n[propensity_updates]) << "% unchanged)\n";
+    O << "#  selections " << n[selections] << ", mean scan length " << ratio(n[scan_steps],n[selections])
+      << " of " << n_processes << " processes\n";
+    O << "#  draws " << n[draws] << " (" << ratio(n[draws],n[events]) << " per event), stimulus redraws "
+      << n[stimulus_redraws] << "\n";
+
+    std::vector<size_t> order;
+    for (size_t k=0; k<C.process_events.size(); ++k)
+        if (C.process_events[k]) order.push_back(k);
+
+    top_n=std::min(top_n,order.size());
+    std::partial_sort(order.begin(),order.begin()+top_n,order.end(),
+        [&](size_t a,size_t b) { return C.process_events[a]>C.process_events[b]; });
+
+    O << "#top " << top_n << " of " << order.size() << " active processes by events:\n";
+    O << "#" << std::setw(9) << "process" << std::setw(16) << "events" << std::setw(10) << "%events"
+      << std::setw(10) << "cum.%" << std::setw(16) << "notifies/event" << "  name\n";
+
+    uint64_t cumulative=0;
+    for (size_t i=0; i<top_n; ++i) {
+        size_t k=order[i];
+        uint64_t e=C.process_events[k];
+        cumulative+=e;
+        O << "#" << std::setw(9) << k << std::setw(16) << e << std::setw(10) << std::fixed << std::setprecision(2)
+          << 100*ratio(e,n[events]) << std::setw(10) << 100*ratio(cumulative,n[events])
+          << std::setw(16) << ratio(C.process_notifies[k],e) << "  " << name(k) << "\n";
+        O.unsetf(std::ios::floatfield);
+        O.precision(6);
+    }
+}
+
+} // namespace hot_counters
+} // namespace rdmini
+
+#ifdef RDMINI_HOT_COUNTERS
+#define RDMINI_HOT_COUNT(c) (++::rdmini::hot_counters::this_thread().count[::rdmini::hot_counters::c])
+#define RDMINI_HOT_COUNT_N(c,n) (::rdmini::hot_counters::this_thread().count[::rdmini::hot_counters::c]+=(n))
+#define RDMINI_HOT_COUNT_EVENT(k,n_notify) (::rdmini::hot_counters::this_thread().event((k),(n_notify)))
+#else
+#define RDMINI_HOT_COUNT(c) ((void)0)
+#define RDMINI_HOT_COUNT_N(c,n) ((void)0)
+#define RDMINI_HOT_COUNT_EVENT(k,n_notify) ((void)0)
+#endif
+
+#endif // ndef HOT_COUNTERS_H_
@@ -0,0 +1,93 @@
+#ifndef MEMORY_USAGE_H_
+#define MEMORY_USAGE_H_
+
+/** Memory accounting for engine data structures.
+ *
+ * A memory_usage is a breakdown of the bytes held by a data structure,
+ * by table, into bytes shared by all instances and bytes per instance,
+ * so that the footprint of any number of instances can be predicted.
+ * Heap sizes are counted by capacity; allocator and alignment overheads
+ * beyond those of the structures' own padding are not included.
+ */
+
+#include <cstddef>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace rdmini {
+
+struct memory_usage {
+    struct entry {
+        std::string name;
+        size_t shared;
+        size_t per_instance;
+    };
+
+    size_t n_instances=0;
+    std::vector<entry> entries;
+
+    memory_usage() {}
+    explicit memory_usage(size_t n_instances_): n_instances(n_instances_) {}
+
+    void add(const std::string &name,size_t shared,size_t per_instance=0) {
+        entries.push_back(entry{name,shared,per_instance});
+    }
+
+    /** Add the entries of x, with names prefixed by prefix. */
+    void add(const std::string &prefix,const memory_usage &x) {
+        for (const auto &e: x.entries) add(prefix+e.name,e.shared,e.per_instance);
+    }
+
+    size_t shared_bytes() const {
+        size_t n=0;
+        for (const auto &e: entries) n+=e.shared;
+        return n;
+    }
+
+    size_t per_instance_bytes() const {
+        size_t n=0;
+        for (const auto &e: entries) n+=e.per_instance;
+        return n;
+    }
+
+    size_t total_bytes() const { return shared_bytes()+n_instances*per_instance_bytes(); }
+
+    /** Number of instances that fit in bytes, with the shared data. */
+    size_t instances_within(size_t bytes) const {
+        size_t shared=shared_bytes(),per_instance=per_instance_bytes();
+        if (bytes<shared) return 0;
+        return per_instance? (bytes-shared)/per_instance: (size_t)-1;
+    }
+
+    friend std::ostream &operator<<(std::ostream &O,const memory_usage &m) {
+        O << "#memory (" << m.n_instances << " instances):\n";
+        O << "#  " << std::left << std::setw(36) << "table" << std::right
+          << std::setw(14) << "shared" << std::setw(14) << "per instance" << "\n";
+        for (const auto &e: m.entries)
+            O << "#  " << std::left << std::setw(36) << e.name << std::right
+              << std::setw(14) << e.shared << std::setw(14) << e.per_instance << "\n";
+        O << "#  " << std::left << std::setw(36) << "total" << std::right
+          << std::setw(14) << m.shared_bytes() << std::setw(14) << m.per_instance_bytes() << "\n";
+        return O << "#  " << m.total_bytes() << " bytes in all\n";
+    }
+};
+
+/** Heap bytes held by a vector, or by a vector of vectors. */
+
+template <typename V,typename A>
+size_t heap_bytes(const std::vector<V,A> &v) {
+    return v.capacity()*sizeof(V);
+}
+
+template <typename V,typename A,typename B>
+size_t heap_bytes(const std::vector<std::vector<V,A>,B> &v) {
+    size_t n=v.capacity()*sizeof(std::vector<V,A>);
+    for (const auto &x: v) n+=heap_bytes(x);
+    return n;
+}
+
+} // namespace rdmini
+
+#endif // ndef MEMORY_USAGE_H_
@@ -1,41 +1,52 @@
 #ifndef PARALLEL_SSA_H_
 #define PARALLEL_SSA_H_
 
+#include <algorithm>
 #include <cstdint>
 #include <limits>
 #include <map>
 #include <stdexcept>
+#include <string>
 #include <type_traits>
+#include <utility>
 #include <vector>
 
 #include "rdmini/rdmodel.h"
 #include "rdmini/exceptions.h"
+#include "rdmini/hot_counters.h"
+#include "rdmini/memory_usage.h"
 #include "rdmini/ssa_direct.h"
+#include "rdmini/ssa_observer.h"
 #include "rdmini/ssa_pp_procsys.h"
+#include "rdmini/telemetry.h"
+#include "rdmini/timeline.h"
+#include "rdmini/timer.h"
+#include "rdmini/util/arena.h"
+#include "rdmini/util/numa.h"
 
 namespace rdmini {
 
-template <unsigned MaxOrder>
+template <unsigned MaxOrder,typename Observer=null_observer>
 struct parallel_ssa {
 private:
     typedef ssa_pp_procsys<MaxOrder> proc_system;
     typedef typename proc_system::key_type proc_index_type;
 
-    typedef ssa_direct<proc_index_type,double> ssa_selector;
+    typedef ssa_direct_view<proc_index_type,double> ssa_selector;
     typedef typename ssa_selector::event_type event_type;
 
     struct ksel_updater_f {
-        ksel_updater_f(proc_system &sys_,ssa_selector &sel_,size_t instance_):
+        ksel_updater_f(proc_system &sys_,ssa_selector sel_,size_t instance_):
             sys(sys_), sel(sel_),instance(instance_) {}
         proc_system &sys;
-        ssa_selector &sel;
+        ssa_selector sel;
         size_t instance;
 
-        void operator()(proc_index_type k) { sel.update(k, sys.propensity(k)); }
+        void operator()(proc_index_type k) { sel.update(k, sys.propensity(k,instance)); }
     };
 
     ksel_updater_f ksel_update(size_t instance) {
-        return ksel_updater_f(ksys,states[instance].ksel,instance);
+        return ksel_updater_f(ksys,ksel(instance),instance);
     }
 
 
@@ -47,10 +58,14 @@ public:
 
     parallel_ssa() {}
 
-    explicit parallel_ssa(size_t n_instances,const rd_model &M, double t0=0) {
-        initialise(n_instances,M,t0);
+    explicit parallel_ssa(size_t n_instances,const rd_model &M, double t0=0, bool huge_pages=false,
+                          Observer observer_=Observer()): obs(std::move(observer_)) {
+        initialise(n_instances,M,t0,huge_pages);
     }
 
+    Observer &observer() { return obs; }
+    const Observer &observer() const { return obs; }
+
     struct kproc_info {
         std::vector<size_t> left_,right_;
         double rate_;
@@ -60,7 +75,11 @@ public:
         double rate() const { return rate_; }
     };
 
-    void initialise(size_t n_instances_,const rd_model &M, double t0) {
+    void initialise(size_t n_instances_,const rd_model &M, double t0, bool huge_pages=false) {
+        static const timer::region_id r_initialise=timer::profile_region("initialise");
+        timer::profile_scope profile(r_initialise);
+        timeline::span trace("initialise");
+
         n_instances=n_instances_;
 
         n_species=M.n_species();
@@ -103,80 +122,289 @@ public:
             }
         }
 
-        ksys=proc_system(n_instances);
+        ksys=proc_system(n_instances,huge_pages);
         ksys.add(kp_set.begin(),kp_set.end());
 
-        states.resize(n_instances);
-        #pragma omp parallel for
-        for (size_t i=0; i<n_instances; ++i) {
-            auto &state=states[i];
+        // observables, as weighted sums over populations
+        std::vector<std::vector<std::pair<size_t,double>>> obs_terms;
+        for (const auto &obs_info: M.observables) {
+            obs_terms.emplace_back();
+            auto &terms=obs_terms.back();
+            auto add_cell=[&](size_t c_id) {
+                for (const auto &sw: obs_info.species) terms.emplace_back(species_to_pop_id(sw.first,c_id),sw.second);
+            };
+
+            if (obs_info.cells.empty())
+                for (size_t c_id=0; c_id<n_cell; ++c_id) add_cell(c_id);
+            else
+                for (size_t c_id: obs_info.cells) add_cell(c_id);
+        }
+        ksys.add_observables(obs_terms.begin(),obs_terms.end());
 
-            state.t=t0;
-            state.stale=true;
+        // stimuli, in time order (stimuli at the same time in model order);
+        // each change of rate switches to a new rate set
+        std::vector<const stimulus_info *> schedule;
+        for (const auto &x: M.stimuli) schedule.push_back(&x);
+        std::stable_sort(schedule.begin(),schedule.end(),
+            [](const stimulus_info *a,const stimulus_info *b) { return a->t<b->t; });
 
-            state.ksel.reset(ksys.size());
+        std::vector<double> rates;
+        for (const auto &ki: kp_set) rates.push_back(ki.rate_);
 
-            // initalise population counts
-            // (later, iterate over list of named cell lists for this)
-            for (size_t s_id=0; s_id<n_species; ++s_id) {
-                double conc=M.species[s_id].concentration;
+        stimuli.clear();
+        for (const stimulus_info *x: schedule) {
+            stimulus stim={x->t,{},0,no_rate_change};
+
+            if (x->kind==stimulus_info::set_rate) {
+                // reaction processes are indexed by cell, then reaction
+                int order=(int)M.reactions[x->reaction_id].left.size();
                 for (size_t c_id=0; c_id<n_cell; ++c_id)
-                    ksys.set_count(species_to_pop_id(s_id,c_id),conc*M.cells[c_id].volume,i);
+                    rates[c_id*n_reac+x->reaction_id]=x->rate*std::pow(M.cells[c_id].volume,1-order);
+                stim.rate_set=ksys.add_rate_set(rates);
+            }
+            else {
+                stim.delta=x->kind==stimulus_info::inject?(long)x->count:-(long)x->count;
+                if (x->cells.empty())
+                    for (size_t c_id=0; c_id<n_cell; ++c_id) stim.pops.push_back(species_to_pop_id(x->species_id,c_id));
+                else
+                    for (size_t c_id: x->cells) stim.pops.push_back(species_to_pop_id(x->species_id,c_id));
             }
+            stimuli.push_back(stim);
+        }
 
-            // initialise selector with propensities
-            auto update=ksel_update(i);
-            for (proc_index_type k=0; k<ksys.size(); ++k) update(k);
+        ksys.replicate_tables();
+
+        // initial population counts
+        // (later, iterate over list of named cell lists for this)
+        initial_counts.assign(n_pop,0);
+        for (size_t s_id=0; s_id<n_species; ++s_id) {
+            double conc=M.species[s_id].concentration;
+            for (size_t c_id=0; c_id<n_cell; ++c_id)
+                initial_counts[species_to_pop_id(s_id,c_id)]=conc*M.cells[c_id].volume;
         }
+
+        // instance state and selector propensities follow the process
+        // system's data in each instance record; they are initialised by
+        // the owning thread, and the wait for the other threads is traced
+        // as "barrier"
+        ksys.reserve_instance_bytes(selector_offset()+ksys.size()*sizeof(double));
+        size_t n_workers=worker_count();
+
+        #pragma omp parallel num_threads(n_workers)
+        {
+            auto block=owned_block(worker_id(),n_workers,n_instances);
+            for (size_t i=block.first; i<block.second; ++i) reset_instance(i,t0);
+
+            timeline::span trace("barrier");
+            #pragma omp barrier
+        }
+    }
+
+    /** Thread that owns (first touched) the state of instance, out of
+     * n_threads (see util/numa.h). */
+    size_t instance_owner(size_t instance,size_t n_threads=worker_count()) const {
+        return block_owner(instance,n_threads,n_instances);
+    }
+
+    /** Return instance to the initial model state at time t0.
+     *
+     * Allows an instance slot to be recycled for a new, independent
+     * trajectory without reallocating any per-instance state. Stimuli
+     * scheduled before t0 are skipped.
+     */
+    void reset_instance(size_t instance,double t0) {
+        auto &state=state_of(instance);
+
+        state.t=t0;
+        state.t_change=t0;
+        state.n_events=0;
+        ksys.set_rate_set(0,instance);
+        for (size_t p=0; p<n_pop; ++p) ksys.set_count(p,initial_counts[p],instance);
+
+        state.next_stimulus=std::lower_bound(stimuli.begin(),stimuli.end(),t0,
+            [](const stimulus &s,double t) { return s.t<t; })-stimuli.begin();
+        schedule_stimulus(state);
+
+        resume(instance);
+    }
+
+    /** Apply a recorded event to instance: process k fired at time t,
+     * after any stimuli scheduled at or before t.
+     *
+     * Only the population counts (and observables), rates and the time
+     * are updated; call resume() before advancing the instance again.
+     */
+    void replay(size_t instance,proc_index_type k,double t) {
+        auto &state=state_of(instance);
+
+        if (state.t_stimulus<=t) apply_stimuli(instance,t);
+        ksys.apply(k,instance);
+        state.t=t;
+        state.t_change=t;
+        ++state.n_events;
+    }
+
+    /** Apply the stimuli scheduled for instance at or before time t, as
+     * replay() does. */
+    void apply_stimuli(size_t instance,double t) {
+        apply_stimuli(instance,t,[](proc_index_type) {},[](size_t,long) {});
+    }
+
+    size_t n_stimuli() const { return stimuli.size(); }
+
+    /** Rebuild the selector state of instance from its population counts. */
+    void resume(size_t instance) {
+        auto &state=state_of(instance);
+        state.stale=true;
+
+        ksel(instance).reset();
+        auto update=ksel_update(instance);
+        for (proc_index_type k=0; k<ksys.size(); ++k) update(k);
     }
 
     void set_count(size_t instance,size_t species_id,size_t cell_id,count_type count) {
-        auto &state=states[instance];
+        auto &state=state_of(instance);
 
         ksys.set_count(species_to_pop_id(species_id,cell_id),count,ksel_update(instance),instance);
         state.stale=true;
     }
 
     count_type count(size_t instance,size_t species_id,size_t cell_id) const {
-        return ksys.count(species_to_pop_id(species_id,cell_id)); 
+        return ksys.count(species_to_pop_id(species_id,cell_id),instance);
     }
 
     typename std::result_of<decltype(&proc_system::counts)(proc_system,size_t)>::type counts(size_t instance) const {
         return ksys.counts(instance);
     }
 
+    /** Value of observable obs_id (in model order) in instance. */
+    double observable(size_t instance,size_t obs_id) const {
+        return ksys.observable(obs_id,instance);
+    }
+
+    typename std::result_of<decltype(&proc_system::observables)(proc_system,size_t)>::type observables(size_t instance) const {
+        return ksys.observables(instance);
+    }
+
+    size_t n_observables() const { return ksys.n_observables(); }
+
+    /** Advance instance to time t_end, reporting each event and
+     * population change to the observer (see ssa_observer.h).
+     *
+     * Stimuli are applied in time order with the events, each before
+     * any event at the same time, and up to and including t_end.
+     *
+     * Returns t_end, or the time of the last event if the observer
+     * stops the instance before.
+     *
+     * When profiling, the call is timed as region "advance", with the
+     * time spent selecting and applying events as its children. */
     template <typename G>
     double advance(size_t instance,double t_end,G &g) {
-        auto &state=states[instance];
-        auto update=ksel_update(instance);
+        static const timer::region_id r_advance=timer::profile_region("advance");
+        timer::profile_scope profile(r_advance);
 
-        for (;;) {
-            state.get_next(g);
-            if (state.t+state.next_dt>t_end) break;
+        if (timer::profiling()) return advance_loop<true>(instance,t_end,g);
+        else return advance_loop<false>(instance,t_end,g);
+    }
 
-            ksys.apply(state.next_k_id,update,instance);
-            state.t+=state.next_dt;
-            state.stale=true;
-        }
+    /** Advance instance by n_events events, reporting each to the
+     * observer; returns the time of the last.
+     *
+     * When profiling, the call is timed as region "steps". */
+    template <typename G>
+    double advance_events(size_t instance,size_t n_events,G &g) {
+        static const timer::region_id r_steps=timer::profile_region("steps");
+        timer::profile_scope profile(r_steps);
 
-        state.next_dt-=t_end-state.t;
-        state.t=t_end;
-        return state.t;
+        double t=time(instance);
+        for (size_t i=0; i<n_events; ++i) t=advance(instance,g);
+        return t;
     }
 
+    /** Advance instance by one event, reporting it to the observer.
+     *
+     * Single events are not profiled (see advance_events()). */
     template <typename G>
     double advance(size_t instance,G &g) {
-        auto &state=states[instance];
+        auto &state=state_of(instance);
+        auto sel=ksel(instance);
+
+        // apply any stimuli preceding the event
+        for (;;) {
+            state.get_next(sel,g);
+            if (!(state.t_stimulus<=state.t+state.next_dt && state.next_stimulus<stimuli.size())) break;
+            stimulate(instance);
+        }
+        // no further events once total propensity is zero
+        if (state.next_dt==std::numeric_limits<double>::infinity()) {
+            state.t=state.next_dt;
+            return state.t;
+        }
 
-        state.get_next(g);
-        ksys.apply(state.next_k_id,ksel_update(instance),instance);
+        ksys.apply(state.next_k_id,ksel_update(instance),pop_notify(instance),instance);
         state.t+=state.next_dt;
         state.stale=true;
+        ++state.n_events;
+        obs.on_event(instance,state.next_k_id,state.t,state.t-state.t_change);
+        state.t_change=state.t;
 
         return state.t;
     }
 
+    double time(size_t instance) const { return state_of(instance).t; }
+
+    /** Bytes held by the simulator, by table: the process system's,
+     * including the instance state and selector propensity table held in
+     * each of its instance records, and the shared stimulus schedule. */
+    memory_usage memory_report() const {
+        memory_usage m=ksys.memory_report();
+
+        m.add("instance state",0,selector_offset());
+        m.add("selector propensities",0,ksys.size()*sizeof(double));
+
+        size_t stimulus_bytes=heap_bytes(stimuli);
+        for (const auto &stim: stimuli) stimulus_bytes+=heap_bytes(stim.pops);
+        m.add("initial counts",heap_bytes(initial_counts));
+        m.add("stimuli",stimulus_bytes);
+        return m;
+    }
+
+    /** Describe process k of the simulator initialised from model M:
+     * a reaction in a cell, or the diffusion of a species between cells
+     * (identified by index). */
+    std::string process_name(const rd_model &M,size_t k) const {
+        auto reaction_name=[&](size_t r) {
+            return M.reactions[r].name.empty()? "reaction "+std::to_string(r): M.reactions[r].name;
+        };
+
+        if (k<n_cell*n_reac) return reaction_name(k%n_reac)+" in cell "+std::to_string(k/n_reac);
+
+        // diffusion processes, as enumerated by initialise()
+        size_t i=n_cell*n_reac;
+        for (size_t c_id=0; c_id<n_cell; ++c_id) {
+            for (auto neighbour: M.cells[c_id].neighbours) {
+                if (neighbour.diff_coef==0) continue;
+                if (k<i+n_species)
+                    return "diffusion of "+M.species[k-i].name+" from cell "+std::to_string(c_id)+" to "+std::to_string(neighbour.cell_id);
+                i+=n_species;
+            }
+        }
+        return "process "+std::to_string(k);
+    }
+
+    /** Number of events applied to instance since it was last reset. */
+    uint64_t event_count(size_t instance) const { return state_of(instance).n_events; }
+
+    /** Publish the time, event count and the first W.n_observables()
+     * observables of instance to record of W. */
+    void publish(size_t instance,telemetry_writer &W,size_t record,bool complete=false) const {
+        W.publish(record,complete?telemetry_format::complete:telemetry_format::running,
+                  time(instance),event_count(instance),ksys.observables(instance).begin());
+    }
+
     size_t population_size() const { return n_pop; }
+    size_t process_count() const { return ksys.size(); }
     size_t instances() const { return n_instances; }
 
     std::pair<size_t,size_t> pop_to_species_id(size_t pop_id) const {
@@ -200,17 +428,27 @@ private:
     size_t n_pop;
 
 
+    // Each instance's state, followed by its selector's propensity table,
+    // is held in the bytes reserved in its process system record, so that
+    // all of an instance's mutable state is contiguous in one arena. Both
+    // are trivially copyable, as the record may be moved.
     struct instance_state {
         double t;
-        ssa_selector ksel;
+        double t_change;        // time of the last event or stimulus
+        uint64_t n_events;
+
+        size_t next_stimulus;   // index of next stimulus to apply,
+        double t_stimulus;      // and its time (infinity if none)
+        double ksel_total;      // total propensity of the selector
 
         bool stale;
         proc_index_type next_k_id;
         double next_dt;
 
         template <typename G> 
-        void get_next(G &g) {
+        void get_next(const ssa_selector &ksel,G &g) {
             if (stale) {
+                RDMINI_HOT_COUNT(draws);
                 auto ev=ksel.next(g);
                 next_k_id=ev.key();
                 next_dt=ev.dt();
@@ -220,8 +458,151 @@ private:
         }
     };
 
+    static_assert(std::is_trivially_copyable<instance_state>::value,"instance state is moved with its record");
+
+    static constexpr size_t selector_offset() { return round_up(sizeof(instance_state),alignof(double)); }
+
+    instance_state &state_of(size_t instance) {
+        return *reinterpret_cast<instance_state *>(ksys.instance_bytes(instance));
+    }
+    const instance_state &state_of(size_t instance) const {
+        return *reinterpret_cast<const instance_state *>(ksys.instance_bytes(instance));
+    }
+
+    ssa_selector ksel(size_t instance) {
+        char *bytes=ksys.instance_bytes(instance);
+        return ssa_selector(reinterpret_cast<double *>(bytes+selector_offset()),
+                            &reinterpret_cast<instance_state *>(bytes)->ksel_total,ksys.size());
+    }
+
+    // Scheduled stimulus: a change of delta to each population in pops
+    // (stopping at zero), and a switch to rate set rate_set.
+    static constexpr size_t no_rate_change=std::numeric_limits<size_t>::max();
+
+    struct stimulus {
+        double t;
+        std::vector<size_t> pops;
+        long delta;
+        size_t rate_set;
+    };
+
+    void schedule_stimulus(instance_state &state) {
+        state.t_stimulus=state.next_stimulus<stimuli.size()?
+            stimuli[state.next_stimulus].t:std::numeric_limits<double>::infinity();
+    }
+
+    template <typename F,typename P>
+    void apply_stimuli(size_t instance,double t,F update_notify,P pop_notify) {
+        auto &state=state_of(instance);
+
+        for (; state.next_stimulus<stimuli.size() && stimuli[state.next_stimulus].t<=t; ++state.next_stimulus) {
+            const stimulus &stim=stimuli[state.next_stimulus];
+
+            if (stim.rate_set!=no_rate_change) ksys.set_rate_set(stim.rate_set,update_notify,instance);
+            for (size_t p: stim.pops) {
+                long c=ksys.count(p,instance);
+                count_type c_new=(count_type)std::max(0L,c+stim.delta);
+                if (c_new!=c) {
+                    ksys.set_count(p,c_new,update_notify,instance);
+                    pop_notify(p,c_new-c);
+                }
+            }
+        }
+        schedule_stimulus(state);
+    }
+
+    // Apply the next stimuli of instance at their time, before its
+    // pending event. The pending event is kept unless the stimuli change
+    // a propensity, in which case it is redrawn from the stimulus time.
+    void stimulate(size_t instance) {
+        auto &state=state_of(instance);
+        auto update=ksel_update(instance);
+
+        double t_next=state.t+state.next_dt;
+        state.t=state.t_stimulus;
+        state.t_change=state.t;
+        state.next_dt=t_next-state.t;
+
+        bool changed=false;
+        apply_stimuli(instance,state.t,[&](proc_index_type k) { update(k); changed=true; },pop_notify(instance));
+        if (changed) {
+            RDMINI_HOT_COUNT(stimulus_redraws);
+            state.stale=true;
+        }
+    }
+
+    // Event loop of advance(); with Profile, the ticks spent applying
+    // events, and between applications (drawing events, stimuli and
+    // on_event) as selection, are accumulated locally and added to the
+    // current profile region on return. Timestamps are chained, so that
+    // each event costs two reads of the time stamp counter.
+    template <bool Profile,typename G>
+    double advance_loop(size_t instance,double t_end,G &g) {
+        auto &state=state_of(instance);
+        auto sel=ksel(instance);
+        auto update=ksel_update(instance);
+        uint64_t select_ticks=0,apply_ticks=0,n_select=0,n_apply=0;
+        uint64_t t0=Profile?timer::tsc():0;
+
+        for (;;) {
+            if (Profile) n_select+=state.stale;
+            state.get_next(sel,g);
+            double t_next=state.t+state.next_dt;
+            if (state.t_stimulus<=t_next && state.t_stimulus<=t_end && state.next_stimulus<stimuli.size()) {
+                stimulate(instance);
+                continue;
+            }
+            if (t_next>t_end) break;
+
+            uint64_t t1=0;
+            if (Profile) {
+                t1=timer::tsc();
+                select_ticks+=t1-t0;
+            }
+            ksys.apply(state.next_k_id,update,pop_notify(instance),instance);
+            if (Profile) {
+                t0=timer::tsc();
+                apply_ticks+=t0-t1;
+                ++n_apply;
+            }
+            state.t=t_next;
+            state.stale=true;
+            ++state.n_events;
+            obs.on_event(instance,state.next_k_id,t_next,t_next-state.t_change);
+            state.t_change=t_next;
+            if (obs.stop(instance)) break;
+        }
+        if (Profile) select_ticks+=timer::tsc()-t0;
+
+        // a pending event is kept past t_end; stopped instances rest at
+        // their last event, with none pending
+        if (!state.stale) {
+            state.next_dt-=t_end-state.t;
+            state.t=t_end;
+        }
+
+        if (Profile) {
+            static const timer::region_id r_select=timer::profile_region("select");
+            static const timer::region_id r_apply=timer::profile_region("apply");
+            timer::profile_add(r_select,select_ticks,n_select);
+            timer::profile_add(r_apply,apply_ticks,n_apply);
+        }
+        return state.t;
+    }
+
+    struct pop_notify_f {
+        Observer &obs;
+        size_t instance;
+
+        void operator()(size_t p,long delta) { obs.on_population_change(instance,p,delta); }
+    };
+
+    pop_notify_f pop_notify(size_t instance) { return pop_notify_f{obs,instance}; }
+
     proc_system ksys;
-    std::vector<instance_state> states;
+    Observer obs;
+    std::vector<count_type> initial_counts;
+    std::vector<stimulus> stimuli;
 };
 
 } // namespace rdmini
@@ -0,0 +1,218 @@
+#ifndef PHILOX_H_
+#define PHILOX_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <limits>
+
+#include "rdmini/util/ios_util.h"
+
+/** Philox4x32-10 counter-based random number generator.
+ *
+ * ref: Salmon et al. (2011), Parallel random numbers: as easy as 1, 2, 3.
+ *      Proceedings of SC '11. doi:10.1145/2063384.2063405
+ *
+ * Each block of four 32-bit outputs is a keyed bijection of a 128-bit
+ * counter, so any position in any stream can be computed directly.
+ * The engine is keyed on a 64-bit global seed; the counter comprises
+ * a 64-bit block index and two 32-bit words that identify a simulation
+ * instance and a stream within that instance. Distinct (seed, instance,
+ * stream) triples thus give independent sequences of period 2^66, and
+ * results do not depend upon which thread draws from which sequence.
+ */
+
+namespace rdmini {
+
+namespace impl {
+    constexpr uint32_t philox_m0=0xD2511F53;
+    constexpr uint32_t philox_m1=0xCD9E8D57;
+    constexpr uint32_t philox_w0=0x9E3779B9;
+    constexpr uint32_t philox_w1=0xBB67AE85;
+
+    inline void philox_round(uint32_t *x,uint32_t k0,uint32_t k1) {
+        uint64_t p0=(uint64_t)philox_m0*x[0];
+        uint64_t p1=(uint64_t)philox_m1*x[2];
+
+        uint32_t y0=(uint32_t)(p1>>32)^x[1]^k0;
+        uint32_t y1=(uint32_t)p1;
+        uint32_t y2=(uint32_t)(p0>>32)^x[3]^k1;
+        uint32_t y3=(uint32_t)p0;
+
+        x[0]=y0; x[1]=y1; x[2]=y2; x[3]=y3;
+    }
+}
+
+/** Apply the Philox4x32-10 bijection to counter x in place. */
+
+inline void philox4x32_10(uint32_t *x,uint32_t k0,uint32_t k1) {
+    for (int r=0; r<10; ++r) {
+        impl::philox_round(x,k0,k1);
+        k0+=impl::philox_w0;
+        k1+=impl::philox_w1;
+    }
+}
+
+/** Compute n consecutive blocks of four outputs, starting from block
+ * index `block`, for fixed key and upper counter words c2, c3.
+ *
+ * Blocks are computed in batches laid out lane-wise, so that the rounds
+ * vectorise. Output is written in stream order to out[0..4n).
+ */
+
+inline void philox4x32_10_blocks(uint32_t k0,uint32_t k1,uint64_t block,uint32_t c2,uint32_t c3,size_t n,uint32_t *out) {
+    constexpr size_t width=16;
+    uint32_t x0[width],x1[width],x2[width],x3[width];
+
+    while (n>0) {
+        size_t m=n<width?n:width;
+
+        for (size_t i=0; i<width; ++i) {
+            uint64_t b=block+i;
+            x0[i]=(uint32_t)b;
+            x1[i]=(uint32_t)(b>>32);
+            x2[i]=c2;
+            x3[i]=c3;
+        }
+
+        uint32_t r0=k0,r1=k1;
+        for (int r=0; r<10; ++r) {
+            #pragma omp simd
+            for (size_t i=0; i<width; ++i) {
+                uint64_t p0=(uint64_t)impl::philox_m0*x0[i];
+                uint64_t p1=(uint64_t)impl::philox_m1*x2[i];
+
+                x0[i]=(uint32_t)(p1>>32)^x1[i]^r0;
+                x2[i]=(uint32_t)(p0>>32)^x3[i]^r1;
+                x1[i]=(uint32_t)p1;
+                x3[i]=(uint32_t)p0;
+            }
+            r0+=impl::philox_w0;
+            r1+=impl::philox_w1;
+        }
+
+        for (size_t i=0; i<m; ++i) {
+            out[0]=x0[i];
+            out[1]=x1[i];
+            out[2]=x2[i];
+            out[3]=x3[i];
+            out+=4;
+        }
+
+        block+=m;
+        n-=m;
+    }
+}
+
+/** Random number engine over a Philox4x32-10 stream.
+ *
+ * Satisfies the C++ uniform random bit generator requirements, so it
+ * can be passed wherever a std::minstd_rand or std::mt19937 would be.
+ * The engine state is (seed, instance, stream, position); position()
+ * and seek() give constant-time checkpointing and skip-ahead.
+ */
+
+class philox_engine {
+public:
+    typedef uint32_t result_type;
+
+    static constexpr result_type min() { return 0; }
+    static constexpr result_type max() { return std::numeric_limits<result_type>::max(); }
+
+    explicit philox_engine(uint64_t seed_=0,uint32_t instance_=0,uint32_t stream_=0) {
+        seed(seed_,instance_,stream_);
+    }
+
+    void seed(uint64_t seed_=0,uint32_t instance_=0,uint32_t stream_=0) {
+        key=seed_;
+        instance=instance_;
+        stream=stream_;
+        seek(0);
+    }
+
+    result_type operator()() {
+        if (index==4) {
+            ++block;
+            refill();
+            index=0;
+        }
+        return buf[index++];
+    }
+
+    /** Advance the stream by n outputs in constant time. */
+    void discard(unsigned long long n) { seek(position()+n); }
+
+    /** Number of outputs drawn since the start of the stream. */
+    uint64_t position() const { return 4*block+index; }
+
+    /** Reposition the stream to after the first pos outputs. */
+    void seek(uint64_t pos) {
+        block=pos/4;
+        index=(unsigned)(pos%4);
+        refill();
+    }
+
+    /** Fill out[0..n) with the next n outputs of the stream. */
+    void generate(result_type *out,size_t n) {
+        while (n>0 && index<4) { *out++=buf[index++]; --n; }
+        if (n==0) return;
+
+        // whole blocks in bulk, remainder through the buffer
+        ++block;
+        size_t nblock=n/4;
+        philox4x32_10_blocks((uint32_t)key,(uint32_t)(key>>32),block,instance,stream,nblock,out);
+        block+=nblock;
+        out+=4*nblock;
+        n-=4*nblock;
+
+        refill();
+        index=0;
+        while (n-->0) *out++=buf[index++];
+    }
+
+    uint64_t get_seed() const { return key; }
+    uint32_t get_instance() const { return instance; }
+    uint32_t get_stream() const { return stream; }
+
+    bool operator==(const philox_engine &e) const {
+        return key==e.key && instance==e.instance && stream==e.stream && position()==e.position();
+    }
+    bool operator!=(const philox_engine &e) const { return !(*this==e); }
+
+    friend std::ostream &operator<<(std::ostream &O,const philox_engine &e) {
+        scoped_ios_format save(O);
+        return O << std::dec << e.key << ' ' << e.instance << ' ' << e.stream << ' ' << e.position();
+    }
+
+    friend std::istream &operator>>(std::istream &I,philox_engine &e) {
+        scoped_ios_format save(I);
+        uint64_t key,pos;
+        uint32_t instance,stream;
+
+        if (I >> std::dec >> key >> instance >> stream >> pos) {
+            e.seed(key,instance,stream);
+            e.seek(pos);
+        }
+        return I;
+    }
+
+private:
+    uint64_t key;
+    uint32_t instance,stream;
+
+    uint64_t block;
+    unsigned index;
+    uint32_t buf[4];
+
+    void refill() {
+        buf[0]=(uint32_t)block;
+        buf[1]=(uint32_t)(block>>32);
+        buf[2]=instance;
+        buf[3]=stream;
+        philox4x32_10(buf,(uint32_t)key,(uint32_t)(key>>32));
+    }
+};
+
+} // namespace rdmini
+
+#endif // ndef PHILOX_H_
@@ -0,0 +1,274 @@
+#ifndef QMC_H_
+#define QMC_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include "rdmini/exceptions.h"
+
+/** Quasi-Monte Carlo point generators in base 2.
+ *
+ * Generators present 64-bit digital sequences through the uniform random
+ * bit generator interface: with a 64-bit result type, one call supplies
+ * one std::uniform_real_distribution<double> sample, so these can drive
+ * an SSA selector's next(g) directly. A d-dimensional generator returns
+ * the coordinates of each point in turn.
+ *
+ * ref: Joe and Kuo (2008), Constructing Sobol sequences with better
+ *      two-dimensional projections. SIAM J. Sci. Comput. 30, 2635–2654.
+ *      doi:10.1137/070709359
+ *
+ * ref: Owen (1995), Randomly permuted (t,m,s)-nets and (t,s)-sequences.
+ *      In: Monte Carlo and Quasi-Monte Carlo Methods in Scientific
+ *      Computing, 299–317. doi:10.1007/978-1-4612-2552-2_19
+ */
+
+namespace rdmini {
+
+/** Reverse the bits of a 64-bit word. */
+
+inline uint64_t reverse_bits(uint64_t x) {
+    x=((x>>1)&0x5555555555555555ull)|((x&0x5555555555555555ull)<<1);
+    x=((x>>2)&0x3333333333333333ull)|((x&0x3333333333333333ull)<<2);
+    x=((x>>4)&0x0f0f0f0f0f0f0f0full)|((x&0x0f0f0f0f0f0f0f0full)<<4);
+    x=((x>>8)&0x00ff00ff00ff00ffull)|((x&0x00ff00ff00ff00ffull)<<8);
+    x=((x>>16)&0x0000ffff0000ffffull)|((x&0x0000ffff0000ffffull)<<16);
+    return (x>>32)|(x<<32);
+}
+
+/** Map a 64-bit digital point to [0,1). */
+
+inline double qmc_to_unit(uint64_t x) {
+    return (double)(x>>11)*(1.0/9007199254740992.0);
+}
+
+/** Base-2 radical inverse (van der Corput sequence) of n in [0,1). */
+
+inline double radical_inverse_base2(uint64_t n) { return qmc_to_unit(reverse_bits(n)); }
+
+namespace impl {
+    inline unsigned count_trailing_zeros(uint64_t x) {
+#if defined(__GNUC__)
+        return x?(unsigned)__builtin_ctzll(x):64;
+#else
+        unsigned n=0;
+        if (!x) return 64;
+        while (!(x&1)) { x>>=1; ++n; }
+        return n;
+#endif
+    }
+
+    // splitmix64 finaliser
+    inline uint64_t mix64(uint64_t x) {
+        x^=x>>30; x*=0xbf58476d1ce4e5b9ull;
+        x^=x>>27; x*=0x94d049bb133111ebull;
+        x^=x>>31;
+        return x;
+    }
+
+    // Primitive polynomials and initial direction numbers for dimensions
+    // 2 to 16, from new-joe-kuo-6.21201. Dimension 1 is van der Corput.
+    struct sobol_init {
+        unsigned s;       // polynomial degree
+        unsigned a;       // interior polynomial coefficients
+        unsigned m[6];    // initial direction numbers m_1..m_s
+    };
+
+    constexpr sobol_init sobol_init_tbl[]={
+        {1,  0, {1}},
+        {2,  1, {1,3}},
+        {3,  1, {1,3,1}},
+        {3,  2, {1,1,1}},
+        {4,  1, {1,1,3,3}},
+        {4,  4, {1,3,5,13}},
+        {5,  2, {1,1,5,5,17}},
+        {5,  4, {1,1,5,5,5}},
+        {5,  7, {1,1,7,11,19}},
+        {5, 11, {1,1,5,1,1}},
+        {5, 13, {1,1,1,3,11}},
+        {5, 14, {1,3,5,5,31}},
+        {6,  1, {1,3,3,9,7,49}},
+        {6, 13, {1,1,1,15,21,21}},
+        {6, 16, {1,3,1,13,27,49}}
+    };
+}
+
+/** Base-2 van der Corput sequence as a 64-bit generator. */
+
+class vdc_base2_generator {
+public:
+    typedef uint64_t result_type;
+
+    static constexpr result_type min() { return 0; }
+    static constexpr result_type max() { return std::numeric_limits<result_type>::max(); }
+
+    explicit vdc_base2_generator(uint64_t n_=0): n(n_) {}
+
+    result_type operator()() { return reverse_bits(n++); }
+
+    void discard(unsigned long long k) { n+=k; }
+    void seek(uint64_t n_) { n=n_; }
+    uint64_t index() const { return n; }
+
+private:
+    uint64_t n;
+};
+
+/** Multidimensional Sobol sequence, optionally scrambled.
+ *
+ * Points are generated incrementally in Gray code order, each from its
+ * predecessor with one XOR per dimension; point n is the Sobol point
+ * with index n^(n>>1). Any initial segment of length 2^m is therefore
+ * the same set of points as in natural order.
+ *
+ * Scrambling is determined by a seed:
+ *
+ *     digital_shift   XOR each coordinate with a random per-dimension word.
+ *     owen            Nested uniform (Owen) scrambling: each bit of a
+ *                     coordinate is flipped according to a hash of the bits
+ *                     above it; costs one hash per bit.
+ *
+ * Both preserve the net properties of the sequence.
+ */
+
+class sobol_generator {
+public:
+    typedef uint64_t result_type;
+
+    enum scramble_type { no_scramble, digital_shift, owen };
+
+    static constexpr unsigned max_dimension=1+sizeof(impl::sobol_init_tbl)/sizeof(impl::sobol_init);
+    static constexpr unsigned bits=64;
+
+    static constexpr result_type min() { return 0; }
+    static constexpr result_type max() { return std::numeric_limits<result_type>::max(); }
+
+    explicit sobol_generator(unsigned dims_=1,scramble_type scramble_=no_scramble,uint64_t seed_=0):
+        dims(dims_), scramble(scramble_), seed(seed_)
+    {
+        if (dims<1 || dims>max_dimension)
+            throw invalid_value("unsupported Sobol sequence dimension");
+
+        init_direction_numbers();
+
+        shift.assign(dims,0);
+        if (scramble==digital_shift)
+            for (unsigned j=0; j<dims; ++j) shift[j]=impl::mix64(seed+impl::mix64(j+1));
+
+        seek(0);
+    }
+
+    unsigned dimension() const { return dims; }
+
+    /** Index (in Gray code order) of the current point. */
+    uint64_t index() const { return n; }
+
+    /** Next coordinate to be returned of the current point. */
+    unsigned coordinate() const { return d; }
+
+    /** Position at the start of point n, in O(dimension·bits) time. */
+    void seek(uint64_t n_) {
+        n=n_;
+        d=0;
+
+        uint64_t gray=n^(n>>1);
+        x.assign(dims,0);
+        for (unsigned k=0; gray; ++k, gray>>=1) {
+            if (gray&1)
+                for (unsigned j=0; j<dims; ++j) x[j]^=v[j*bits+k];
+        }
+    }
+
+    /** Return the next coordinate of the current point. */
+    result_type operator()() {
+        result_type r=scrambled(x[d],d);
+        if (++d==dims) advance();
+        return r;
+    }
+
+    /** Skip k coordinates. */
+    void discard(unsigned long long k) {
+        unsigned long long pos=(unsigned long long)d+k;
+        if (pos<dims) d=(unsigned)pos;
+        else {
+            seek(n+pos/dims);
+            d=(unsigned)(pos%dims);
+        }
+    }
+
+    /** Write remaining coordinates of the current point to out as values in
+     * [0,1), and move to the next point. */
+    void next_point(double *out) {
+        do *out++=qmc_to_unit((*this)()); while (d!=0);
+    }
+
+private:
+    unsigned dims;
+    scramble_type scramble;
+    uint64_t seed;
+
+    std::vector<uint64_t> v;      // v[j*bits+k]: k-th direction number of dimension j
+    std::vector<uint64_t> x;      // current (unscrambled) point
+    std::vector<uint64_t> shift;  // digital shift per dimension
+
+    uint64_t n;
+    unsigned d;
+
+    void advance() {
+        d=0;
+        unsigned c=impl::count_trailing_zeros(++n);
+        if (c>=bits) { seek(n); return; } // wrapped
+        for (unsigned j=0; j<dims; ++j) x[j]^=v[j*bits+c];
+    }
+
+    result_type scrambled(uint64_t y,unsigned j) const {
+        switch (scramble) {
+        case digital_shift:
+            return y^shift[j];
+        case owen:
+            return owen_scramble(y,j);
+        default:
+            return y;
+        }
+    }
+
+    // Flip bit i (counting from the most significant) by a hash of the
+    // dimension, seed and the i preceding bits; prefixes of different
+    // lengths are distinguished by a marker bit above the prefix.
+    result_type owen_scramble(uint64_t y,unsigned j) const {
+        uint64_t h0=impl::mix64(seed^impl::mix64(j+1));
+        uint64_t flips=0;
+        for (unsigned i=0; i<bits; ++i) {
+            uint64_t prefix=i?(y>>(bits-i)):0;
+            uint64_t key=prefix|((uint64_t)1<<i);
+            flips|=(impl::mix64(h0^key)>>63)<<(bits-1-i);
+        }
+        return y^flips;
+    }
+
+    void init_direction_numbers() {
+        v.assign(dims*bits,0);
+
+        // first dimension: van der Corput
+        for (unsigned k=0; k<bits; ++k) v[k]=(uint64_t)1<<(bits-1-k);
+
+        for (unsigned j=1; j<dims; ++j) {
+            const impl::sobol_init &init=impl::sobol_init_tbl[j-1];
+            uint64_t *vj=&v[j*bits];
+            unsigned s=init.s;
+
+            for (unsigned k=0; k<s; ++k) vj[k]=(uint64_t)init.m[k]<<(bits-1-k);
+            for (unsigned k=s; k<bits; ++k) {
+                vj[k]=vj[k-s]^(vj[k-s]>>s);
+                for (unsigned i=1; i<s; ++i)
+                    if ((init.a>>(s-1-i))&1) vj[k]^=vj[k-i];
+            }
+        }
+    }
+};
+
+} // namespace rdmini
+
+#endif // ndef QMC_H_
@@ -4,9 +4,12 @@
 #include <iosfwd>
 #include <string>
 #include <set>
+#include <utility>
+#include <vector>
 #include <stdexcept>
 
 #include "rdmini/exceptions.h"
+#include "rdmini/memory_usage.h"
 #include "rdmini/util/named_collection.h"
 #include "rdmini/util/check_valid.h"
 
@@ -65,28 +68,66 @@ struct cell_set {
     std::vector<size_t> cells;
 };
 
+/** Weighted sum of the counts of species over a set of cells. */
+struct observable_info {
+    std::string name;
+    std::vector<std::pair<size_t,double>> species; // species index and weight
+    std::vector<size_t> cells;                     // empty for all cells
+};
+
+/** Change to the state of a simulation at a scheduled time: molecules of
+ * a species injected into or removed from each of a set of cells, or the
+ * rate constant of a reaction replaced. */
+struct stimulus_info {
+    enum kind_type { inject, remove, set_rate };
+
+    double t=0;
+    kind_type kind=inject;
+    size_t species_id=0;        // inject, remove: species,
+    size_t count=0;             // molecules per cell (removal stops at zero),
+    std::vector<size_t> cells;  // and cells, empty for all cells
+    size_t reaction_id=0;       // set_rate: reaction,
+    double rate=0;              // and new rate constant
+};
+
 struct rd_model {
     std::string name;
     named_collection<species_info> species;
     named_collection<reaction_info> reactions;
     named_collection<cell_set> cell_sets;
+    named_collection<observable_info> observables;
     std::vector<cell_info> cells;
+    std::vector<stimulus_info> stimuli;  // in order of specification
 
     void clear() {
         species.clear();
         reactions.clear();
+        observables.clear();
+        stimuli.clear();
     }
 
     friend std::ostream &operator<<(std::ostream &O,const rd_model &M);
 
+    /** Bytes held by the model description, all shared (names and
+     * lookup tables not counted). */
+    memory_usage memory_report() const;
+
     size_t n_species() const { return species.size(); }
     size_t n_reactions() const { return reactions.size(); }
     size_t n_cells() const { return cells.size(); }
+    size_t n_observables() const { return observables.size(); }
+    size_t n_stimuli() const { return stimuli.size(); }
 };
 
 rd_model rd_model_read(std::istream &,const std::string &model_name="");
 rd_model rd_model_read(const std::string &,const std::string &model_name="");
 
+/** Parse an observable definition NAME=TERMS[@CELLSETS] over the species
+ * and cell sets of M, where TERMS is a list of [WEIGHT*]SPECIES joined by
+ * '+', and CELLSETS a comma-separated list of cell set names (default:
+ * all cells). Throws model_io_error on error, or if NAME is in use. */
+observable_info parse_observable(const rd_model &M,const std::string &spec);
+
 } // namespace rdmini
 
 #endif // ndef RDMODEL_H_
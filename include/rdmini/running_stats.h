@@ -0,0 +1,180 @@
+#ifndef RUNNING_STATS_H_
+#define RUNNING_STATS_H_
+
+/** Online (single-pass) summary statistics.
+ *
+ * Mean and variance are accumulated with Welford's update, which
+ * is numerically stable for long sequences of samples.
+ *
+ * Accumulators are mergeable: statistics gathered separately over
+ * parts of a sample (for example by different threads) can be
+ * combined into statistics of the whole, with the pairwise update
+ * of Chan, Golub and LeVeque.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <vector>
+
+#include "rdmini/exceptions.h"
+
+namespace rdmini {
+
+/** Running statistics: mean, variance, extrema. */
+
+struct running_stats {
+    running_stats() { clear(); }
+
+    size_t count() const { return n; }
+    double mean() const { return m; }
+    double variance() const { return n<2?0:m2/(n-1); }
+    double cv()  const { return std::sqrt(variance())/mean(); }
+    double min() const { return xmin; }
+    double max() const { return xmax; }
+
+    /** Standard error of the mean. */
+    double sem() const { return n<2?std::numeric_limits<double>::infinity():std::sqrt(variance()/n); }
+
+    /** Relative standard error of the mean; infinite if the mean is zero. */
+    double rse() const {
+        double am=std::abs(m);
+        return am==0?std::numeric_limits<double>::infinity():sem()/am;
+    }
+
+    void clear() {
+        n=0;
+        m=0;
+        m2=0;
+        xmin=0;
+        xmax=0;
+    }
+
+    void insert(double x) {
+        double s=x-m;
+
+        ++n;
+        m+=s/n;
+        m2+=s*(x-m);
+
+        if (n==1 || xmin>x) xmin=x;
+        if (n==1 || xmax<x) xmax=x;
+    }
+
+    /** Combine with statistics of another sample. */
+    void merge(const running_stats &x) {
+        if (x.n==0) return;
+        if (n==0) {
+            *this=x;
+            return;
+        }
+
+        double nt=(double)(n+x.n);
+        double d=x.m-m;
+
+        m+=d*(x.n/nt);
+        m2+=x.m2+d*d*(n*(double)x.n/nt);
+        xmin=std::min(xmin,x.xmin);
+        xmax=std::max(xmax,x.xmax);
+        n+=x.n;
+    }
+
+    size_t n;
+    double m,m2;
+    double xmin,xmax;
+};
+
+/** Running covariance of paired samples. */
+
+struct running_cov {
+    running_cov() { clear(); }
+
+    double covariance() { return n<1?0:cn/n; }
+
+    void clear() {
+        n=0;
+        mx=my=cn=0;
+    }
+
+    void insert(double x,double y) {
+        double dx=x-mx;
+        double dy=y-my;
+
+        ++n;
+        mx+=dx/n;
+        my+=dy/n;
+
+        cn+=(x-mx)*dy;
+    }
+
+    /** Combine with the covariance of another sample. */
+    void merge(const running_cov &x) {
+        if (x.n==0) return;
+        if (n==0) {
+            *this=x;
+            return;
+        }
+
+        double nt=(double)(n+x.n);
+        double dx=x.mx-mx;
+        double dy=x.my-my;
+
+        mx+=dx*(x.n/nt);
+        my+=dy*(x.n/nt);
+        cn+=x.cn+dx*dy*(n*(double)x.n/nt);
+        n+=x.n;
+    }
+
+    size_t n;
+    double mx,my,cn;
+};
+
+/** Histogram with n_bins equal bins over [lo,hi), and counts of samples
+ * below and at or above the range. */
+
+struct fixed_histogram {
+    fixed_histogram(): fixed_histogram(0,1,1) {}
+
+    fixed_histogram(double lo_,double hi_,size_t n_bins):
+        lo(lo_), hi(hi_), scale(n_bins/(hi_-lo_)), counts(n_bins+2,0)
+    {
+        if (!(hi>lo) || n_bins==0) throw invalid_value("invalid histogram range");
+    }
+
+    size_t n_bins() const { return counts.size()-2; }
+    double lower(size_t i) const { return lo+i/scale; }
+    double upper(size_t i) const { return i+1==n_bins()?hi:lo+(i+1)/scale; }
+
+    size_t bin(size_t i) const { return counts[i+1]; }
+    size_t underflow() const { return counts.front(); }
+    size_t overflow() const { return counts.back(); }
+
+    size_t count() const {
+        size_t total=0;
+        for (auto c: counts) total+=c;
+        return total;
+    }
+
+    void clear() { std::fill(counts.begin(),counts.end(),0); }
+
+    void insert(double x) {
+        if (x<lo) ++counts.front();
+        else if (x>=hi) ++counts.back();
+        else ++counts[1+std::min(n_bins()-1,(size_t)((x-lo)*scale))];
+    }
+
+    /** Combine with a histogram over the same bins. */
+    void merge(const fixed_histogram &x) {
+        if (x.lo!=lo || x.hi!=hi || x.counts.size()!=counts.size())
+            throw invalid_value("merging histograms with different bins");
+        for (size_t i=0; i<counts.size(); ++i) counts[i]+=x.counts[i];
+    }
+
+    double lo,hi,scale;
+    std::vector<size_t> counts;  // underflow, bins, overflow
+};
+
+} // namespace rdmini
+
+#endif // ndef RUNNING_STATS_H_
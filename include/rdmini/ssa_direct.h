@@ -1,20 +1,61 @@
 #ifndef SSA_DIRECT_H_
 #define SSA_DIRECT_H_
 
+#include <algorithm>
+#include <limits>
+#include <memory>
 #include <random>
+#include <utility>
+#include <vector>
 
 #include "rdmini/exceptions.h"
+#include "rdmini/hot_counters.h"
+#include "rdmini/variates.h"
 
 /** Implementation of 'direct' SSA method. */
 
 namespace rdmini {
 
+// Index of the key selected by u in [0,1) with probability proportional
+// to its propensity, from the n_key propensities at p with total total.
+
+template <typename KeyType,typename ValueType>
+KeyType ssa_direct_select(const ValueType *p,size_t n_key,ValueType total,ValueType u) {
+    ValueType x = u*total;
+    KeyType i=0;
+    for (i=0; i<n_key; ++i) {
+        x-=p[i];
+        if (x<0) break;
+    }
+    if (i>=n_key) throw rdmini::ssa_error("fell off propensity ladder (rounding?)");
+    RDMINI_HOT_COUNT(selections);
+    RDMINI_HOT_COUNT_N(scan_steps,i+1);
+    return i;
+}
+
+// Event: a pair (idx, dt)
+
+template <typename KeyType,typename ValueType>
+class ssa_direct_event: std::pair<KeyType,ValueType> {
+    typedef std::pair<KeyType,ValueType> pair_type;
+public:
+    using typename pair_type::first_type;
+    using typename pair_type::second_type;
+
+    ssa_direct_event() =default;
+    ssa_direct_event(KeyType k_,ValueType dt_): pair_type(k_,dt_) {}
+
+    KeyType key() const { return this->first; }
+    ValueType dt() const { return this->second; }
+};
+
 // KeyType              must be unsigned integral
 // ValueType            must be floating point
-// RealDistribution     must be a real distribution over an interval [a,b]
+// Allocator            allocator for the propensity table
 
 template <typename KeyType,
-         typename ValueType> 
+         typename ValueType,
+         typename Allocator=std::allocator<ValueType>> 
 struct ssa_direct {
     typedef KeyType key_type;
     typedef ValueType value_type;
@@ -23,23 +64,11 @@ private:
     size_t n_key;
     std::uniform_real_distribution<value_type> U;
     std::exponential_distribution<value_type> E;
-    std::vector<value_type> propensities;
+    std::vector<value_type,Allocator> propensities;
     value_type total;
 
 public:
-    // Nested class Event_type: an Event_type is a pair (idx, dt)
-    class event_type: std::pair<key_type,value_type> {
-        typedef std::pair<key_type,value_type> pair_type;
-    public:
-        using typename pair_type::first_type;
-        using typename pair_type::second_type;
-
-        event_type() =default;
-        event_type(key_type k_,value_type dt_): pair_type(k_,dt_) {}
-
-        key_type key() const { return this->first; }
-        value_type dt() const { return this->second; }
-    };
+    typedef ssa_direct_event<key_type,value_type> event_type;
 
     // Constructor    
     explicit ssa_direct(size_t n_key_=0) : U(0.,1.), E(1.) { reset(n_key_); }
@@ -49,21 +78,23 @@ public:
 
     // Computes inverse CDF
     key_type inverse_cdf(value_type u) const {
-        value_type x = u*total;    
-        key_type i=0;
-        for (i=0; i<n_key; ++i) {
-            x-=propensities[i];
-            if (x<0) break;
-        }
-        if (i>=n_key) throw rdmini::ssa_error("fell off propensity ladder (rounding?)");
-        return i;
+        return ssa_direct_select<key_type>(propensities.data(),n_key,total,u);
     }
 
-    // Computes next event: which one (idx) and when (dt) 
+    // Computes next event: which one (idx) and when (dt);
+    // no event ever occurs if the total propensity is zero.
     template <typename R>
     event_type next(R &g) {
+        if (!(total>0)) return event_type{0, std::numeric_limits<value_type>::infinity()};
         return event_type{inverse_cdf(U(g)), E(g)/total};
     }
+
+    // As above, drawing from a source of buffered variates
+    template <typename G,size_t B>
+    event_type next(buffered_variates<G,B> &v) {
+        if (!(total>0)) return event_type{0, std::numeric_limits<value_type>::infinity()};
+        return event_type{inverse_cdf(v.uniform()), v.exponential()/total};
+    }
         
 
     // Setter for number of keys
@@ -76,6 +107,8 @@ public:
     // Setter for propensity with index k 
     void update(key_type k,value_type r) {
         value_type &p=propensities[k];
+        RDMINI_HOT_COUNT(propensity_updates);
+        if (r==p) RDMINI_HOT_COUNT(unchanged_updates);
         total+=r-p;
         p=r;
     }
@@ -86,6 +119,64 @@ public:
     // Getter for total of propensities 
     value_type total_propensity() const { return total; };
 
+    // Heap bytes held by the propensity table
+    size_t heap_bytes() const { return propensities.capacity()*sizeof(value_type); }
+
+};
+
+// As ssa_direct, over a propensity table and total held elsewhere (e.g.
+// in a per-instance arena record); the view is cheap to construct and
+// copy, and owns nothing.
+
+template <typename KeyType,typename ValueType>
+struct ssa_direct_view {
+    typedef KeyType key_type;
+    typedef ValueType value_type;
+    typedef ssa_direct_event<key_type,value_type> event_type;
+
+    ssa_direct_view(value_type *propensities_,value_type *total_,size_t n_key_):
+        propensities(propensities_), total(total_), n_key(n_key_) {}
+
+    size_t size() const { return n_key; }
+
+    key_type inverse_cdf(value_type u) const {
+        return ssa_direct_select<key_type>(propensities,n_key,*total,u);
+    }
+
+    template <typename R>
+    event_type next(R &g) const {
+        if (!(*total>0)) return event_type{0, std::numeric_limits<value_type>::infinity()};
+        value_type u=std::uniform_real_distribution<value_type>(0.,1.)(g);
+        return event_type{inverse_cdf(u), std::exponential_distribution<value_type>(1.)(g)/ *total};
+    }
+
+    template <typename G,size_t B>
+    event_type next(buffered_variates<G,B> &v) const {
+        if (!(*total>0)) return event_type{0, std::numeric_limits<value_type>::infinity()};
+        return event_type{inverse_cdf(v.uniform()), v.exponential()/ *total};
+    }
+
+    // zero all propensities
+    void reset() const {
+        std::fill(propensities,propensities+n_key,0.0);
+        *total=0.0;
+    }
+
+    void update(key_type k,value_type r) const {
+        value_type &p=propensities[k];
+        RDMINI_HOT_COUNT(propensity_updates);
+        if (r==p) RDMINI_HOT_COUNT(unchanged_updates);
+        *total+=r-p;
+        p=r;
+    }
+
+    value_type propensity(key_type k) const { return propensities[k]; }
+    value_type total_propensity() const { return *total; }
+
+private:
+    value_type *propensities;
+    value_type *total;
+    size_t n_key;
 };
 
 } // namespace rdmini
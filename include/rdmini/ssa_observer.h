@@ -0,0 +1,32 @@
+#ifndef SSA_OBSERVER_H_
+#define SSA_OBSERVER_H_
+
+/** Observer policy of parallel_ssa: callbacks from the event loop.
+ *
+ * on_event(instance,k,t,dt) is called after process k fires in instance
+ * at time t, dt after the previous event or stimulus; and
+ * on_population_change(instance,p,delta) after each change to a
+ * population p by an event or stimulus, before the on_event() of the
+ * event. advance() returns early, at the time of the last event, if
+ * stop(instance) is then true.
+ *
+ * Observers implementing only some of these may derive from
+ * null_observer, whose callbacks do nothing and are eliminated once
+ * inlined. Callbacks for different instances may be made concurrently
+ * from different threads.
+ */
+
+#include <cstddef>
+
+namespace rdmini {
+
+struct null_observer {
+    template <typename K>
+    void on_event(size_t,K,double,double) {}
+    void on_population_change(size_t,size_t,long) {}
+    bool stop(size_t) const { return false; }
+};
+
+} // namespace rdmini
+
+#endif // ndef SSA_OBSERVER_H_
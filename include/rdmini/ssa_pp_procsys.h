@@ -4,7 +4,9 @@
 #include <algorithm>
 #include <array>
 #include <cmath>
+#include <cstddef>
 #include <cstdint>
+#include <cstring>
 #include <iomanip>
 #include <iostream>
 #include <limits>
@@ -16,7 +18,11 @@
 
 #include "rdmini/rdmodel.h"
 #include "rdmini/exceptions.h"
+#include "rdmini/hot_counters.h"
+#include "rdmini/memory_usage.h"
+#include "rdmini/util/arena.h"
 #include "rdmini/util/small_map.h"
+#include "rdmini/util/numa.h"
 
 /** SSA process system that maintains process dependencies
  * factored through populations, and computes propensities
@@ -51,33 +57,138 @@ private:
      *     process are stored contiguously.
      *
      * rate:
-     *     rate[k] is the rate constant for the process k
+     *     rate[s*n_proc+k] is the rate constant for the process k in rate
+     *     set s; instance j uses the rate set at offset rate_offset[j]
      *
      * propensity_tbl:
      *     propensity_tbl[j][k] is a (short) sequence of count_type values used to
-     *     compute (together with rate[k]) the propensity of process k in instance j
+     *     compute (together with the rate constant) the propensity of process k in instance j
      *
      * proc_delta_tbl:
      *     proc_delta_tbl[k] is a (short) sequence of pairs (p,d) that describe
      *     which populations p should be adjusted by a delta d when the process
      *     k is applied.
+     *
+     * pop_to_obs_tbl:
+     *     pop_to_obs_tbl[p] is a (short) sequence of pairs (o,w) that describe
+     *     which observables o include population p with weight w.
+     *
+     * obs_value:
+     *     obs_value[j][o] is the value of observable o in instance j, a weighted
+     *     sum of population counts, updated incrementally as counts change.
+     *
+     * The read-only tables rate, pop_to_pc_tbl, proc_delta_tbl and
+     * pop_to_obs_tbl are held
+     * in tables[0], and may be replicated (see replicate_tables()) so that
+     * each instance j reads its own copy tables[table_index[j]].
+     *
+     * Per-instance data (pop_count[j], propensity_tbl[j], obs_value[j] and
+     * any bytes reserved by the caller, see reserve_instance_bytes()) is
+     * stored as one record per instance in a single arena, at a stride padded to a
+     * whole number of cache lines, so that no two instances share a line.
+     * Capacity for populations, processes and observables grows
+     * geometrically as they are added. Each record is allocated and first touched by
+     * the thread that owns the instance (see util/numa.h).
      */
-    
+
     size_t n_pop;            // number of populations
     size_t n_proc;           // number of processes 
+    size_t n_obs;            // number of observables
     size_t n_instance;       // number of instances
-
-    std::vector<std::vector<pop_type>> pop_count;
-    std::vector<value_type> rate;
+    size_t n_rate_sets;      // number of rate sets
 
     typedef std::array<count_type,max_process_order> propensity_tbl_entry;
-    std::vector<std::vector<propensity_tbl_entry>> propensity_tbl;
+
+    size_t pop_capacity;     // populations per instance record
+    size_t proc_capacity;    // processes per instance record
+    size_t obs_capacity;     // observables per instance record
+    size_t prop_offset;      // offset in bytes of propensity_tbl[j] in record
+    size_t obs_offset;       // offset in bytes of obs_value[j] in record
+    size_t extra_bytes;      // caller's bytes per instance record,
+    size_t extra_offset;     // at this offset in record
+    size_t stride;           // bytes per instance record
+    bool huge_pages;
+    aligned_arena instance_data;
+
+    pop_type *pop_count(size_t j) {
+        return reinterpret_cast<pop_type *>(instance_data.data()+j*stride);
+    }
+    const pop_type *pop_count(size_t j) const {
+        return reinterpret_cast<const pop_type *>(instance_data.data()+j*stride);
+    }
+
+    propensity_tbl_entry *propensity_tbl(size_t j) {
+        return reinterpret_cast<propensity_tbl_entry *>(instance_data.data()+j*stride+prop_offset);
+    }
+    const propensity_tbl_entry *propensity_tbl(size_t j) const {
+        return reinterpret_cast<const propensity_tbl_entry *>(instance_data.data()+j*stride+prop_offset);
+    }
+
+    double *obs_value(size_t j) {
+        return reinterpret_cast<double *>(instance_data.data()+j*stride+obs_offset);
+    }
+    const double *obs_value(size_t j) const {
+        return reinterpret_cast<const double *>(instance_data.data()+j*stride+obs_offset);
+    }
+
+    char *extra(size_t j) { return instance_data.data()+j*stride+extra_offset; }
+    const char *extra(size_t j) const { return instance_data.data()+j*stride+extra_offset; }
+
+    static size_t grow_capacity(size_t n,size_t capacity) {
+        return std::max(n,capacity<n?2*capacity:capacity);
+    }
+
+    // ensure per-instance records have room for at least n_pop_ populations,
+    // n_proc_ processes, n_obs_ observables and n_extra bytes of the
+    // caller's, copying existing data in owning threads.
+    void reserve(size_t n_pop_,size_t n_proc_,size_t n_obs_,size_t n_extra) {
+        if (n_pop_<=pop_capacity && n_proc_<=proc_capacity && n_obs_<=obs_capacity && n_extra<=extra_bytes) return;
+
+        size_t new_pop_capacity=grow_capacity(n_pop_,pop_capacity);
+        size_t new_proc_capacity=grow_capacity(n_proc_,proc_capacity);
+        size_t new_obs_capacity=grow_capacity(n_obs_,obs_capacity);
+        size_t new_prop_offset=round_up(new_pop_capacity*sizeof(pop_type),alignof(propensity_tbl_entry));
+        size_t new_obs_offset=round_up(new_prop_offset+new_proc_capacity*sizeof(propensity_tbl_entry),alignof(double));
+        size_t new_extra_bytes=std::max(n_extra,extra_bytes);
+        size_t new_extra_offset=round_up(new_obs_offset+new_obs_capacity*sizeof(double),alignof(std::max_align_t));
+        size_t new_stride=round_up(new_extra_offset+new_extra_bytes);
+
+        aligned_arena new_data(n_instance*new_stride,huge_pages);
+        parallel_for_owned(n_instance,[&](size_t j) {
+            char *record=new_data.data()+j*new_stride;
+            std::memset(record,0,new_stride);
+            size_t np=std::min(n_pop,pop_capacity), nk=std::min(n_proc,proc_capacity), no=std::min(n_obs,obs_capacity);
+            if (np) std::memcpy(record,pop_count(j),np*sizeof(pop_type));
+            if (nk) std::memcpy(record+new_prop_offset,propensity_tbl(j),nk*sizeof(propensity_tbl_entry));
+            if (no) std::memcpy(record+new_obs_offset,obs_value(j),no*sizeof(double));
+            if (extra_bytes) std::memcpy(record+new_extra_offset,extra(j),extra_bytes);
+        });
+
+        instance_data.swap(new_data);
+        pop_capacity=new_pop_capacity;
+        proc_capacity=new_proc_capacity;
+        obs_capacity=new_obs_capacity;
+        prop_offset=new_prop_offset;
+        obs_offset=new_obs_offset;
+        extra_bytes=new_extra_bytes;
+        extra_offset=new_extra_offset;
+        stride=new_stride;
+    }
+
+    // extend population-indexed tables to cover population p; per-instance
+    // records are extended (with zero counts) by fill_instances()
+    void extend_populations(size_t p) {
+        if (p>=n_pop) {
+            n_pop=p+1;
+            tables[0].pop_to_pc_tbl.resize(n_pop);
+            tables[0].pop_to_obs_tbl.resize(n_pop);
+        }
+    }
 
     struct pc_entry {
         key_type k;     // process number
         unsigned index; // in range [0,MaxOrder)
     };
-    std::vector<std::vector<pc_entry>> pop_to_pc_tbl;
 
     struct pd_entry {
         pop_type p;     // population index
@@ -86,68 +197,107 @@ private:
         pd_entry() {}
         pd_entry(std::pair<pop_type,int> pd): p(pd.first), delta(pd.second) {}
     };
-    std::vector<std::vector<pd_entry>> proc_delta_tbl;
+
+    struct po_entry {
+        uint32_t o;     // observable index
+        double weight;  // weight of population in observable
+    };
+
+    struct structure_tables {
+        std::vector<value_type> rate;
+        std::vector<std::vector<pc_entry>> pop_to_pc_tbl;
+        std::vector<std::vector<pd_entry>> proc_delta_tbl;
+        std::vector<std::vector<po_entry>> pop_to_obs_tbl;
+    };
+    std::vector<structure_tables> tables;
+    std::vector<uint16_t> table_index;
+    std::vector<size_t> rate_offset;
+
+    const structure_tables &tables_for(size_t j) const { return tables[table_index[j]]; }
 
     template <typename F>
     void apply_contrib_update(const pc_entry &pc,count_type d,F notify,size_t j) {
-        propensity_tbl[j][pc.k][pc.index]+=d;
+        propensity_tbl(j)[pc.k][pc.index]+=d;
         notify(pc.k);
     }
 
+    void apply_obs_update(const structure_tables &T,size_t p,count_type d,size_t j) {
+        for (const auto &po: T.pop_to_obs_tbl[p]) obs_value(j)[po.o]+=po.weight*d;
+    }
+
     void initialise(size_t n) {
         n_instance=n;
         n_pop=0;
         n_proc=0;
-
-        pop_count=std::vector<std::vector<pop_type>>(n_instance);
-        propensity_tbl=std::vector<std::vector<propensity_tbl_entry>>(n_instance);
-
-        rate.clear();
-        pop_to_pc_tbl.clear();
-        proc_delta_tbl.clear();
+        n_obs=0;
+        n_rate_sets=1;
+
+        pop_capacity=0;
+        proc_capacity=0;
+        obs_capacity=0;
+        prop_offset=0;
+        obs_offset=0;
+        extra_bytes=0;
+        extra_offset=0;
+        stride=0;
+        instance_data=aligned_arena();
+
+        tables.assign(1,structure_tables());
+        table_index.assign(n_instance,0);
+        rate_offset.assign(n_instance,0);
     }
 
-public:
-    explicit ssa_pp_procsys(size_t n_instance_=1) {
-        initialise(n_instance_);
+    void drop_replicas() {
+        tables.resize(1);
+        std::fill(table_index.begin(),table_index.end(),0);
     }
 
-    void reset() {
-        #pragma omp parallel for
-        for (size_t j=0;j<n_instance;++j) {
-            for (size_t p=0;p<n_pop;++p) set_count(p,0,j);
-        }
-    }
+    // Reactants of a process, sorted, from which fill_instances() computes
+    // its propensity table entries.
+    struct reactants {
+        std::array<pop_type,max_process_order> p;
+        unsigned n;
+    };
 
+    // Add process q to the read-only tables, without touching per-instance
+    // data; returns its reactants.
     template <typename ProcDesc>
-    void add(const ProcDesc &q) {
+    reactants add_structure(const ProcDesc &q) {
         if (n_proc>=std::numeric_limits<key_type>::max())
             throw rdmini::invalid_value("process index out of bounds");
+        if (n_rate_sets>1)
+            throw rdmini::invalid_value("processes cannot be added after rate sets");
 
-        key_type key=n_proc++;
-        // check for unsigned overflow ...
-        if (n_proc<key) throw std::overflow_error("number of processes overflow");
+        drop_replicas();
+        auto &T=tables[0];
+
+        key_type key=n_proc;
+        if (n_proc+1<n_proc) throw std::overflow_error("number of processes overflow");
 
         // in minimizing assumptions about q.left() and q.right()
         // datastructures, aim for one-pass through the supplied info.
 
         small_map<pop_type,int> proc_delta_entry;
-        std::array<count_type,max_process_order> left_sorted;
-        unsigned nleft=0;
+        reactants left;
+        left.n=0;
 
         pop_type max_pop=0;
         for (auto p: q.left()) {
-            if (nleft>max_process_order)
+            if (left.n>=max_process_order)
                 throw rdmini::invalid_value("too many reactants");
 
             --proc_delta_entry[p];
             if (proc_delta_entry.size()>max_participants)
                 throw rdmini::invalid_value("too many participants");
 
-            left_sorted[nleft++]=p;
+            left.p[left.n++]=p;
             if (p>max_pop) max_pop=p;
         }
-        std::sort(left_sorted.data(),left_sorted.data()+nleft);
+
+        // at most max_process_order reactants: insertion sort
+        for (unsigned i=1; i<left.n; ++i)
+            for (unsigned j=i; j>0 && left.p[j]<left.p[j-1]; --j)
+                std::swap(left.p[j],left.p[j-1]);
 
         for (auto p: q.right()) {
             ++proc_delta_entry[p];
@@ -157,89 +307,333 @@ public:
             if (p>max_pop) max_pop=p;
         }
 
-        // extend population-indexed data structures if required
-        if (max_pop>=n_pop) {
-            n_pop=max_pop+1;
+        extend_populations(max_pop);
+        ++n_proc;
 
-            #pragma omp parallel for
-            for (size_t j=0;j<n_instance;++j) {
-                pop_count[j].resize(n_pop);
-            }
-            pop_to_pc_tbl.resize(n_pop);
+        // update proc_delta_tbl and pop_to_pc_tbl
+        T.proc_delta_tbl.emplace_back(proc_delta_entry.begin(),proc_delta_entry.end());
+        for (unsigned i=0;i<left.n;++i) {
+            pc_entry pc={key,i};
+            T.pop_to_pc_tbl[left.p[i]].push_back(pc);
         }
 
-        // update proc_delta_tbl:
-        proc_delta_tbl.emplace_back(proc_delta_entry.begin(),proc_delta_entry.end());
+        T.rate.push_back(q.rate());
+        return left;
+    }
 
-        // update pop_to_pc_tbl and propensity_tbl
-        for (unsigned i=0;i<nleft;++i) {
-            pop_type p=left_sorted[i];
-            pc_entry pc={key,i};
-            pop_to_pc_tbl[p].push_back(pc);
+    // Add observable with the given (population, weight) terms to the
+    // read-only tables; returns the weights by population.
+    template <typename Terms>
+    std::map<pop_type,double> add_observable_structure(const Terms &terms) {
+        if (n_obs>=std::numeric_limits<uint32_t>::max())
+            throw rdmini::invalid_value("observable index out of bounds");
+
+        drop_replicas();
+        size_t o=n_obs;
+
+        std::map<pop_type,double> weights;
+        for (const auto &term: terms) {
+            if ((size_t)term.first>max_population_index)
+                throw rdmini::invalid_value("population index out of bounds");
+            weights[(pop_type)term.first]+=term.second;
         }
 
-        #pragma omp parallel for
-        for (size_t j=0;j<n_instance;++j) {
-            propensity_tbl_entry prop_entry;
+        for (const auto &pw: weights) extend_populations(pw.first);
+        ++n_obs;
 
-            count_type c=0; // population contribution to propensity
-            pop_type p_prev=0;
-            for (unsigned i=0;i<nleft;++i) {
-                pop_type p=left_sorted[i];
+        auto &T=tables[0];
+        for (const auto &pw: weights) T.pop_to_obs_tbl[pw.first].push_back(po_entry{(uint32_t)o,pw.second});
+        return weights;
+    }
 
-                if (i==0 || p!=p_prev) c=pop_count[j][p];
-                else --c;
+    // Extend per-instance records to the populations, processes and
+    // observables in the tables, and compute the propensity table entries
+    // of processes from k0 (with reactants procs) and values of
+    // observables from o0 (with weights obs), in one pass by the owning
+    // threads.
+    void fill_instances(size_t k0,const std::vector<reactants> &procs,
+                        size_t o0,const std::vector<std::map<pop_type,double>> &obs)
+    {
+        reserve(n_pop,n_proc,n_obs,extra_bytes);
+        if (procs.empty() && obs.empty()) return;
+
+        parallel_for_owned(n_instance,[&](size_t j) {
+            const pop_type *counts=pop_count(j);
+
+            for (size_t i=0; i<procs.size(); ++i) {
+                const reactants &left=procs[i];
+                propensity_tbl_entry prop_entry;
+
+                count_type c=0; // population contribution to propensity
+                for (unsigned r=0;r<left.n;++r) {
+                    if (r==0 || left.p[r]!=left.p[r-1]) c=counts[left.p[r]];
+                    else --c;
+
+                    prop_entry[r]=c;
+                }
+
+                std::fill(prop_entry.begin()+left.n,prop_entry.end(),1);
+                propensity_tbl(j)[k0+i]=prop_entry;
+            }
 
-                prop_entry[i]=c;
+            for (size_t i=0; i<obs.size(); ++i) {
+                double v=0;
+                for (const auto &pw: obs[i]) v+=pw.second*counts[pw.first];
+                obs_value(j)[o0+i]=v;
             }
+        });
+    }
 
-            std::fill(prop_entry.begin(),prop_entry.end(),1);
-            propensity_tbl[j].push_back(prop_entry);
-        }
+public:
+    /** Construct for n_instance_ instances; with huge_pages_, per-instance
+     * data is backed by transparent huge pages where supported. */
+    explicit ssa_pp_procsys(size_t n_instance_=1,bool huge_pages_=false): huge_pages(huge_pages_) {
+        initialise(n_instance_);
+    }
 
-        rate.push_back(q.rate());
+    void reset() {
+        parallel_for_owned(n_instance,[&](size_t j) {
+            for (size_t p=0;p<n_pop;++p) set_count(p,0,j);
+        });
+    }
 
+    template <typename ProcDesc>
+    void add(const ProcDesc &q) {
+        size_t k0=n_proc;
+        fill_instances(k0,{add_structure(q)},n_obs,{});
     }
 
+    /** Add the processes in [b,e); per-instance data is extended once,
+     * for all of them. */
     template <typename In>
     void add(In b,In e) {
-        while (b!=e) add(*b++);
+        size_t k0=n_proc;
+        std::vector<reactants> procs;
+        while (b!=e) procs.push_back(add_structure(*b++));
+        fill_instances(k0,procs,n_obs,{});
+    }
+
+    /** Add an observable, the weighted sum of the counts of a set of
+     * populations, given as a sequence of (population, weight) pairs.
+     * Its value in each instance is maintained by set_count() and apply()
+     * at the cost of one update per (population, observable) pair changed.
+     * Returns the index of the observable. */
+    template <typename Terms>
+    size_t add_observable(const Terms &terms) {
+        size_t o=n_obs;
+        fill_instances(n_proc,{},o,{add_observable_structure(terms)});
+        return o;
     }
 
+    /** Add the observables with terms in [b,e), as add_observable(), and
+     * return the index of the first. */
+    template <typename In>
+    size_t add_observables(In b,In e) {
+        size_t o0=n_obs;
+        std::vector<std::map<pop_type,double>> obs;
+        while (b!=e) obs.push_back(add_observable_structure(*b++));
+        fill_instances(n_proc,{},o0,obs);
+        return o0;
+    }
+
+    /** Add an alternative set of rate constants for all processes, and
+     * return its index; rate set 0 holds the rates given to add(). An
+     * instance can switch rate sets with set_rate_set(), e.g. to model a
+     * change in conditions at a given time. All processes must be added
+     * first. */
+    size_t add_rate_set(const std::vector<value_type> &rates) {
+        if (rates.size()!=n_proc)
+            throw rdmini::invalid_value("rate set size does not match number of processes");
+
+        drop_replicas();
+        tables[0].rate.insert(tables[0].rate.end(),rates.begin(),rates.end());
+        return n_rate_sets++;
+    }
+
+    size_t rate_sets() const { return n_rate_sets; }
+
+    /** Rate set in use by instance j. */
+    size_t rate_set(size_t j=0) const { return n_proc?rate_offset[j]/n_proc:0; }
+
+    /** Switch instance j to rate set s, calling update_notify(k) for each
+     * process k whose rate constant changes. */
+    template <typename F>
+    void set_rate_set(size_t s,F update_notify,size_t j=0) {
+        if (s>=n_rate_sets) throw rdmini::invalid_value("rate set index out of bounds");
+
+        const auto &rate=tables_for(j).rate;
+        size_t from=rate_offset[j],to=s*n_proc;
+        if (from==to) return;
+
+        rate_offset[j]=to;
+        for (key_type k=0; k<n_proc; ++k)
+            if (rate[from+k]!=rate[to+k]) update_notify(k);
+    }
+
+    void set_rate_set(size_t s,size_t j=0) { set_rate_set(s,[](key_type) {},j); }
+
+    /** Replicate the read-only process tables, one copy per replica.
+     *
+     * Each thread makes (or finds) the copy for replica replica_of_thread(t)
+     * in [0,n_replicas), and assigns it to the instances it owns, so that
+     * copies are first touched by a thread that will use them. Adding a
+     * process drops all replicas.
+     */
+    template <typename F>
+    void replicate_tables(size_t n_replicas,F replica_of_thread) {
+        drop_replicas();
+        if (n_replicas<=1) return;
+
+        tables.resize(1+n_replicas);
+        std::vector<char> made(n_replicas,0);
+        size_t n_workers=worker_count();
+
+        #pragma omp parallel num_threads(n_workers)
+        {
+            size_t w=worker_id();
+            size_t r=replica_of_thread(w);
+
+            #pragma omp critical(procsys_replicate)
+            if (!made[r]) {
+                tables[1+r]=tables[0];
+                made[r]=1;
+            }
+
+            auto block=owned_block(w,n_workers,n_instance);
+            for (size_t j=block.first; j<block.second; ++j) table_index[j]=(uint16_t)(1+r);
+        }
+    }
+
+    /** Replicate the read-only process tables on each NUMA node, for use by
+     * instances owned by threads on that node. No-op on single node systems. */
+    void replicate_tables() {
+        replicate_tables((size_t)numa_node_count(),[](size_t) { return (size_t)current_numa_node(); });
+    }
+
+    /** Number of replicas of the read-only process tables (1 if not replicated). */
+    size_t table_replicas() const { return tables.size()==1?1:tables.size()-1; }
+
     /** Remove all processes, population counts */
     void clear() {
         initialise(n_instance);
     }
 
     size_t size() const { return n_proc; }
+    size_t n_observables() const { return n_obs; }
     
-    count_type count(size_t p,size_t j=0) const { return pop_count[j][p]; }
+    count_type count(size_t p,size_t j=0) const { return pop_count(j)[p]; }
+
+    /** Read-only view of the population counts of instance j. */
+    struct count_range {
+        const pop_type *b,*e;
+
+        const pop_type *begin() const { return b; }
+        const pop_type *end() const { return e; }
+        size_t size() const { return e-b; }
+        pop_type operator[](size_t p) const { return b[p]; }
+    };
+
+    count_range counts(size_t j=0) const { return count_range{pop_count(j),pop_count(j)+n_pop}; }
+
+    double observable(size_t o,size_t j=0) const { return obs_value(j)[o]; }
+
+    /** Read-only view of the observable values of instance j. */
+    struct observable_range {
+        const double *b,*e;
+
+        const double *begin() const { return b; }
+        const double *end() const { return e; }
+        size_t size() const { return e-b; }
+        double operator[](size_t o) const { return b[o]; }
+    };
 
-    const std::vector<pop_type> &counts(size_t j=0) const { return pop_count[j]; }
+    observable_range observables(size_t j=0) const { return observable_range{obs_value(j),obs_value(j)+n_obs}; }
+
+    /** Bytes per instance of per-instance data, including padding. */
+    size_t instance_stride() const { return stride; }
+
+    /** Reserve n bytes for the caller in each instance record, e.g. for
+     * the state of a selector, so that all of an instance's mutable state
+     * is contiguous. The bytes are zeroed, aligned for any scalar type,
+     * and moved with memcpy if records grow: they must hold only
+     * trivially copyable data, and no pointers into the arena. */
+    void reserve_instance_bytes(size_t n) { reserve(n_pop,n_proc,n_obs,n); }
+
+    /** The bytes reserved for the caller in the record of instance j. */
+    char *instance_bytes(size_t j) { return extra(j); }
+    const char *instance_bytes(size_t j) const { return extra(j); }
+
+    /** Bytes held by each table: the per-instance records in the arena,
+     * and the read-only tables, counted over all replicas. Bytes reserved
+     * with reserve_instance_bytes() are left to the caller to report. */
+    memory_usage memory_report() const {
+        memory_usage m(n_instance);
+
+        size_t pop_bytes=pop_capacity*sizeof(pop_type);
+        size_t prop_bytes=proc_capacity*sizeof(propensity_tbl_entry);
+        size_t obs_bytes=obs_capacity*sizeof(double);
+        m.add("pop_count",0,pop_bytes);
+        m.add("propensity_tbl",0,prop_bytes);
+        m.add("obs_value",0,obs_bytes);
+        m.add("record padding",0,stride-pop_bytes-prop_bytes-obs_bytes-extra_bytes);
+
+        size_t rate=0,pop_to_pc=0,proc_delta=0,pop_to_obs=0;
+        for (const auto &T: tables) {
+            rate+=heap_bytes(T.rate);
+            pop_to_pc+=heap_bytes(T.pop_to_pc_tbl);
+            proc_delta+=heap_bytes(T.proc_delta_tbl);
+            pop_to_obs+=heap_bytes(T.pop_to_obs_tbl);
+        }
+        m.add("rate",rate);
+        m.add("pop_to_pc_tbl",pop_to_pc);
+        m.add("proc_delta_tbl",proc_delta);
+        m.add("pop_to_obs_tbl",pop_to_obs);
+        m.add("table_index, rate_offset",0,sizeof(uint16_t)+sizeof(size_t));
+        return m;
+    }
 
     template <typename F>
     void set_count(size_t p,count_type c,F update_notify,size_t j=0) {
-        for (const auto &pc: pop_to_pc_tbl[p])
-            apply_contrib_update(pc,c-pop_count[j][p],update_notify,j);
-        pop_count[j][p]=c;
+        const structure_tables &T=tables_for(j);
+        count_type d=c-pop_count(j)[p];
+        for (const auto &pc: T.pop_to_pc_tbl[p])
+            apply_contrib_update(pc,d,update_notify,j);
+        if (n_obs) apply_obs_update(T,p,d,j);
+        pop_count(j)[p]=c;
     }
 
     void set_count(size_t p,count_type c,size_t j=0) { set_count(p,c,[](key_type) {},j); }
 
     template <typename F>
     void apply(key_type k,F update_notify,size_t j=0) {
-        for (auto pd: proc_delta_tbl[k]) {
-            for (const auto &pc: pop_to_pc_tbl[pd.p])
+        apply(k,update_notify,[](size_t,int) {},j);
+    }
+
+    /** Apply process k to instance j, calling update_notify(k') for each
+     * process whose propensity may change, and pop_notify(p,delta) after
+     * each change delta to population p. */
+    template <typename F,typename P>
+    void apply(key_type k,F update_notify,P pop_notify,size_t j) {
+        const structure_tables &T=tables_for(j);
+#ifdef RDMINI_HOT_COUNTERS
+        size_t n_notify=0;
+        for (auto pd: T.proc_delta_tbl[k]) n_notify+=T.pop_to_pc_tbl[pd.p].size();
+        RDMINI_HOT_COUNT_EVENT(k,n_notify);
+#endif
+        for (auto pd: T.proc_delta_tbl[k]) {
+            for (const auto &pc: T.pop_to_pc_tbl[pd.p])
                 apply_contrib_update(pc,pd.delta,update_notify,j);
-            pop_count[j][pd.p]+=pd.delta;
+            if (n_obs) apply_obs_update(T,pd.p,pd.delta,j);
+            pop_count(j)[pd.p]+=pd.delta;
+            pop_notify(pd.p,pd.delta);
         }
     }
 
     void apply(key_type k,size_t j=0) { apply(k,[](key_type) {},j); }
 
     value_type propensity(key_type k,size_t j=0) {
-        const propensity_tbl_entry &kp=propensity_tbl[j][k];
-        value_type r=rate[k];
+        const propensity_tbl_entry &kp=propensity_tbl(j)[k];
+        value_type r=tables_for(j).rate[rate_offset[j]+k];
         for (auto c: kp) r*=c;
         return r;
     }
@@ -249,7 +643,8 @@ public:
         O << "ssa_pp_procsys: n_pop=" << sys.n_pop << ", n_proc=" << sys.n_proc << "\n";
         O << "pop_to_pc_tbl:\n";
         size_t idx=0;
-        for (const auto &e: sys.pop_to_pc_tbl) {
+        const structure_tables &T=sys.tables[0];
+        for (const auto &e: T.pop_to_pc_tbl) {
             O << "    " << std::setw(6) << std::right << idx++ << ":";
             for (const auto &pc: e) 
                 O << ' ' << pc.k  << ':'
@@ -258,18 +653,29 @@ public:
         }
         O << "proc_delta_tbl:\n";
         idx=0;
-        for (const auto &e: sys.proc_delta_tbl) {
+        for (const auto &e: T.proc_delta_tbl) {
             O << "    " << std::setw(6) << std::right << idx++ << ":";
             for (const auto &pd: e) 
                 O << ' ' << pd.p  << ':'
                   << std::showpos << pd.delta << std::noshowpos;
             O << "\n";
         }
+        if (sys.n_obs) {
+            O << "pop_to_obs_tbl:\n";
+            idx=0;
+            for (const auto &e: T.pop_to_obs_tbl) {
+                O << "    " << std::setw(6) << std::right << idx++ << ":";
+                for (const auto &po: e) O << ' ' << po.o << ':' << po.weight;
+                O << "\n";
+            }
+        }
         O << "rate:\n";
         idx=0;
-        for (const auto &r: sys.rate) {
-            O << "    " << std::setw(6) << std::right << idx++ << ":"
+        for (const auto &r: T.rate) {
+            if (idx>0 && idx%sys.n_proc==0) O << "rate set " << idx/sys.n_proc << ":\n";
+            O << "    " << std::setw(6) << std::right << idx%sys.n_proc << ":"
               << ' ' << r << '\n';
+            ++idx;
         }
         return O;
     }
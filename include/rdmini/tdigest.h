@@ -0,0 +1,182 @@
+#ifndef TDIGEST_H_
+#define TDIGEST_H_
+
+/** Mergeable quantile sketch (t-digest).
+ *
+ * A t-digest summarises a sample as a sorted list of weighted centroids,
+ * small near the tails and larger towards the median, so that extreme
+ * quantiles are estimated accurately in bounded space. This is the
+ * merging variant of Dunning and Ertl, "Computing extremely accurate
+ * quantiles using t-digests" (2019), with the k1 (arcsine) scale
+ * function: the number of centroids is at most about the compression
+ * parameter.
+ *
+ * Samples are buffered and merged into the centroids in batches; two
+ * digests are combined by merging their centroids in the same way.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <vector>
+
+#include "rdmini/exceptions.h"
+
+namespace rdmini {
+
+class tdigest {
+public:
+    struct centroid {
+        double mean;
+        double weight;
+
+        bool operator<(const centroid &x) const { return mean<x.mean; }
+    };
+
+    static constexpr double default_compression=100;
+
+    explicit tdigest(double compression_=default_compression): compression(compression_) {
+        if (!(compression>=1)) throw invalid_value("t-digest compression must be at least 1");
+        buffer.reserve(buffer_capacity());
+    }
+
+    double count() const { return total+pending; }
+    bool empty() const { return count()==0; }
+
+    double min() const { return xmin; }
+    double max() const { return xmax; }
+
+    void clear() {
+        centroids_.clear();
+        buffer.clear();
+        total=pending=0;
+        xmin=std::numeric_limits<double>::infinity();
+        xmax=-std::numeric_limits<double>::infinity();
+    }
+
+    void insert(double x,double w=1) {
+        if (std::isnan(x) || !(w>0)) return;
+
+        buffer.push_back(centroid{x,w});
+        pending+=w;
+        xmin=std::min(xmin,x);
+        xmax=std::max(xmax,x);
+        if (buffer.size()>=buffer_capacity()) compress();
+    }
+
+    /** Combine with a digest of another sample. */
+    void merge(const tdigest &x) {
+        x.compress();
+        merge(x.centroids_.begin(),x.centroids_.end(),x.xmin,x.xmax);
+    }
+
+    /** Combine with a digest given by its centroids in [b,e) and the
+     * extrema of its sample, e.g. as stored by another process. */
+    template <typename In>
+    void merge(In b,In e,double x_min,double x_max) {
+        for (; b!=e; ++b) {
+            buffer.push_back(*b);
+            pending+=b->weight;
+        }
+        xmin=std::min(xmin,x_min);
+        xmax=std::max(xmax,x_max);
+        compress();
+    }
+
+    /** Upper bound on the number of centroids: adjacent pairs of
+     * centroids span more than one unit of k, out of compression/2. */
+    size_t max_centroids() const { return (size_t)std::ceil(compression)+2; }
+
+    /** Centroids in order of mean. */
+    const std::vector<centroid> &centroids() const {
+        compress();
+        return centroids_;
+    }
+
+    /** Estimate of the q-quantile, for q in [0,1]; NaN if empty. */
+    double quantile(double q) const {
+        compress();
+        if (centroids_.empty()) return std::numeric_limits<double>::quiet_NaN();
+        if (q<=0) return xmin;
+        if (q>=1) return xmax;
+
+        // centroid i covers rank positions [cum, cum+weight), and its
+        // mean is placed at the middle; interpolate between neighbours,
+        // and between the extreme centroids and the extrema.
+        double rank=q*total;
+        const centroid &first=centroids_.front();
+        if (rank<first.weight/2)
+            return xmin+(first.mean-xmin)*rank/(first.weight/2);
+
+        double cum=0;
+        for (size_t i=0; i+1<centroids_.size(); ++i) {
+            const centroid &a=centroids_[i],&b=centroids_[i+1];
+            double mid_a=cum+a.weight/2;
+            double mid_b=cum+a.weight+b.weight/2;
+            if (rank<mid_b) return a.mean+(b.mean-a.mean)*(rank-mid_a)/(mid_b-mid_a);
+            cum+=a.weight;
+        }
+
+        const centroid &last=centroids_.back();
+        double mid_last=total-last.weight/2;
+        return last.mean+(xmax-last.mean)*(rank-mid_last)/(total-mid_last);
+    }
+
+private:
+    double compression;
+
+    // merged centroids and their total weight; buffered samples and their
+    // weight (mutable so that queries can flush the buffer)
+    mutable std::vector<centroid> centroids_;
+    mutable std::vector<centroid> buffer;
+    mutable double total=0,pending=0;
+
+    double xmin=std::numeric_limits<double>::infinity();
+    double xmax=-std::numeric_limits<double>::infinity();
+
+    size_t buffer_capacity() const { return 5*(size_t)std::ceil(compression); }
+
+    static constexpr double two_pi=6.283185307179586;
+
+    // k1 scale function and its inverse
+    double k_of_q(double q) const { return compression/two_pi*std::asin(2*q-1); }
+    double q_of_k(double k) const { return (std::sin(std::min(k,compression/4)*two_pi/compression)+1)/2; }
+
+    // Merge the buffer into the centroids: sweep in order of mean,
+    // combining neighbours while the combined centroid spans at most one
+    // unit of k.
+    void compress() const {
+        if (buffer.empty()) return;
+
+        buffer.insert(buffer.end(),centroids_.begin(),centroids_.end());
+        std::sort(buffer.begin(),buffer.end());
+        total+=pending;
+        pending=0;
+
+        centroids_.clear();
+        centroid cur=buffer.front();
+        double w_before=0;
+        double q_limit=q_of_k(k_of_q(0)+1);
+
+        for (size_t i=1; i<buffer.size(); ++i) {
+            const centroid &c=buffer[i];
+            if ((w_before+cur.weight+c.weight)/total<=q_limit) {
+                cur.weight+=c.weight;
+                cur.mean+=(c.mean-cur.mean)*c.weight/cur.weight;
+            }
+            else {
+                centroids_.push_back(cur);
+                w_before+=cur.weight;
+                q_limit=q_of_k(k_of_q(w_before/total)+1);
+                cur=c;
+            }
+        }
+        centroids_.push_back(cur);
+        buffer.clear();
+    }
+};
+
+} // namespace rdmini
+
+#endif // ndef TDIGEST_H_
@@ -0,0 +1,157 @@
+#ifndef TELEMETRY_H_
+#define TELEMETRY_H_
+
+/** Live telemetry of running ensembles.
+ *
+ * A telemetry region is a file, typically in /dev/shm, mapped shared by
+ * a simulation and by any number of monitoring processes. It holds one
+ * record per instance: the instance's status, current time, number of
+ * events so far, and the values of a selection of observables. Each
+ * record is guarded by a sequence lock: the simulation publishes a
+ * record without locks or system calls, and a monitor retries any read
+ * that overlaps a write.
+ *
+ * The layout, in native byte order, is:
+ *
+ *   header   magic "RDTELE1", version, the number of instances and of
+ *            observables, the record stride and offset, and the end time
+ *            of the run (0 if unknown);
+ *   names    a fixed-size, null-padded name per observable;
+ *   records  one per instance, each a cache line aligned sequence
+ *            number, status, time and event count (64 bits each), then
+ *            the observable values.
+ *
+ * The magic is written last, so a monitor attaching early sees either
+ * an incomplete header or a complete region.
+ */
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "rdmini/exceptions.h"
+
+namespace rdmini {
+
+namespace telemetry_format {
+    constexpr char file_magic[8]="RDTELE1";
+    constexpr uint32_t version=1;
+    constexpr size_t name_size=32;
+
+    enum status_type: uint64_t { pending=0, running=1, complete=2 };
+
+    struct file_header {
+        char magic[8];
+        uint32_t version;
+        uint32_t flags;
+        uint64_t n_instances;
+        uint64_t n_observables;
+        uint64_t record_stride;
+        uint64_t records_offset;
+        double t_end;
+        uint64_t reserved;
+    };
+
+    // The sequence number is odd while the record is being written.
+    struct record_header {
+        std::atomic<uint64_t> seq;
+        std::atomic<uint64_t> status;
+        std::atomic<double> t;
+        std::atomic<uint64_t> n_events;
+    };
+
+    static_assert(sizeof(record_header)==4*sizeof(uint64_t),"unexpected record padding");
+}
+
+/** Creates a telemetry region and publishes instance records to it.
+ *
+ * Records of different instances may be published concurrently; the
+ * record of any one instance must be published by one thread at a time.
+ * The region is shared with child processes created after construction.
+ * The file is left in place on destruction, for monitors to read final
+ * values. */
+
+class telemetry_writer {
+public:
+    telemetry_writer(const std::string &path,size_t n_instances,const std::vector<std::string> &observable_names,double t_end=0);
+    ~telemetry_writer();
+
+    telemetry_writer(const telemetry_writer &)=delete;
+    telemetry_writer &operator=(const telemetry_writer &)=delete;
+
+    size_t n_instances() const { return n_inst; }
+    size_t n_observables() const { return n_obs; }
+
+    /** Publish the state of instance: time t, n_events events, and the
+     * first n_observables() values from obs. */
+    template <typename Iter>
+    void publish(size_t instance,telemetry_format::status_type status,double t,uint64_t n_events,Iter obs) {
+        telemetry_format::record_header &r=record(instance);
+        std::atomic<double> *values=reinterpret_cast<std::atomic<double> *>(&r+1);
+
+        uint64_t seq=r.seq.load(std::memory_order_relaxed);
+        r.seq.store(seq+1,std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        r.status.store(status,std::memory_order_relaxed);
+        r.t.store(t,std::memory_order_relaxed);
+        r.n_events.store(n_events,std::memory_order_relaxed);
+        for (size_t o=0; o<n_obs; ++o, ++obs) values[o].store(*obs,std::memory_order_relaxed);
+
+        r.seq.store(seq+2,std::memory_order_release);
+    }
+
+private:
+    char *base=nullptr;
+    size_t size=0;
+    size_t n_inst=0,n_obs=0;
+    size_t stride=0,offset=0;
+
+    telemetry_format::record_header &record(size_t instance) {
+        return *reinterpret_cast<telemetry_format::record_header *>(base+offset+instance*stride);
+    }
+};
+
+/** Read-only view of a telemetry region, for monitors. */
+
+class telemetry_reader {
+public:
+    struct snapshot {
+        telemetry_format::status_type status;
+        double t;
+        uint64_t n_events;
+        std::vector<double> observables;
+    };
+
+    explicit telemetry_reader(const std::string &path);
+    ~telemetry_reader();
+
+    telemetry_reader(const telemetry_reader &)=delete;
+    telemetry_reader &operator=(const telemetry_reader &)=delete;
+
+    size_t n_instances() const { return n_inst; }
+    size_t n_observables() const { return names.size(); }
+    const std::vector<std::string> &observable_names() const { return names; }
+
+    /** End time of the run, or 0 if not known. */
+    double t_end() const { return t_end_; }
+
+    /** Read a consistent copy of the record of instance into s, retrying
+     * at most max_retries times if it is being written; returns false if
+     * no consistent copy was obtained. */
+    bool read(size_t instance,snapshot &s,unsigned max_retries=1000) const;
+
+private:
+    const char *base=nullptr;
+    size_t size=0;
+    size_t n_inst=0;
+    size_t stride=0,offset=0;
+    double t_end_=0;
+    std::vector<std::string> names;
+};
+
+} // namespace rdmini
+
+#endif // ndef TELEMETRY_H_
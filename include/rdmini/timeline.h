@@ -0,0 +1,173 @@
+#ifndef TIMELINE_H_
+#define TIMELINE_H_
+
+/** Timeline of thread activity, for trace viewers.
+ *
+ * Records timestamped spans (a name, begin and end times, and an
+ * optional instance or other integer argument) per thread, and writes
+ * them in the Chrome trace event JSON format, which chrome://tracing and
+ * Perfetto display as one track per thread.
+ *
+ * Each thread records completed spans into its own ring buffer of fixed
+ * capacity, without locks; when the buffer is full the oldest spans are
+ * overwritten, and the number dropped is reported in the trace. Span
+ * names must be string literals (or otherwise outlive the trace).
+ *
+ * Tracing is off until enabled with timeline::enable(); when off, a span
+ * costs one relaxed load and a branch.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "rdmini/timer.h"
+
+namespace rdmini {
+namespace timeline {
+
+constexpr int64_t no_arg=-1;
+constexpr size_t default_capacity=1<<16;
+
+namespace impl {
+    struct span_record {
+        const char *name;
+        uint64_t t0,t1;
+        int64_t arg;
+    };
+
+    struct thread_buffer {
+        std::string name;
+        std::vector<span_record> ring;
+        uint64_t n_recorded=0;
+
+        void push(const span_record &s) {
+            ring[n_recorded++%ring.size()]=s;
+        }
+    };
+
+    struct registry_type {
+        std::mutex mutex;
+        std::vector<std::unique_ptr<thread_buffer>> threads;
+        std::atomic<bool> enabled{false};
+        size_t capacity=default_capacity;
+        uint64_t t_start=0;
+    };
+
+    inline registry_type &registry() {
+        static registry_type R;
+        return R;
+    }
+
+    inline thread_buffer &this_thread_buffer() {
+        static thread_local thread_buffer *p=nullptr;
+        if (!p) {
+            auto &R=registry();
+            std::lock_guard<std::mutex> lock(R.mutex);
+            R.threads.emplace_back(new thread_buffer);
+            p=R.threads.back().get();
+            p->name="thread "+std::to_string(R.threads.size()-1);
+            p->ring.resize(R.capacity);
+        }
+        return *p;
+    }
+}
+
+/** Start tracing, with ring buffers of capacity spans per thread.
+ * Capacity applies to threads that have not yet recorded a span. */
+inline void enable(size_t capacity=default_capacity) {
+    auto &R=impl::registry();
+    {
+        std::lock_guard<std::mutex> lock(R.mutex);
+        R.capacity=capacity?capacity:1;
+        R.t_start=timer::tsc();
+    }
+    R.enabled.store(true,std::memory_order_relaxed);
+}
+
+inline void disable() {
+    impl::registry().enabled.store(false,std::memory_order_relaxed);
+}
+
+inline bool enabled() {
+    return impl::registry().enabled.load(std::memory_order_relaxed);
+}
+
+/** Name the track of the calling thread. */
+inline void name_thread(const std::string &name) {
+    if (enabled()) impl::this_thread_buffer().name=name;
+}
+
+/** Time stamp for record(), or 0 if not tracing. */
+inline uint64_t now() {
+    return enabled()?timer::tsc():0;
+}
+
+/** Record a span of the calling thread from t0 (as returned by now())
+ * to the present; nothing is recorded if t0 is 0. */
+inline void record(const char *name,uint64_t t0,int64_t arg=no_arg) {
+    if (t0) impl::this_thread_buffer().push(impl::span_record{name,t0,timer::tsc(),arg});
+}
+
+/** Records the enclosing scope as a span, if tracing. */
+struct span {
+    explicit span(const char *name_,int64_t arg_=no_arg): name(name_), arg(arg_), t0(now()) {}
+    ~span() { record(name,t0,arg); }
+
+    span(const span &)=delete;
+    span &operator=(const span &)=delete;
+
+private:
+    const char *name;
+    int64_t arg;
+    uint64_t t0;
+};
+
+/** Write the recorded spans of all threads as a Chrome trace; instance
+ * arguments are labelled arg_name. Recording threads must be quiescent. */
+inline void write_chrome_trace(std::ostream &O,const char *arg_name="instance") {
+    auto &R=impl::registry();
+    std::lock_guard<std::mutex> lock(R.mutex);
+
+    double us_per_tick=1.0e6/timer::tsc_rate();
+    auto us=[&](uint64_t t) { return t>R.t_start? (t-R.t_start)*us_per_tick: 0.0; };
+
+    std::ios::fmtflags flags=O.flags();
+    std::streamsize precision=O.precision();
+    O << std::fixed << std::setprecision(3);
+
+    O << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    uint64_t dropped=0;
+    const char *sep="";
+    for (size_t tid=0; tid<R.threads.size(); ++tid) {
+        const impl::thread_buffer &b=*R.threads[tid];
+
+        O << sep << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << tid << ",\"args\":{\"name\":\"" << b.name << "\"}}";
+        sep=",\n";
+
+        size_t n=std::min<uint64_t>(b.n_recorded,b.ring.size());
+        dropped+=b.n_recorded-n;
+        for (uint64_t i=b.n_recorded-n; i<b.n_recorded; ++i) {
+            const impl::span_record &s=b.ring[i%b.ring.size()];
+            O << sep << "{\"name\":\"" << s.name << "\",\"ph\":\"X\",\"pid\":0,\"tid\":" << tid
+              << ",\"ts\":" << us(s.t0) << ",\"dur\":" << us(s.t1)-us(s.t0);
+            if (s.arg!=no_arg) O << ",\"args\":{\"" << arg_name << "\":" << s.arg << "}";
+            O << '}';
+        }
+    }
+    O << "\n],\"otherData\":{\"dropped_spans\":" << dropped << "}}\n";
+
+    O.flags(flags);
+    O.precision(precision);
+}
+
+} // namespace timeline
+} // namespace rdmini
+
+#endif // ndef TIMELINE_H_
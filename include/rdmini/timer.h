@@ -6,6 +6,17 @@
 #endif
 
 #include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
 
 namespace rdmini {
 namespace timer {
@@ -110,6 +121,455 @@ struct timer_guard {
 template <typename Timer>
 inline timer_guard<Timer> guard(Timer &T) { return timer_guard<Timer>(T); }
 
+/** Hardware event counts, as read by a perf_counter_group.
+ *
+ * Bit e of valid is set if event e was counted. */
+
+enum perf_event_id {
+    perf_cycles, perf_instructions, perf_cache_misses, perf_branch_misses, perf_llc_misses,
+    n_perf_events
+};
+
+inline const char *perf_event_name(perf_event_id e) {
+    static const char *names[n_perf_events]={"cycles","instructions","cache_misses","branch_misses","llc_misses"};
+    return names[e];
+}
+
+struct perf_counts {
+    uint64_t value[n_perf_events]={};
+    unsigned valid=0;
+
+    bool has(perf_event_id e) const { return valid&(1u<<e); }
+
+    perf_counts &operator+=(const perf_counts &x) {
+        for (int e=0; e<n_perf_events; ++e) value[e]+=x.value[e];
+        valid|=x.valid;
+        return *this;
+    }
+
+    perf_counts operator-(const perf_counts &x) const {
+        perf_counts d;
+        for (int e=0; e<n_perf_events; ++e) d.value[e]=value[e]-x.value[e];
+        d.valid=valid&x.valid;
+        return d;
+    }
+
+    /** Instructions per cycle, or 0 if either was not counted. */
+    double ipc() const {
+        return has(perf_cycles) && has(perf_instructions) && value[perf_cycles]?
+            (double)value[perf_instructions]/value[perf_cycles]: 0;
+    }
+};
+
+/** Hardware event counters of the calling thread, read as a group.
+ *
+ * Counts user-space events of the thread that constructs it, through
+ * Linux perf_event_open. Events that cannot be counted (no PMU, as in
+ * many virtual machines, a restrictive perf_event_paranoid setting, or
+ * another platform) are left out, and marked invalid in the counts;
+ * if none can be counted, the group is simply unavailable. Counts are
+ * scaled for time multiplexed by the kernel.
+ *
+ * Has the interface of hr_timer, accumulating event counts rather than
+ * time, and so can be used with timer_guard. */
+
+class perf_counter_group {
+public:
+    typedef perf_counts value_type;
+
+    perf_counter_group();
+    ~perf_counter_group();
+
+    perf_counter_group(const perf_counter_group &)=delete;
+    perf_counter_group &operator=(const perf_counter_group &)=delete;
+
+    bool available() const { return valid!=0; }
+    bool available(perf_event_id e) const { return valid&(1u<<e); }
+
+    /** Reset accumulator, stop counting */
+    void reset() { a=perf_counts(); a.valid=valid; }
+
+    /** Resume counting from paused state */
+    void resume() { read(c0); }
+
+    /** Pause counting */
+    void stop() {
+        perf_counts c1;
+        read(c1);
+        a+=c1-c0;
+    }
+
+    void start() {
+        reset();
+        resume();
+    }
+
+    /** Return accumulated counts; only valid when paused. */
+    perf_counts counts() const { return a; }
+
+    /** Read the counts since construction. */
+    void read(perf_counts &c) const;
+
+private:
+    int fd[n_perf_events];
+    int leader=-1;
+    unsigned valid=0;
+    unsigned n_open=0;
+    perf_counts c0,a;
+};
+
+/** The counter group of the calling thread, opened on first use. */
+inline perf_counter_group &this_thread_counters() {
+    static thread_local std::unique_ptr<perf_counter_group> g;
+    if (!g) g.reset(new perf_counter_group);
+    return *g;
+}
+
+/** Time stamp counter: a cheap, monotonic tick count.
+ *
+ * Reads the processor time stamp counter where available (not
+ * serialising, so suitable only for regions of many instructions), and
+ * a steady clock in nanoseconds otherwise. */
+inline uint64_t tsc() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+/** Ticks of tsc() per second, calibrated once against a steady clock. */
+inline double tsc_rate() {
+    static const double rate=[]() {
+        typedef std::chrono::steady_clock clock;
+        auto c0=clock::now();
+        uint64_t t0=tsc();
+        while (clock::now()-c0<std::chrono::milliseconds(20)) {}
+        uint64_t t1=tsc();
+        return (t1-t0)/std::chrono::duration<double>(clock::now()-c0).count();
+    }();
+    return rate;
+}
+
+/** Hierarchical region profiler.
+ *
+ * Regions are named, registered once with profile_region(), and timed
+ * with profile_scope guards; a region entered within another is
+ * recorded as its child. Each thread accumulates ticks and call counts
+ * in its own tree, so that profiling involves no shared writes; trees
+ * are merged by region path when a report is made with profile_report().
+ *
+ * Profiling is off until enabled with profile_enable(); when off, a
+ * profile_scope costs one relaxed load and a branch. If enabled with
+ * counters, each region also accumulates the hardware events counted
+ * by the perf_counter_group of its thread, at the cost of two reads of
+ * the group (system calls) per call. */
+
+typedef unsigned region_id;
+
+struct profile_node {
+    std::string name;
+    uint64_t calls=0;
+    double seconds=0;   // summed over threads
+    unsigned threads=0; // threads that entered the region
+    perf_counts counts; // summed over threads, if counted
+    std::vector<profile_node> children;
+};
+
+namespace impl {
+    // per-thread tree of regions: nodes[0] is the root
+    struct thread_profile {
+        struct node {
+            region_id region;
+            size_t parent;
+            uint64_t ticks=0,calls=0;
+            perf_counts counts;
+            std::vector<size_t> children;
+
+            node(region_id region_,size_t parent_): region(region_), parent(parent_) {}
+        };
+
+        std::vector<node> nodes;
+        size_t current=0;
+
+        thread_profile() { nodes.emplace_back(0,0); }
+
+        size_t child(region_id r) {
+            for (size_t c: nodes[current].children)
+                if (nodes[c].region==r) return c;
+
+            size_t c=nodes.size();
+            nodes.emplace_back(r,current);
+            nodes[current].children.push_back(c);
+            return c;
+        }
+
+        size_t enter(region_id r) { return current=child(r); }
+
+        void exit(size_t n,uint64_t ticks,const perf_counts &counts) {
+            nodes[n].counts+=counts;
+            exit(n,ticks);
+        }
+
+        void exit(size_t n,uint64_t ticks) {
+            nodes[n].ticks+=ticks;
+            ++nodes[n].calls;
+            current=nodes[n].parent;
+        }
+
+        void add(region_id r,uint64_t ticks,uint64_t calls) {
+            size_t c=child(r);
+            nodes[c].ticks+=ticks;
+            nodes[c].calls+=calls;
+        }
+    };
+
+    struct profile_registry {
+        std::mutex mutex;
+        std::vector<std::string> names;
+        std::vector<std::unique_ptr<thread_profile>> threads;
+        std::atomic<bool> enabled{false};
+        std::atomic<bool> counting{false};
+    };
+
+    inline profile_registry &registry() {
+        static profile_registry R;
+        return R;
+    }
+
+    inline thread_profile &this_thread_profile() {
+        static thread_local thread_profile *p=nullptr;
+        if (!p) {
+            auto &R=registry();
+            std::lock_guard<std::mutex> lock(R.mutex);
+            R.threads.emplace_back(new thread_profile);
+            p=R.threads.back().get();
+        }
+        return *p;
+    }
+
+    inline void merge_profile(const thread_profile &T,size_t n,profile_node &into,double rate,const std::vector<std::string> &names) {
+        for (size_t c: T.nodes[n].children) {
+            const auto &x=T.nodes[c];
+            const std::string &name=names[x.region];
+
+            profile_node *m=nullptr;
+            for (auto &child: into.children)
+                if (child.name==name) m=&child;
+            if (!m) {
+                into.children.emplace_back();
+                m=&into.children.back();
+                m->name=name;
+            }
+
+            m->calls+=x.calls;
+            m->seconds+=x.ticks/rate;
+            m->counts+=x.counts;
+            ++m->threads;
+            merge_profile(T,c,*m,rate,names);
+        }
+    }
+
+    // restores stream format state on destruction
+    struct format_saver {
+        std::ostream &O;
+        std::ios::fmtflags flags;
+        std::streamsize precision;
+
+        explicit format_saver(std::ostream &O_): O(O_), flags(O_.flags()), precision(O_.precision()) {}
+        ~format_saver() { O.flags(flags); O.precision(precision); }
+    };
+
+    inline void print_profile(std::ostream &O,const profile_node &n,double parent_seconds,int depth) {
+        O << std::left << std::setw(32) << std::string(2*depth,' ')+n.name << std::right
+          << std::setw(12) << n.calls << std::setw(14) << std::fixed << std::setprecision(6) << n.seconds;
+        if (depth>0 && parent_seconds>0) O << std::setw(9) << std::setprecision(1) << 100*n.seconds/parent_seconds << '%';
+        else O << std::setw(10) << '-';
+        O << std::setw(9) << n.threads << '\n';
+        O.unsetf(std::ios::floatfield);
+
+        for (const auto &c: n.children) print_profile(O,c,n.seconds,depth+1);
+    }
+
+    inline void print_profile_counts(std::ostream &O,const profile_node &n,int depth) {
+        O << std::left << std::setw(32) << std::string(2*depth,' ')+n.name << std::right;
+        for (int e=0; e<n_perf_events; ++e) {
+            O << std::setw(16);
+            if (n.counts.has((perf_event_id)e)) O << n.counts.value[e];
+            else O << '-';
+        }
+        O << std::setw(8) << std::fixed << std::setprecision(2) << n.counts.ipc() << '\n';
+        O.unsetf(std::ios::floatfield);
+
+        for (const auto &c: n.children) print_profile_counts(O,c,depth+1);
+    }
+
+    inline void write_json_string(std::ostream &O,const std::string &s) {
+        O << '"';
+        for (char c: s) {
+            if (c=='"' || c=='\\') O << '\\';
+            O << c;
+        }
+        O << '"';
+    }
+
+    inline void write_profile_json(std::ostream &O,const profile_node &n) {
+        O << "{\"name\":";
+        write_json_string(O,n.name);
+        O << ",\"calls\":" << n.calls << ",\"seconds\":" << std::setprecision(9) << n.seconds
+          << ",\"threads\":" << n.threads;
+        if (n.counts.valid) {
+            O << ",\"counters\":{";
+            const char *sep="";
+            for (int e=0; e<n_perf_events; ++e) {
+                if (!n.counts.has((perf_event_id)e)) continue;
+                O << sep << '"' << perf_event_name((perf_event_id)e) << "\":" << n.counts.value[e];
+                sep=",";
+            }
+            O << '}';
+        }
+        O << ",\"children\":[";
+        for (size_t i=0; i<n.children.size(); ++i) {
+            if (i) O << ',';
+            write_profile_json(O,n.children[i]);
+        }
+        O << "]}";
+    }
+}
+
+/** Register (or look up) the region called name. Call once per site,
+ * e.g. to initialise a static local. */
+inline region_id profile_region(const std::string &name) {
+    auto &R=impl::registry();
+    std::lock_guard<std::mutex> lock(R.mutex);
+    for (size_t i=0; i<R.names.size(); ++i)
+        if (R.names[i]==name) return (region_id)i;
+
+    R.names.push_back(name);
+    return (region_id)(R.names.size()-1);
+}
+
+/** Enable or disable profiling; with counters, also count hardware
+ * events per region. */
+inline void profile_enable(bool on=true,bool counters=false) {
+    impl::registry().counting.store(on && counters,std::memory_order_relaxed);
+    impl::registry().enabled.store(on,std::memory_order_relaxed);
+}
+
+inline bool profiling() {
+    return impl::registry().enabled.load(std::memory_order_relaxed);
+}
+
+inline bool profile_counting() {
+    return impl::registry().counting.load(std::memory_order_relaxed);
+}
+
+/** Times the enclosing scope as region r, if profiling. */
+struct profile_scope {
+    explicit profile_scope(region_id r) {
+        if (!profiling()) return;
+
+        tp=&impl::this_thread_profile();
+        node=tp->enter(r);
+        if (profile_counting()) {
+            pc=&this_thread_counters();
+            if (pc->available()) pc->read(c0);
+            else pc=nullptr;
+        }
+        t0=tsc();
+    }
+
+    ~profile_scope() {
+        if (!tp) return;
+
+        uint64_t dt=tsc()-t0;
+        if (pc) {
+            perf_counts c1;
+            pc->read(c1);
+            tp->exit(node,dt,c1-c0);
+        }
+        else tp->exit(node,dt);
+    }
+
+    profile_scope(const profile_scope &)=delete;
+    profile_scope &operator=(const profile_scope &)=delete;
+
+private:
+    impl::thread_profile *tp=nullptr;
+    perf_counter_group *pc=nullptr;
+    size_t node=0;
+    uint64_t t0=0;
+    perf_counts c0;
+};
+
+/** Add ticks and calls measured by the caller to region r, as a child of
+ * the current region of this thread: for regions too short or frequent
+ * to time with a profile_scope each. */
+inline void profile_add(region_id r,uint64_t ticks,uint64_t calls) {
+    impl::this_thread_profile().add(r,ticks,calls);
+}
+
+/** Merge the regions of all threads into one tree, the children of an
+ * unnamed root. Profiled threads must be quiescent. */
+inline profile_node profile_report() {
+    profile_node root;
+    double rate=tsc_rate();
+
+    std::vector<std::string> names;
+    std::vector<impl::thread_profile *> threads;
+    {
+        auto &R=impl::registry();
+        std::lock_guard<std::mutex> lock(R.mutex);
+        names=R.names;
+        for (auto &t: R.threads) threads.push_back(t.get());
+    }
+    for (auto t: threads) impl::merge_profile(*t,0,root,rate,names);
+
+    for (const auto &c: root.children) root.seconds+=c.seconds;
+    return root;
+}
+
+/** Print the merged region tree: calls, thread-seconds, percentage of
+ * the parent region, and number of threads, by region. */
+inline void print_profile(std::ostream &O) {
+    profile_node root=profile_report();
+    impl::format_saver saved(O);
+    O << std::left << std::setw(32) << "region" << std::right << std::setw(12) << "calls"
+      << std::setw(14) << "time [s]" << std::setw(10) << "%parent" << std::setw(9) << "threads" << '\n';
+    for (const auto &c: root.children) impl::print_profile(O,c,root.seconds,0);
+
+    for (const auto &c: root.children) root.counts+=c.counts;
+    if (!root.counts.valid) return;
+
+    O << '\n' << std::left << std::setw(32) << "region" << std::right;
+    for (int e=0; e<n_perf_events; ++e) O << std::setw(16) << perf_event_name((perf_event_id)e);
+    O << std::setw(8) << "IPC" << '\n';
+    for (const auto &c: root.children) impl::print_profile_counts(O,c,0);
+}
+
+/** Write the merged region tree as JSON. */
+inline void write_profile_json(std::ostream &O) {
+    profile_node root=profile_report();
+    impl::format_saver saved(O);
+    O << "{\"tsc_rate\":" << std::setprecision(9) << tsc_rate() << ",\"regions\":[";
+    for (size_t i=0; i<root.children.size(); ++i) {
+        if (i) O << ',';
+        impl::write_profile_json(O,root.children[i]);
+    }
+    O << "]}\n";
+}
+
+/** Discard all accumulated profiles. Profiled threads must be quiescent. */
+inline void profile_reset() {
+    auto &R=impl::registry();
+    std::lock_guard<std::mutex> lock(R.mutex);
+    for (auto &t: R.threads) {
+        t->nodes.erase(t->nodes.begin()+1,t->nodes.end());
+        t->nodes[0].children.clear();
+        t->current=0;
+    }
+}
+
 }} // namespace rdmini::timer
 
 
@@ -0,0 +1,222 @@
+#ifndef TRAJECTORY_FILE_H_
+#define TRAJECTORY_FILE_H_
+
+/** Binary trajectory files.
+ *
+ * A trajectory file holds samples of an ensemble of simulations: each
+ * sample is an instance index, a time, and the population counts of
+ * every species in every cell, indexed by cell then species (as
+ * parallel_ssa::counts()). The layout, in native byte order, is:
+ *
+ *   header   magic "RDTRAJ1", version, n_species, n_cells, and the
+ *            species and cell names (length-prefixed), padded to 8 bytes;
+ *   chunks   columnar blocks of samples: the instance column (uint64),
+ *            then the time column (double), then the counts, padded to
+ *            8 bytes. Counts are stored either raw (int32, one row of
+ *            n_species*n_cells per sample), or delta encoded (see
+ *            delta_codec.h): n+1 byte offsets (uint64) of the encoded
+ *            samples, then the encoded bytes, with a keyframe at the
+ *            start of each instance's run;
+ *   index    one entry per chunk (offset, size, number of samples), then
+ *            one entry per run of consecutive samples of an instance
+ *            within a chunk (instance, chunk, first row, count and time
+ *            range), sorted by instance and time;
+ *   footer   the sizes and offsets of the two index tables, and the
+ *            magic "RDTRIDX".
+ *
+ * Within a chunk, samples are grouped by instance, and the samples of an
+ * instance are in the order appended, which must be time order.
+ *
+ * trajectory_encoder produces the byte stream incrementally, writing a
+ * chunk whenever enough samples have been appended, so that it can feed
+ * an arbitrary output stream. trajectory_file reads a file through a
+ * read-only memory mapping, and locates samples through the index.
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "rdmini/delta_codec.h"
+#include "rdmini/exceptions.h"
+
+namespace rdmini {
+
+namespace trajectory_format {
+    typedef int32_t count_type;
+
+    constexpr char file_magic[8]="RDTRAJ1";
+    constexpr char index_magic[8]="RDTRIDX";
+    constexpr uint32_t version=1;
+
+    enum chunk_encoding: uint32_t { raw=0, delta=1 };
+
+    struct file_header {
+        char magic[8];
+        uint32_t version;
+        uint32_t flags;
+        uint64_t n_species;
+        uint64_t n_cells;
+    };
+
+    struct chunk_entry {
+        uint64_t offset;
+        uint64_t size;
+        uint64_t n_samples;
+        uint32_t encoding;
+        uint32_t reserved;
+    };
+
+    struct run_entry {
+        uint64_t instance;
+        uint64_t chunk;
+        uint64_t first;
+        uint64_t count;
+        double t_first;
+        double t_last;
+    };
+
+    struct footer {
+        uint64_t n_chunks;
+        uint64_t chunk_table_offset;
+        uint64_t n_runs;
+        uint64_t run_table_offset;
+        char magic[8];
+    };
+}
+
+/** Incremental writer of the trajectory file byte stream.
+ *
+ * Every byte produced must be written, in order, to the same file: the
+ * encoder tracks file offsets itself. The header is written on the first
+ * call to append() or finish(). */
+
+class trajectory_encoder {
+public:
+    typedef trajectory_format::count_type count_type;
+
+    static constexpr size_t default_chunk_samples=4096;
+
+    trajectory_encoder(const std::vector<std::string> &species,const std::vector<std::string> &cells,
+                       size_t chunk_samples=default_chunk_samples,
+                       trajectory_format::chunk_encoding encoding=trajectory_format::delta,
+                       size_t keyframe_interval=delta_encoder<count_type>::default_keyframe_interval);
+
+    size_t width() const { return n_species*n_cells; }
+
+    /** Append a sample with width() counts; may write a chunk to O. */
+    template <typename Count>
+    void append(std::ostream &O,size_t instance,double t,const Count *counts) {
+        if (!started) write_header(O);
+
+        rows.push_back(row{instance,t,pending_counts.size()});
+        for (size_t i=0; i<width(); ++i) pending_counts.push_back((count_type)counts[i]);
+        if (rows.size()>=chunk_samples) write_chunk(O);
+    }
+
+    /** Write any pending samples and the index; no more samples may be
+     * appended. */
+    void finish(std::ostream &O);
+
+    /** Number of bytes produced so far. */
+    uint64_t bytes_written() const { return offset; }
+
+private:
+    struct row {
+        uint64_t instance;
+        double t;
+        size_t counts_offset;
+    };
+
+    std::vector<std::string> species_names,cell_names;
+    size_t n_species,n_cells;
+    size_t chunk_samples;
+    trajectory_format::chunk_encoding encoding;
+    size_t keyframe_interval;
+
+    bool started=false;
+    uint64_t offset=0;
+
+    std::vector<row> rows;
+    std::vector<count_type> pending_counts;
+
+    std::vector<trajectory_format::chunk_entry> chunks;
+    std::vector<trajectory_format::run_entry> runs;
+
+    void put(std::ostream &O,const void *data,size_t n);
+    void pad(std::ostream &O);
+    void write_header(std::ostream &O);
+    void write_chunk(std::ostream &O);
+};
+
+/** Memory-mapped trajectory file reader. */
+
+class trajectory_file {
+public:
+    typedef trajectory_format::count_type count_type;
+
+    /** Samples of one chunk, or of one instance, in columns. */
+    struct sample_columns {
+        std::vector<uint64_t> instance;
+        std::vector<double> t;
+        std::vector<count_type> counts;  // width() per sample
+
+        size_t size() const { return t.size(); }
+        const count_type *sample_counts(size_t i,size_t width) const { return &counts[i*width]; }
+    };
+
+    explicit trajectory_file(const std::string &path);
+    ~trajectory_file();
+
+    trajectory_file(const trajectory_file &)=delete;
+    trajectory_file &operator=(const trajectory_file &)=delete;
+
+    const std::vector<std::string> &species() const { return species_names; }
+    const std::vector<std::string> &cells() const { return cell_names; }
+    size_t width() const { return species_names.size()*cell_names.size(); }
+
+    size_t n_chunks() const { return n_chunk_entries; }
+    size_t n_samples() const;
+
+    /** Distinct instances in the file, in increasing order. */
+    std::vector<uint64_t> instances() const;
+
+    /** Decode chunk k. */
+    void read_chunk(size_t k,sample_columns &out) const;
+
+    /** All samples of instance, in time order; returns false if none. */
+    bool read_instance(uint64_t instance,sample_columns &out) const;
+
+    /** Last sample of instance at or before time t: sets t_sample and
+     * copies width() counts. Returns false if there is none. */
+    bool find(uint64_t instance,double t,double &t_sample,count_type *counts) const;
+
+private:
+    std::vector<std::string> species_names,cell_names;
+
+    const char *base=nullptr;
+    size_t size=0;
+
+    const trajectory_format::chunk_entry *chunk_table=nullptr;
+    size_t n_chunk_entries=0;
+    const trajectory_format::run_entry *run_table=nullptr;
+    size_t n_run_entries=0;
+
+    std::pair<const trajectory_format::run_entry *,const trajectory_format::run_entry *> runs_of(uint64_t instance) const;
+
+    // pointers to the columns of a chunk
+    const uint64_t *chunk_instances(size_t k) const;
+    const double *chunk_times(size_t k) const;
+    const count_type *chunk_counts(size_t k) const;          // raw
+    const uint64_t *chunk_sample_offsets(size_t k) const;    // delta
+    const unsigned char *chunk_sample_data(size_t k) const;  // delta
+
+    // append the counts of rows [first,first+n) of chunk k to out
+    void read_counts(size_t k,size_t first,size_t n,std::vector<count_type> &out) const;
+};
+
+} // namespace rdmini
+
+#endif // ndef TRAJECTORY_FILE_H_
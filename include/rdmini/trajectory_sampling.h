@@ -0,0 +1,133 @@
+#ifndef TRAJECTORY_SAMPLING_H_
+#define TRAJECTORY_SAMPLING_H_
+
+/** Sampling of trajectories, and CSV output of samples.
+ *
+ * A trajectory of one instance of a parallel simulator is run either for
+ * a number of events, sampled every dn events, or to an end time,
+ * sampled every dt; it can be run whole or resumed in slices of sample
+ * intervals from a cursor. Each instance draws from its own
+ * counter-based RNG stream, keyed on the global seed and the instance
+ * index, so that a trajectory does not depend on thread count,
+ * scheduling or the simulator slot it is run in.
+ *
+ * Samples of population counts are written as CSV rows
+ * 'instance,time,cell,<counts of each species>', one per cell.
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <sstream>
+#include <string>
+
+#include "rdmini/philox.h"
+#include "rdmini/rdmodel.h"
+#include "rdmini/variates.h"
+#include "rdmini/util/output_buffer.h"
+
+namespace rdmini {
+
+/** Run length and sample interval, by steps or by time, and RNG seed. */
+
+struct sampling_params {
+    size_t n_events=0;  // run by steps: number of events,
+    size_t dn=1;        // sampled every dn events
+    double t_end=0;     // run by time: end time,
+    double dt=0;        // sampled every dt
+    uint64_t seed=0;    // global RNG seed
+};
+
+/** Variates for the selector are generated in buffered blocks. */
+
+typedef buffered_variates<philox_engine> instance_rng;
+
+inline instance_rng make_instance_rng(const sampling_params &P,size_t instance) {
+    return instance_rng(philox_engine(P.seed,(uint32_t)instance));
+}
+
+/** Position of a trajectory within its run: simulator slot, events run
+ * (by steps) or simulated time reached (by time), and the next target to
+ * be recorded (see demo_sim). */
+
+struct trajectory_cursor {
+    size_t slot=0;
+    size_t instance=0;
+    size_t step=0;
+    double t=0;
+    size_t next_target=0;
+
+    trajectory_cursor() {}
+    trajectory_cursor(size_t slot_,size_t instance_): slot(slot_), instance(instance_) {}
+};
+
+/** Run at most max_intervals sample intervals of a trajectory by steps
+ * from its cursor, calling sample(t,last) at the end of each, where last
+ * is true for the final sample; return true if the trajectory is
+ * complete. */
+
+template <typename PSim,typename G,typename Sample>
+bool sample_intervals_by_steps(PSim &S,trajectory_cursor &c,G &g,const sampling_params &P,size_t max_intervals,Sample sample) {
+    for (size_t k=0; k<max_intervals && c.step<P.n_events; ++k, c.step+=P.dn) {
+        double t=S.advance_events(c.slot,P.dn,g);
+        sample(t,c.step+P.dn>=P.n_events);
+    }
+    return c.step>=P.n_events;
+}
+
+/** As above, by time; begin_interval(t) is called at the start of each
+ * sample interval ending at t, and may advance the trajectory within it. */
+
+template <typename PSim,typename G,typename Sample,typename Begin>
+bool sample_intervals_by_time(PSim &S,trajectory_cursor &c,G &g,const sampling_params &P,size_t max_intervals,Sample sample,Begin begin_interval) {
+    for (size_t k=0; k<max_intervals && c.t<P.t_end; ++k) {
+        begin_interval(c.t+P.dt);
+        c.t=S.advance(c.slot,c.t+P.dt,g);
+        sample(c.t,!(c.t<P.t_end));
+    }
+    return !(c.t<P.t_end);
+}
+
+template <typename PSim,typename G,typename Sample>
+bool sample_intervals_by_time(PSim &S,trajectory_cursor &c,G &g,const sampling_params &P,size_t max_intervals,Sample sample) {
+    return sample_intervals_by_time(S,c,g,P,max_intervals,sample,[](double) {});
+}
+
+template <typename PSim,typename G,typename Sample>
+bool sample_intervals(PSim &S,trajectory_cursor &c,G &g,const sampling_params &P,size_t max_intervals,Sample sample) {
+    if (P.n_events>0) return sample_intervals_by_steps(S,c,g,P,max_intervals,sample);
+    else return sample_intervals_by_time(S,c,g,P,max_intervals,sample);
+}
+
+/** CSV header of population count samples of model M. */
+
+inline std::string counts_csv_header(const rd_model &M) {
+    std::stringstream s;
+    s << "instance,time,cell";
+    for (size_t i=0; i<M.n_species(); ++i) s << ',' << M.species[i].name;
+    s << '\n';
+    return s.str();
+}
+
+/** Write one sample of population counts, indexed by cell then species,
+ * as CSV rows; counts are read as CountType. */
+
+template <typename CountType,typename Counts>
+void put_counts_csv(output_buffer &B,size_t instance,double t,const Counts &counts,size_t n_cells,size_t n_species) {
+    size_t offset=0;
+    for (size_t cell=0; cell<n_cells; ++cell) {
+        B.put_uint(instance);
+        B.put(',');
+        B.put_double(t);
+        B.put(',');
+        B.put_uint(cell);
+        for (size_t s=0; s<n_species; ++s) {
+            B.put(',');
+            B.put_int((CountType)counts[offset++]);
+        }
+        B.put('\n');
+    }
+}
+
+} // namespace rdmini
+
+#endif // ndef TRAJECTORY_SAMPLING_H_
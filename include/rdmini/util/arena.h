@@ -0,0 +1,138 @@
+#ifndef ARENA_H_
+#define ARENA_H_
+
+/** Cache-line aligned storage for per-instance simulation state.
+ *
+ * aligned_arena is a single uninitialised block, aligned to a cache line,
+ * from which per-instance records are carved at a fixed padded stride;
+ * optionally it is backed by transparent huge pages. Pages are not
+ * touched on allocation, so they are placed by first touch (see numa.h).
+ *
+ * aligned_allocator is a standard allocator that aligns each allocation
+ * to, and pads it to a multiple of, the cache line size, so that objects
+ * in different allocations never share a line.
+ */
+
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <utility>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+namespace rdmini {
+
+constexpr size_t cache_line_size=64;
+
+/** Round n up to a multiple of align (a power of two). */
+
+constexpr size_t round_up(size_t n,size_t align=cache_line_size) {
+    return (n+align-1)&~(align-1);
+}
+
+class aligned_arena {
+public:
+    static constexpr size_t huge_page_size=2*1024*1024;
+
+    aligned_arena() {}
+
+    explicit aligned_arena(size_t n,bool huge_pages=false) { allocate(n,huge_pages); }
+
+    aligned_arena(const aligned_arena &x) {
+        allocate(x.n,x.huge);
+        if (n) std::memcpy(p,x.p,n);
+    }
+
+    aligned_arena(aligned_arena &&x) { swap(x); }
+
+    aligned_arena &operator=(aligned_arena x) {
+        swap(x);
+        return *this;
+    }
+
+    ~aligned_arena() { release(); }
+
+    void swap(aligned_arena &x) {
+        std::swap(p,x.p);
+        std::swap(n,x.n);
+        std::swap(huge,x.huge);
+        std::swap(mapped,x.mapped);
+    }
+
+    char *data() { return p; }
+    const char *data() const { return p; }
+    size_t size() const { return n; }
+
+    bool huge_pages() const { return huge; }
+
+private:
+    char *p=nullptr;
+    size_t n=0;
+    bool huge=false;
+    bool mapped=false;
+
+    void allocate(size_t n_,bool huge_) {
+        n=n_;
+        huge=huge_;
+        if (!n) return;
+
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+        if (huge) {
+            void *m=mmap(nullptr,round_up(n,huge_page_size),PROT_READ|PROT_WRITE,MAP_PRIVATE|MAP_ANONYMOUS,-1,0);
+            if (m!=MAP_FAILED) {
+                madvise(m,round_up(n,huge_page_size),MADV_HUGEPAGE);
+                p=static_cast<char *>(m);
+                mapped=true;
+                return;
+            }
+            // fall back to ordinary pages
+        }
+#endif
+        void *m=nullptr;
+        if (posix_memalign(&m,cache_line_size,round_up(n))) throw std::bad_alloc();
+        p=static_cast<char *>(m);
+    }
+
+    void release() {
+        if (!p) return;
+#ifdef __linux__
+        if (mapped) munmap(p,round_up(n,huge_page_size));
+        else std::free(p);
+#else
+        std::free(p);
+#endif
+        p=nullptr;
+    }
+};
+
+template <typename T>
+struct aligned_allocator {
+    typedef T value_type;
+
+    aligned_allocator() {}
+    template <typename U>
+    aligned_allocator(const aligned_allocator<U> &) {}
+
+    T *allocate(size_t n) {
+        void *m=nullptr;
+        if (posix_memalign(&m,cache_line_size,round_up(n*sizeof(T)))) throw std::bad_alloc();
+        return static_cast<T *>(m);
+    }
+
+    void deallocate(T *p,size_t) { std::free(p); }
+
+    template <typename U>
+    struct rebind { typedef aligned_allocator<U> other; };
+
+    template <typename U>
+    bool operator==(const aligned_allocator<U> &) const { return true; }
+    template <typename U>
+    bool operator!=(const aligned_allocator<U> &) const { return false; }
+};
+
+} // namespace rdmini
+
+#endif // ndef ARENA_H_
@@ -0,0 +1,173 @@
+#ifndef NUMA_H_
+#define NUMA_H_
+
+/** Thread placement and NUMA topology helpers.
+ *
+ * Per-instance state is allocated and first touched by the thread that
+ * will simulate the instance, so that on NUMA systems its pages are
+ * local to that thread's node. Instances are assigned to threads in
+ * contiguous blocks (owned_block, block_owner), and parallel_for_owned
+ * runs each block on its owning thread.
+ *
+ * Topology is read from sysfs on Linux; elsewhere the system is treated
+ * as a single node, and pinning is unavailable.
+ */
+
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+#ifdef __linux__
+#include <dirent.h>
+#include <sched.h>
+#endif
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace rdmini {
+
+/** Range [first,last) of the n items owned by worker w of n_workers. */
+
+inline std::pair<size_t,size_t> owned_block(size_t w,size_t n_workers,size_t n) {
+    size_t q=n/n_workers, r=n%n_workers;
+    size_t first=w*q+(w<r?w:r);
+    return std::make_pair(first,first+q+(w<r));
+}
+
+/** Worker owning item j of n, consistent with owned_block. */
+
+inline size_t block_owner(size_t j,size_t n_workers,size_t n) {
+    size_t q=n/n_workers, r=n%n_workers;
+    size_t split=r*(q+1);
+    return j<split?j/(q+1):r+(j-split)/q;
+}
+
+inline size_t worker_count() {
+#ifdef _OPENMP
+    return omp_get_max_threads();
+#else
+    return 1;
+#endif
+}
+
+inline size_t worker_id() {
+#ifdef _OPENMP
+    return omp_get_thread_num();
+#else
+    return 0;
+#endif
+}
+
+/** Call f(j) for j in [0,n), each on the thread that owns j. */
+
+template <typename F>
+void parallel_for_owned(size_t n,F f) {
+    size_t n_workers=worker_count();
+
+    #pragma omp parallel num_threads(n_workers)
+    {
+        auto block=owned_block(worker_id(),n_workers,n);
+        for (size_t j=block.first; j<block.second; ++j) f(j);
+    }
+}
+
+/** NUMA node of CPU cpu, or 0 if unknown. */
+
+inline int numa_node_of_cpu(int cpu) {
+#ifdef __linux__
+    char path[64];
+    std::snprintf(path,sizeof(path),"/sys/devices/system/cpu/cpu%d",cpu);
+
+    DIR *dir=opendir(path);
+    if (!dir) return 0;
+
+    int node=0;
+    while (dirent *entry=readdir(dir)) {
+        if (std::strncmp(entry->d_name,"node",4)==0 && std::sscanf(entry->d_name+4,"%d",&node)==1) break;
+    }
+    closedir(dir);
+    return node;
+#else
+    return 0;
+#endif
+}
+
+/** Number of NUMA nodes with CPUs, or 1 if unknown. */
+
+inline int numa_node_count() {
+#ifdef __linux__
+    int n_nodes=0;
+    DIR *dir=opendir("/sys/devices/system/node");
+    if (!dir) return 1;
+
+    int node;
+    while (dirent *entry=readdir(dir)) {
+        if (std::strncmp(entry->d_name,"node",4)==0 && std::sscanf(entry->d_name+4,"%d",&node)==1 && node>=n_nodes)
+            n_nodes=node+1;
+    }
+    closedir(dir);
+    return n_nodes?n_nodes:1;
+#else
+    return 1;
+#endif
+}
+
+/** NUMA node of the CPU running the calling thread. */
+
+inline int current_numa_node() {
+#ifdef __linux__
+    int cpu=sched_getcpu();
+    return cpu<0?0:numa_node_of_cpu(cpu);
+#else
+    return 0;
+#endif
+}
+
+/** CPUs on which the process may run, in increasing order. */
+
+inline std::vector<int> allowed_cpus() {
+    std::vector<int> cpus;
+#ifdef __linux__
+    cpu_set_t set;
+    if (sched_getaffinity(0,sizeof(set),&set)==0) {
+        for (int cpu=0; cpu<CPU_SETSIZE; ++cpu)
+            if (CPU_ISSET(cpu,&set)) cpus.push_back(cpu);
+    }
+#endif
+    return cpus;
+}
+
+/** Pin each OpenMP thread to one allowed CPU, in order of thread number
+ * starting from the allowed CPU with index first_cpu, so that consecutive
+ * threads (and so consecutive instance blocks) share a node. Returns false
+ * if pinning is unsupported or fails. */
+
+inline bool pin_threads(size_t first_cpu=0) {
+#ifdef __linux__
+    std::vector<int> cpus=allowed_cpus();
+    if (cpus.empty()) return false;
+
+    bool ok=true;
+    #pragma omp parallel num_threads(worker_count())
+    {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpus[(first_cpu+worker_id())%cpus.size()],&set);
+        if (sched_setaffinity(0,sizeof(set),&set)!=0) {
+            #pragma omp atomic write
+            ok=false;
+        }
+    }
+    return ok;
+#else
+    return false;
+#endif
+}
+
+} // namespace rdmini
+
+#endif // ndef NUMA_H_
@@ -0,0 +1,160 @@
+#ifndef OUTPUT_BUFFER_H_
+#define OUTPUT_BUFFER_H_
+
+/** Growable character buffer with fast numeric formatting.
+ *
+ * Integers are converted two digits at a time from a lookup table, and
+ * doubles are formatted as by printf("%g"), which matches the default
+ * formatting of std::ostream; there is no locale or stream state. The
+ * buffer is written out with write(2).
+ *
+ * output_buffer is also a std::streambuf, so that code written for
+ * std::ostream can append to it through stream().
+ */
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <ostream>
+#include <streambuf>
+#include <string>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include <unistd.h>
+
+namespace rdmini {
+
+class output_buffer: public std::streambuf {
+public:
+    explicit output_buffer(size_t capacity=1<<16): buf(capacity?capacity:1), n(0) {}
+
+    output_buffer(const output_buffer &)=delete;
+    output_buffer &operator=(const output_buffer &)=delete;
+
+    const char *data() const { return buf.data(); }
+    size_t size() const { return n; }
+    bool empty() const { return n==0; }
+    void clear() { n=0; }
+
+    /** Exchange contents with x; any stream() of either is unaffected. */
+    void swap(output_buffer &x) {
+        buf.swap(x.buf);
+        std::swap(n,x.n);
+    }
+
+    /** A std::ostream appending to this buffer. */
+    std::ostream &stream() {
+        if (!os) os.reset(new std::ostream(this));
+        return *os;
+    }
+
+    void put(char c) {
+        reserve(1);
+        buf[n++]=c;
+    }
+
+    void write(const char *s,size_t len) {
+        reserve(len);
+        std::memcpy(&buf[n],s,len);
+        n+=len;
+    }
+
+    void write(const std::string &s) { write(s.data(),s.size()); }
+
+    void put_uint(uint64_t x) {
+        char tmp[20];
+        char *end=tmp+sizeof(tmp);
+        char *p=end;
+
+        while (x>=100) {
+            unsigned d=2*(unsigned)(x%100);
+            x/=100;
+            *--p=digit_pairs()[d+1];
+            *--p=digit_pairs()[d];
+        }
+        if (x>=10) {
+            unsigned d=2*(unsigned)x;
+            *--p=digit_pairs()[d+1];
+            *--p=digit_pairs()[d];
+        }
+        else *--p=(char)('0'+x);
+
+        write(p,end-p);
+    }
+
+    void put_int(int64_t x) {
+        if (x<0) {
+            put('-');
+            put_uint(~(uint64_t)x+1);
+        }
+        else put_uint((uint64_t)x);
+    }
+
+    /** Append x as printf("%g"), i.e. as std::ostream with default flags. */
+    void put_double(double x) {
+        constexpr size_t max_len=32;
+        reserve(max_len);
+        int len=std::snprintf(&buf[n],max_len,"%g",x);
+        if (len>0) n+=len;
+    }
+
+    /** Write the contents to fd, retrying partial writes, and clear. */
+    void write_to(int fd) {
+        const char *p=buf.data();
+        size_t left=n;
+        while (left>0) {
+            ssize_t k=::write(fd,p,left);
+            if (k<0) {
+                if (errno==EINTR) continue;
+                throw std::system_error(errno,std::generic_category(),"write");
+            }
+            p+=k;
+            left-=k;
+        }
+        n=0;
+    }
+
+protected:
+    int_type overflow(int_type c) override {
+        if (!traits_type::eq_int_type(c,traits_type::eof())) put(traits_type::to_char_type(c));
+        return traits_type::not_eof(c);
+    }
+
+    std::streamsize xsputn(const char *s,std::streamsize len) override {
+        write(s,(size_t)len);
+        return len;
+    }
+
+private:
+    std::vector<char> buf;
+    size_t n;
+    std::unique_ptr<std::ostream> os;
+
+    static const char *digit_pairs() {
+        static const char table[]=
+            "00010203040506070809"
+            "10111213141516171819"
+            "20212223242526272829"
+            "30313233343536373839"
+            "40414243444546474849"
+            "50515253545556575859"
+            "60616263646566676869"
+            "70717273747576777879"
+            "80818283848586878889"
+            "90919293949596979899";
+        return table;
+    }
+
+    void reserve(size_t len) {
+        if (n+len>buf.size()) buf.resize(std::max(2*buf.size(),n+len));
+    }
+};
+
+} // namespace rdmini
+
+#endif // ndef OUTPUT_BUFFER_H_
@@ -0,0 +1,100 @@
+#ifndef SPSC_QUEUE_H_
+#define SPSC_QUEUE_H_
+
+/** Bounded lock-free single-producer, single-consumer queue.
+ *
+ * A ring buffer of fixed power-of-two capacity. One thread may push and
+ * one (other) thread may pop concurrently without locking; the producer
+ * and consumer indices are kept on separate cache lines. Neither side
+ * ever blocks: try_push fails when the queue is full, and try_pop when
+ * it is empty.
+ */
+
+#include <atomic>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+#include "rdmini/util/arena.h"
+
+namespace rdmini {
+
+template <typename T>
+class spsc_queue {
+public:
+    /** Queue holding at least capacity items (rounded up to a power of two). */
+    explicit spsc_queue(size_t capacity=1024): buf(pow2_at_least(capacity)), mask(buf.size()-1) {}
+
+    spsc_queue(const spsc_queue &)=delete;
+    spsc_queue &operator=(const spsc_queue &)=delete;
+
+    size_t capacity() const { return buf.size(); }
+
+    /** Producer: append x, or return false if full. */
+    bool try_push(const T &x) {
+        size_t t=tail.load(std::memory_order_relaxed);
+        if (t-head_cache==buf.size()) {
+            head_cache=head.load(std::memory_order_acquire);
+            if (t-head_cache==buf.size()) return false;
+        }
+        buf[t&mask]=x;
+        tail.store(t+1,std::memory_order_release);
+        return true;
+    }
+
+    /** Consumer: pointer to the oldest item, or null if empty. The item
+     * remains valid until the next pop. */
+    T *front() {
+        size_t h=head.load(std::memory_order_relaxed);
+        if (h==tail_cache) {
+            tail_cache=tail.load(std::memory_order_acquire);
+            if (h==tail_cache) return nullptr;
+        }
+        return &buf[h&mask];
+    }
+
+    /** Consumer: remove the oldest item into x, or return false if empty. */
+    bool try_pop(T &x) {
+        T *p=front();
+        if (!p) return false;
+        x=std::move(*p);
+        pop();
+        return true;
+    }
+
+    /** Consumer: remove the oldest item; the queue must be non-empty. */
+    void pop() {
+        head.store(head.load(std::memory_order_relaxed)+1,std::memory_order_release);
+    }
+
+    /** Approximate emptiness test, exact when called from either end
+     * while the other is idle. */
+    bool empty() const {
+        return head.load(std::memory_order_acquire)==tail.load(std::memory_order_acquire);
+    }
+
+private:
+    static size_t pow2_at_least(size_t n) {
+        size_t p=1;
+        while (p<n) p<<=1;
+        return p;
+    }
+
+    std::vector<T> buf;
+    size_t mask;
+
+    // consumer side: read index, and its last seen value of tail
+    char pad0[cache_line_size];
+    std::atomic<size_t> head{0};
+    size_t tail_cache=0;
+
+    // producer side: write index, and its last seen value of head
+    char pad1[cache_line_size];
+    std::atomic<size_t> tail{0};
+    size_t head_cache=0;
+    char pad2[cache_line_size];
+};
+
+} // namespace rdmini
+
+#endif // ndef SPSC_QUEUE_H_
@@ -0,0 +1,68 @@
+#ifndef TRACKING_ALLOCATOR_H_
+#define TRACKING_ALLOCATOR_H_
+
+/** Allocator adaptor that counts the bytes it holds.
+ *
+ * tracking_allocator<T,Tag,Base> allocates through Base, and keeps the
+ * number of bytes currently allocated, their peak, and the number of
+ * allocations, in counters shared by all tracking allocators with the
+ * same Tag (of any value type). Counts are of requested bytes, before
+ * any padding by Base.
+ */
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+
+namespace rdmini {
+
+template <typename Tag>
+struct allocation_counter {
+    static std::atomic<size_t> &current() { static std::atomic<size_t> n(0); return n; }
+    static std::atomic<size_t> &peak() { static std::atomic<size_t> n(0); return n; }
+    static std::atomic<size_t> &allocations() { static std::atomic<size_t> n(0); return n; }
+
+    static void allocated(size_t bytes) {
+        size_t now=current().fetch_add(bytes)+bytes;
+        size_t p=peak().load();
+        while (now>p && !peak().compare_exchange_weak(p,now)) {}
+        ++allocations();
+    }
+
+    static void deallocated(size_t bytes) { current().fetch_sub(bytes); }
+};
+
+template <typename T,typename Tag,typename Base=std::allocator<T>>
+struct tracking_allocator {
+    typedef T value_type;
+    typedef allocation_counter<Tag> counter;
+
+    Base base;
+
+    tracking_allocator() {}
+    template <typename U,typename B>
+    tracking_allocator(const tracking_allocator<U,Tag,B> &x): base(x.base) {}
+
+    T *allocate(size_t n) {
+        T *p=std::allocator_traits<Base>::allocate(base,n);
+        counter::allocated(n*sizeof(T));
+        return p;
+    }
+
+    void deallocate(T *p,size_t n) {
+        counter::deallocated(n*sizeof(T));
+        std::allocator_traits<Base>::deallocate(base,p,n);
+    }
+
+    template <typename U>
+    struct rebind { typedef tracking_allocator<U,Tag,typename std::allocator_traits<Base>::template rebind_alloc<U>> other; };
+
+    template <typename U,typename B>
+    bool operator==(const tracking_allocator<U,Tag,B> &x) const { return base==x.base; }
+    template <typename U,typename B>
+    bool operator!=(const tracking_allocator<U,Tag,B> &x) const { return !(*this==x); }
+};
+
+} // namespace rdmini
+
+#endif // ndef TRACKING_ALLOCATOR_H_
@@ -0,0 +1,142 @@
+#ifndef WORK_STEALING_H_
+#define WORK_STEALING_H_
+
+/** Work-stealing execution of resumable tasks over the OpenMP thread team.
+ *
+ * Each worker thread owns a deque of tasks. A worker takes tasks from
+ * the back of its own deque, and when that is empty steals from the
+ * front of another worker's. A task that is not yet complete after a run
+ * is pushed back onto its home worker's deque, so that successive pieces
+ * of the same task are run in order, by one worker at a time, and
+ * preferably by the same worker.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "rdmini/timeline.h"
+#include "rdmini/util/numa.h"
+
+namespace rdmini {
+
+template <typename Task>
+class work_stealing_deques {
+public:
+    explicit work_stealing_deques(size_t n_workers_):
+        n_workers(n_workers_?n_workers_:1), deques(new deque_type[n_workers]) {}
+
+    size_t workers() const { return n_workers; }
+
+    /** Push task onto the back of worker w's deque. */
+    void push(size_t w,const Task &task) {
+        std::lock_guard<std::mutex> lock(deques[w].mutex);
+        deques[w].tasks.push_back(task);
+    }
+
+    /** Take a task for worker w: from the back of its own deque, or else
+     * stolen from the front of another's. Returns false if none found. */
+    bool take(size_t w,Task &task) {
+        if (pop_back(w,task)) return true;
+
+        for (size_t i=1; i<n_workers; ++i)
+            if (pop_front((w+i)%n_workers,task)) return true;
+
+        return false;
+    }
+
+private:
+    // padded to keep each worker's deque on its own cache line
+    struct deque_type {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+        char pad[64];
+    };
+
+    size_t n_workers;
+    std::unique_ptr<deque_type[]> deques;
+
+    bool pop_back(size_t w,Task &task) {
+        std::lock_guard<std::mutex> lock(deques[w].mutex);
+        if (deques[w].tasks.empty()) return false;
+
+        task=deques[w].tasks.back();
+        deques[w].tasks.pop_back();
+        return true;
+    }
+
+    bool pop_front(size_t w,Task &task) {
+        std::lock_guard<std::mutex> lock(deques[w].mutex);
+        if (deques[w].tasks.empty()) return false;
+
+        task=deques[w].tasks.front();
+        deques[w].tasks.pop_front();
+        return true;
+    }
+};
+
+/** Run tasks to completion with work stealing.
+ *
+ * run(task,worker) runs the next piece of task, updating it in place,
+ * and returns true if there is more to do. Each task i has a home worker
+ * home(i,n_workers): tasks are initially dealt to their home workers, so
+ * that each worker starts on the lowest indexed of its tasks, and an
+ * unfinished task is always requeued at home. Stolen pieces thus return
+ * to the worker that owns the task's data.
+ */
+
+template <typename Task,typename Run,typename Home>
+void run_work_stealing(const std::vector<Task> &tasks,Run run,Home home) {
+    size_t n_workers=worker_count();
+    if (tasks.empty()) return;
+
+    struct entry {
+        Task task;
+        size_t home;
+    };
+
+    work_stealing_deques<entry> D(n_workers);
+    for (size_t i=tasks.size(); i-->0; ) {
+        size_t w=home(i,n_workers);
+        D.push(w,entry{tasks[i],w});
+    }
+
+    std::atomic<size_t> remaining(tasks.size());
+
+    #pragma omp parallel num_threads(n_workers)
+    {
+        size_t w=worker_id();
+        entry e;
+        uint64_t t_idle=0; // start of a traced wait for work
+        while (remaining.load()>0) {
+            if (!D.take(w,e)) {
+                if (!t_idle) t_idle=timeline::now();
+                std::this_thread::yield();
+                continue;
+            }
+            timeline::record("idle",t_idle);
+            t_idle=0;
+
+            if (run(e.task,w)) D.push(e.home,e);
+            else --remaining;
+        }
+        timeline::record("idle",t_idle);
+    }
+}
+
+/** Run tasks to completion with work stealing, dealing tasks round-robin. */
+
+template <typename Task,typename Run>
+void run_work_stealing(const std::vector<Task> &tasks,Run run) {
+    run_work_stealing(tasks,run,[](size_t i,size_t n_workers) { return i%n_workers; });
+}
+
+} // namespace rdmini
+
+#endif // ndef WORK_STEALING_H_
@@ -0,0 +1,175 @@
+#ifndef VARIATES_H_
+#define VARIATES_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include <type_traits>
+
+/** Buffered generation of uniform and exponential variates.
+ *
+ * The SSA draws one uniform and one exponential variate per event.
+ * Drawing these one at a time costs a generator call, a conversion and
+ * a scalar log per event; buffered_variates instead refills blocks of
+ * each with loops that the compiler can vectorise, using a polynomial
+ * log with bounded error in place of std::log.
+ */
+
+namespace rdmini {
+
+namespace impl {
+    inline uint64_t double_bits(double x) {
+        uint64_t u;
+        std::memcpy(&u,&x,sizeof(u));
+        return u;
+    }
+
+    inline double bits_double(uint64_t u) {
+        double x;
+        std::memcpy(&x,&u,sizeof(x));
+        return x;
+    }
+}
+
+/** Natural logarithm for positive, normal, finite x.
+ *
+ * Reduces x to 2^e·m with m in [√½,√2), and evaluates log(m) as
+ * 2·atanh((m-1)/(m+1)) by its series to the s^17 term. The truncation
+ * error is below 4e-16 in absolute value; overall error is within a few
+ * ulp of the result. Branch-free, so that loops over it vectorise.
+ */
+
+inline double fast_log(double x) {
+    constexpr double ln2=0.6931471805599453094;
+    constexpr double sqrt2=1.4142135623730950488;
+
+    uint64_t u=impl::double_bits(x);
+    int32_t e=(int32_t)(u>>52)-1023;
+    double m=impl::bits_double((u&0x000fffffffffffffull)|0x3ff0000000000000ull);
+
+    bool big=m>sqrt2;
+    m=big?0.5*m:m;
+    e=big?e+1:e;
+
+    double s=(m-1)/(m+1);
+    double z=s*s;
+    double p=1.0/17;
+    p=p*z+1.0/15;
+    p=p*z+1.0/13;
+    p=p*z+1.0/11;
+    p=p*z+1.0/9;
+    p=p*z+1.0/7;
+    p=p*z+1.0/5;
+    p=p*z+1.0/3;
+    p=p*z+1.0;
+
+    return (double)e*ln2+2*s*p;
+}
+
+/** Apply fast_log to x[0..n), writing to out[0..n). */
+
+inline void fast_log(const double *x,double *out,size_t n) {
+    #pragma omp simd
+    for (size_t i=0; i<n; ++i) out[i]=fast_log(x[i]);
+}
+
+/** Detect generators that can fill a buffer with full-range 32-bit outputs
+ * through a generate(uint32_t *,size_t) method (e.g. philox_engine). */
+
+template <typename G>
+struct has_bulk_generate {
+private:
+    template <typename H>
+    static auto test(H *h) -> decltype(h->generate((uint32_t *)0,(size_t)0),std::true_type());
+
+    template <typename H>
+    static std::false_type test(...);
+
+public:
+    static constexpr bool value=decltype(test<G>(0))::value &&
+        std::is_same<typename G::result_type,uint32_t>::value &&
+        G::min()==0 && G::max()==0xffffffffu;
+};
+
+/** Per-instance source of buffered uniform and exponential variates.
+ *
+ * Wraps a uniform random bit generator G. uniform() returns values in
+ * [0,1), and exponential() returns unit rate exponential variates.
+ * ssa_direct::next() accepts a buffered_variates in place of a generator.
+ */
+
+template <typename G,size_t BlockSize=256>
+class buffered_variates {
+public:
+    typedef G generator_type;
+    static constexpr size_t block_size=BlockSize;
+
+    explicit buffered_variates(const G &g_=G()): g(g_), u_index(BlockSize), e_index(BlockSize) {}
+
+    double uniform() {
+        if (u_index==BlockSize) refill_uniform();
+        return u_buf[u_index++];
+    }
+
+    double exponential() {
+        if (e_index==BlockSize) refill_exponential();
+        return e_buf[e_index++];
+    }
+
+    /** Discard buffered variates; subsequent draws come from fresh blocks. */
+    void flush() { u_index=e_index=BlockSize; }
+
+    generator_type &generator() { return g; }
+    const generator_type &generator() const { return g; }
+
+private:
+    G g;
+
+    size_t u_index,e_index;
+    double u_buf[BlockSize];
+    double e_buf[BlockSize];
+
+    // fill out[0..BlockSize) with uniform values in [0,1), or in (0,1] if oc is true.
+    void fill_unit(double *out,bool oc) {
+        fill_unit(out,oc,std::integral_constant<bool,has_bulk_generate<G>::value>());
+    }
+
+    void fill_unit(double *out,bool oc,std::true_type) {
+        uint32_t raw[2*BlockSize];
+        g.generate(raw,2*BlockSize);
+
+        // Take 52 bits per value (32 from the first word, 20 from the second)
+        // as the mantissa of a double in [1,2); this avoids integer to
+        // floating point conversions, which vectorise poorly.
+        double a=oc?2.0:-1.0;
+        double b=oc?-1.0:1.0;
+        #pragma omp simd
+        for (size_t i=0; i<BlockSize; ++i) {
+            uint64_t m=((uint64_t)raw[2*i]<<20)|(uint64_t)(raw[2*i+1]>>12);
+            out[i]=a+b*impl::bits_double(0x3ff0000000000000ull|m);
+        }
+    }
+
+    void fill_unit(double *out,bool oc,std::false_type) {
+        std::uniform_real_distribution<double> U(0,1);
+        for (size_t i=0; i<BlockSize; ++i) out[i]=oc?1-U(g):U(g);
+    }
+
+    void refill_uniform() {
+        fill_unit(u_buf,false);
+        u_index=0;
+    }
+
+    void refill_exponential() {
+        fill_unit(e_buf,true);
+
+        #pragma omp simd
+        for (size_t i=0; i<BlockSize; ++i) e_buf[i]=-fast_log(e_buf[i]);
+        e_index=0;
+    }
+};
+
+} // namespace rdmini
+
+#endif // ndef VARIATES_H_
@@ -0,0 +1,148 @@
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// public headers
+#include "rdmini/event_trace.h"
+
+namespace rdmini {
+
+namespace ef=event_trace_format;
+
+constexpr size_t event_recorder::default_chunk_events;
+
+event_recorder::event_recorder(std::ostream &O_,size_t n_slots,size_t n_processes,size_t n_populations,size_t chunk_events_):
+    O(O_), chunk_events(chunk_events_?chunk_events_:1), slots(n_slots)
+{
+    ef::file_header h;
+    std::memset(&h,0,sizeof(h));
+    std::memcpy(h.magic,ef::file_magic,sizeof(h.magic));
+    h.version=ef::version;
+    h.n_processes=n_processes;
+    h.n_populations=n_populations;
+    put(&h,sizeof(h));
+}
+
+void event_recorder::put(const void *data,size_t n) {
+    O.write(static_cast<const char *>(data),n);
+    offset+=n;
+}
+
+void event_recorder::write_chunk(slot_buffer &b) {
+    if (b.n_events>0) {
+        static const char zeros[8]={0};
+
+        ef::chunk_header c;
+        std::memset(&c,0,sizeof(c));
+        c.instance=b.instance;
+        c.n_events=b.n_events;
+        c.t_start=b.t_start;
+        c.t_last=ef::bits_time(b.t_bits);
+        c.size=b.data.size();
+
+        std::lock_guard<std::mutex> lock(mutex);
+        put(&c,sizeof(c));
+        put(b.data.data(),b.data.size());
+        put(zeros,(8-offset%8)%8);
+    }
+
+    // the next chunk continues from the last event
+    b.t_start=ef::bits_time(b.t_bits);
+    b.n_events=0;
+    b.data.clear();
+}
+
+void event_recorder::start(size_t slot,uint64_t instance,double t0) {
+    slot_buffer &b=slots[slot];
+    write_chunk(b);
+
+    b.instance=instance;
+    b.t_start=t0;
+    b.t_bits=ef::time_bits(t0);
+}
+
+void event_recorder::flush(size_t slot) {
+    write_chunk(slots[slot]);
+}
+
+void event_recorder::finish() {
+    for (auto &b: slots) write_chunk(b);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    O.flush();
+}
+
+event_trace::event_trace(const std::string &path) {
+    int fd=open(path.c_str(),O_RDONLY);
+    if (fd<0) throw trajectory_io_error("unable to open event trace "+path);
+
+    struct stat st;
+    if (fstat(fd,&st)<0) {
+        close(fd);
+        throw trajectory_io_error("unable to stat event trace "+path);
+    }
+    size=st.st_size;
+
+    if (size<sizeof(ef::file_header)) {
+        close(fd);
+        throw trajectory_io_error("truncated event trace "+path);
+    }
+
+    void *p=mmap(nullptr,size,PROT_READ,MAP_PRIVATE,fd,0);
+    close(fd);
+    if (p==MAP_FAILED) throw trajectory_io_error("unable to map event trace "+path);
+    base=static_cast<const char *>(p);
+
+    try {
+        const auto &h=*reinterpret_cast<const ef::file_header *>(base);
+        if (std::memcmp(h.magic,ef::file_magic,sizeof(h.magic)))
+            throw trajectory_io_error("not an event trace: "+path);
+        if (h.version!=ef::version)
+            throw trajectory_io_error("unsupported event trace version in "+path);
+
+        n_proc=h.n_processes;
+        n_pop=h.n_populations;
+
+        size_t pos=sizeof(ef::file_header);
+        while (pos<size) {
+            if (pos+sizeof(ef::chunk_header)>size) throw trajectory_io_error("truncated chunk in event trace "+path);
+
+            const auto *c=reinterpret_cast<const ef::chunk_header *>(base+pos);
+            pos+=sizeof(ef::chunk_header);
+            if (c->size>size-pos) throw trajectory_io_error("truncated chunk in event trace "+path);
+
+            index[c->instance].push_back(c);
+            pos+=round_up(c->size,8);
+        }
+    }
+    catch (...) {
+        munmap(const_cast<char *>(base),size);
+        throw;
+    }
+}
+
+event_trace::~event_trace() {
+    munmap(const_cast<char *>(base),size);
+}
+
+std::vector<uint64_t> event_trace::instances() const {
+    std::vector<uint64_t> v;
+    for (const auto &i: index) v.push_back(i.first);
+    return v;
+}
+
+size_t event_trace::n_events(uint64_t instance) const {
+    auto i=index.find(instance);
+    if (i==index.end()) return 0;
+
+    size_t n=0;
+    for (const auto *c: i->second) n+=c->n_events;
+    return n;
+}
+
+} // namespace rdmini
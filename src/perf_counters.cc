@@ -0,0 +1,103 @@
+#include <cstdint>
+#include <cstring>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+// public headers
+#include "rdmini/timer.h"
+
+namespace rdmini {
+namespace timer {
+
+#ifdef __linux__
+
+namespace {
+    struct event_spec {
+        uint32_t type;
+        uint64_t config;
+    };
+
+    const event_spec event_specs[n_perf_events]={
+        {PERF_TYPE_HARDWARE,PERF_COUNT_HW_CPU_CYCLES},
+        {PERF_TYPE_HARDWARE,PERF_COUNT_HW_INSTRUCTIONS},
+        {PERF_TYPE_HARDWARE,PERF_COUNT_HW_CACHE_MISSES},
+        {PERF_TYPE_HARDWARE,PERF_COUNT_HW_BRANCH_MISSES},
+        {PERF_TYPE_HW_CACHE,PERF_COUNT_HW_CACHE_LL|(PERF_COUNT_HW_CACHE_OP_READ<<8)|(PERF_COUNT_HW_CACHE_RESULT_MISS<<16)}
+    };
+
+    int open_event(const event_spec &spec,int group_fd) {
+        perf_event_attr attr;
+        std::memset(&attr,0,sizeof(attr));
+        attr.size=sizeof(attr);
+        attr.type=spec.type;
+        attr.config=spec.config;
+        attr.exclude_kernel=1;
+        attr.exclude_hv=1;
+        attr.read_format=PERF_FORMAT_GROUP|PERF_FORMAT_TOTAL_TIME_ENABLED|PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+        return (int)syscall(SYS_perf_event_open,&attr,0,-1,group_fd,0);
+    }
+}
+
+perf_counter_group::perf_counter_group() {
+    // events are read back in the order they join the group; the first
+    // event opened leads the group
+    for (int e=0; e<n_perf_events; ++e) {
+        fd[e]=open_event(event_specs[e],leader);
+        if (fd[e]<0) continue;
+
+        if (leader<0) leader=fd[e];
+        valid|=1u<<e;
+        ++n_open;
+    }
+    reset();
+}
+
+perf_counter_group::~perf_counter_group() {
+    for (int e=n_perf_events-1; e>=0; --e)
+        if (fd[e]>=0) close(fd[e]);
+}
+
+void perf_counter_group::read(perf_counts &c) const {
+    c=perf_counts();
+    if (leader<0) return;
+
+    uint64_t buf[3+n_perf_events];
+    ssize_t n=::read(leader,buf,sizeof(buf));
+    if (n<(ssize_t)((3+n_open)*sizeof(uint64_t)) || buf[0]!=n_open) return;
+
+    // scale for multiplexing
+    uint64_t enabled=buf[1],running=buf[2];
+    double scale=running && running<enabled? (double)enabled/running: 1.0;
+
+    const uint64_t *value=buf+3;
+    for (int e=0; e<n_perf_events; ++e) {
+        if (!(valid&(1u<<e))) continue;
+        c.value[e]=scale==1.0? *value: (uint64_t)(*value*scale);
+        ++value;
+    }
+    c.valid=valid;
+}
+
+#else
+
+perf_counter_group::perf_counter_group() {
+    for (int e=0; e<n_perf_events; ++e) fd[e]=-1;
+    reset();
+}
+
+perf_counter_group::~perf_counter_group() {}
+
+void perf_counter_group::read(perf_counts &c) const {
+    c=perf_counts();
+}
+
+#endif
+
+} // namespace timer
+} // namespace rdmini
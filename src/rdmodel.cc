@@ -1,5 +1,7 @@
 #include <iostream>
 #include <iomanip>
+#include <set>
+#include <sstream>
 #include <string>
 #include <limits>
 
@@ -49,6 +51,39 @@ std::ostream &operator<<(std::ostream &O,const rd_model &M) {
         emit_reaction_expr(O,M,r.right);
         O << "\n";
     }
+    if (!M.observables.empty()) O << "observables:\n";
+    for (const auto &o: M.observables) {
+        O << " " << std::setw(10) << std::right << (o.name+":") << " ";
+        bool first=true;
+        for (const auto &sw: o.species) {
+            if (!first) O << " + ";
+            first=false;
+
+            if (sw.second!=1) O << sw.second << "*";
+            O << M.species[sw.first].name;
+        }
+        O << " in ";
+        if (o.cells.empty()) O << "all cells";
+        else O << "cells " << range_seq<size_t>(o.cells.begin(),o.cells.end());
+        O << "\n";
+    }
+    if (!M.stimuli.empty()) O << "stimuli:\n";
+    for (const auto &x: M.stimuli) {
+        O << "  t=" << x.t << ": ";
+        switch (x.kind) {
+        case stimulus_info::inject:
+        case stimulus_info::remove:
+            O << (x.kind==stimulus_info::inject?"inject ":"remove ") << x.count << " "
+              << M.species[x.species_id].name << " in ";
+            if (x.cells.empty()) O << "all cells";
+            else O << "cells " << range_seq<size_t>(x.cells.begin(),x.cells.end());
+            break;
+        case stimulus_info::set_rate:
+            O << "rate=" << x.rate << " for " << M.reactions[x.reaction_id].name;
+            break;
+        }
+        O << "\n";
+    }
     return O;
 }
 
@@ -157,6 +192,162 @@ static void parse_reaction(rd_model &M,const yaml_node_view &R) {
     }
 }
 
+// Parse observable info
+
+static void parse_observable(rd_model &M,const yaml_node_view &X) {
+    std::string name=check_or_make_unique_name(M.observables,X["name"],"_o");
+
+    try {
+        observable_info obs;
+        obs.name=name;
+
+        yaml_node_view species=X["species"];
+        if (!species || species.is_map())
+            throw model_io_error("improper species list in observable specification: "+X.where());
+
+        for (int i=0;i<species.size();++i) {
+            int j=M.species.index(species[i].str());
+            if (j<0) throw model_io_error("unknown species in observable specification: "+species[i].where());
+            obs.species.emplace_back((size_t)j,1.0);
+        }
+
+        if (yaml_node_view weights=X["weights"]) {
+            if (weights.is_map() || weights.size()!=species.size())
+                throw model_io_error("observable weights do not match species: "+weights.where());
+            for (int i=0;i<weights.size();++i) obs.species[i].second=std::stod(weights[i].str());
+        }
+
+        // union of the named cell sets; all cells if none given
+        if (yaml_node_view cells=X["cells"]) {
+            std::set<size_t> cell_ids;
+            for (int i=0;i<cells.size();++i) {
+                auto cs=M.cell_sets.find(cells[i].str());
+                if (cs==M.cell_sets.end())
+                    throw model_io_error("unknown cell set in observable specification: "+cells[i].where());
+                cell_ids.insert(cs->cells.begin(),cs->cells.end());
+            }
+            obs.cells.assign(cell_ids.begin(),cell_ids.end());
+        }
+
+        M.observables.insert(obs);
+    }
+    catch (yaml_error &error) {
+        throw model_io_error("parsing observable failure: "+error.where());
+    }
+}
+
+// Parse stimulus info: at a given time, either inject or remove a number
+// of molecules of a species in each cell of a list of cell sets (default
+// all cells), or set the rate constant of a reaction.
+
+static void parse_stimulus(rd_model &M,const yaml_node_view &X) {
+    try {
+        stimulus_info stim;
+
+        yaml_node_view time=X["time"];
+        if (!time || !time.is_scalar())
+            throw model_io_error("missing stimulus time: "+X.where());
+        stim.t=std::stod(time.str());
+        if (!(stim.t>=0)) throw model_io_error("negative stimulus time: "+time.where());
+
+        yaml_node_view inject=X["inject"],remove=X["remove"],rate=X["rate"];
+        if ((bool)inject+(bool)remove+(bool)rate!=1)
+            throw model_io_error("stimulus requires exactly one of inject, remove or rate: "+X.where());
+
+        if (rate) {
+            stim.kind=stimulus_info::set_rate;
+            stim.rate=std::stod(rate.str());
+            if (stim.rate<0) throw model_io_error("negative rate in stimulus: "+rate.where());
+
+            yaml_node_view reaction=X["reaction"];
+            int r=reaction?M.reactions.index(reaction.str()):-1;
+            if (r<0) throw model_io_error("unknown reaction in stimulus specification: "+X.where());
+            stim.reaction_id=r;
+        }
+        else {
+            stim.kind=inject?stimulus_info::inject:stimulus_info::remove;
+            long count=std::stol((inject?inject:remove).str());
+            if (count<0) throw model_io_error("negative count in stimulus: "+X.where());
+            stim.count=count;
+
+            yaml_node_view species=X["species"];
+            int j=species?M.species.index(species.str()):-1;
+            if (j<0) throw model_io_error("unknown species in stimulus specification: "+X.where());
+            stim.species_id=j;
+
+            if (yaml_node_view cells=X["cells"]) {
+                std::set<size_t> cell_ids;
+                for (int i=0;i<cells.size();++i) {
+                    auto cs=M.cell_sets.find(cells[i].str());
+                    if (cs==M.cell_sets.end())
+                        throw model_io_error("unknown cell set in stimulus specification: "+cells[i].where());
+                    cell_ids.insert(cs->cells.begin(),cs->cells.end());
+                }
+                stim.cells.assign(cell_ids.begin(),cell_ids.end());
+            }
+        }
+
+        M.stimuli.push_back(stim);
+    }
+    catch (yaml_error &error) {
+        throw model_io_error("parsing stimulus failure: "+error.where());
+    }
+    catch (std::logic_error &error) {
+        throw model_io_error("invalid number in stimulus specification: "+X.where());
+    }
+}
+
+// Parse observable definition NAME=TERMS[@CELLSETS]
+
+observable_info parse_observable(const rd_model &M,const std::string &spec) {
+    observable_info obs;
+
+    auto eq=spec.find('=');
+    if (eq==std::string::npos || eq==0) throw model_io_error("missing observable name in "+spec);
+    obs.name=spec.substr(0,eq);
+    if (M.species.index(obs.name)>=0 || M.observables.index(obs.name)>=0)
+        throw model_io_error("observable name already in use in "+spec);
+
+    std::string terms=spec.substr(eq+1);
+    auto at=terms.find('@');
+    if (at!=std::string::npos) {
+        std::set<size_t> cells;
+        std::istringstream sets(terms.substr(at+1));
+        std::string set_name;
+        while (std::getline(sets,set_name,',')) {
+            auto cs=M.cell_sets.find(set_name);
+            if (cs==M.cell_sets.end()) throw model_io_error("unknown cell set in observable "+spec);
+            cells.insert(cs->cells.begin(),cs->cells.end());
+        }
+        if (cells.empty()) throw model_io_error("empty cell set list in observable "+spec);
+        obs.cells.assign(cells.begin(),cells.end());
+        terms.resize(at);
+    }
+
+    std::istringstream items(terms);
+    std::string term;
+    while (std::getline(items,term,'+')) {
+        double weight=1;
+        auto star=term.find('*');
+        if (star!=std::string::npos) {
+            try {
+                weight=std::stod(term.substr(0,star));
+            }
+            catch (std::logic_error &) {
+                throw model_io_error("invalid weight in observable "+spec);
+            }
+            term=term.substr(star+1);
+        }
+
+        auto s_id=M.species.index(term);
+        if (s_id<0) throw model_io_error("unknown species in observable "+spec);
+        obs.species.emplace_back((size_t)s_id,weight);
+    }
+    if (obs.species.empty()) throw model_io_error("no species in observable "+spec);
+
+    return obs;
+}
+
 // Parse cell info
 
 static void parse_cells_selection(rd_model &M,const yaml_node_view &e) {
@@ -293,8 +484,46 @@ rd_model rd_model_read_yaml(yaml_parser Y,const std::string &model_name) {
 
         parse_reaction(M,e.value());
     }
+
+    // add all observables
+    for (int i=0;i<root.size();++i) {
+        yaml_node_view e=root[i];
+        if (e!="observable") continue;
+
+        parse_observable(M,e.value());
+    }
+
+    // add all stimuli
+    for (int i=0;i<root.size();++i) {
+        yaml_node_view e=root[i];
+        if (e!="stimulus") continue;
+
+        parse_stimulus(M,e.value());
+    }
     
     return M;
 }
 
+memory_usage rd_model::memory_report() const {
+    memory_usage m;
+
+    size_t neighbours=0;
+    for (const auto &c: cells) neighbours+=heap_bytes(c.neighbours);
+    m.add("model cells",heap_bytes(cells));
+    m.add("model neighbours",neighbours);
+
+    size_t sets=cell_sets.size()*sizeof(cell_set);
+    for (const auto &x: cell_sets) sets+=heap_bytes(x.cells);
+    m.add("model cell sets",sets);
+
+    m.add("model species, reactions",n_species()*sizeof(species_info)+n_reactions()*sizeof(reaction_info));
+
+    size_t obs=n_observables()*sizeof(observable_info);
+    for (const auto &x: observables) obs+=heap_bytes(x.species)+heap_bytes(x.cells);
+    size_t stim=heap_bytes(stimuli);
+    for (const auto &x: stimuli) stim+=heap_bytes(x.cells);
+    m.add("model observables, stimuli",obs+stim);
+    return m;
+}
+
 } // namespace rdmini
@@ -0,0 +1,132 @@
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// public headers
+#include "rdmini/telemetry.h"
+#include "rdmini/util/arena.h"
+
+namespace rdmini {
+
+namespace tf=telemetry_format;
+
+telemetry_writer::telemetry_writer(const std::string &path,size_t n_instances,const std::vector<std::string> &observable_names,double t_end):
+    n_inst(n_instances), n_obs(observable_names.size())
+{
+    stride=round_up(sizeof(tf::record_header)+n_obs*sizeof(double));
+    offset=round_up(sizeof(tf::file_header)+n_obs*tf::name_size);
+    size=offset+n_inst*stride;
+
+    int fd=open(path.c_str(),O_RDWR|O_CREAT|O_TRUNC,0666);
+    if (fd<0) throw telemetry_error("unable to create telemetry region "+path);
+
+    if (ftruncate(fd,size)<0) {
+        close(fd);
+        throw telemetry_error("unable to size telemetry region "+path);
+    }
+
+    void *p=mmap(nullptr,size,PROT_READ|PROT_WRITE,MAP_SHARED,fd,0);
+    close(fd);
+    if (p==MAP_FAILED) throw telemetry_error("unable to map telemetry region "+path);
+    base=static_cast<char *>(p);
+
+    // the region is zero-filled: all records are pending, with even
+    // sequence numbers
+    auto &h=*reinterpret_cast<tf::file_header *>(base);
+    h.version=tf::version;
+    h.n_instances=n_inst;
+    h.n_observables=n_obs;
+    h.record_stride=stride;
+    h.records_offset=offset;
+    h.t_end=t_end;
+
+    char *name=base+sizeof(tf::file_header);
+    for (const auto &s: observable_names) {
+        std::memcpy(name,s.data(),std::min(s.size(),tf::name_size-1));
+        name+=tf::name_size;
+    }
+
+    std::atomic_thread_fence(std::memory_order_release);
+    std::memcpy(h.magic,tf::file_magic,sizeof(h.magic));
+}
+
+telemetry_writer::~telemetry_writer() {
+    munmap(base,size);
+}
+
+telemetry_reader::telemetry_reader(const std::string &path) {
+    int fd=open(path.c_str(),O_RDONLY);
+    if (fd<0) throw telemetry_error("unable to open telemetry region "+path);
+
+    struct stat st;
+    if (fstat(fd,&st)<0) {
+        close(fd);
+        throw telemetry_error("unable to stat telemetry region "+path);
+    }
+    size=st.st_size;
+
+    if (size<sizeof(tf::file_header)) {
+        close(fd);
+        throw telemetry_error("incomplete telemetry region "+path);
+    }
+
+    void *p=mmap(nullptr,size,PROT_READ,MAP_SHARED,fd,0);
+    close(fd);
+    if (p==MAP_FAILED) throw telemetry_error("unable to map telemetry region "+path);
+    base=static_cast<const char *>(p);
+
+    const auto &h=*reinterpret_cast<const tf::file_header *>(base);
+    bool valid=!std::memcmp(h.magic,tf::file_magic,sizeof(h.magic));
+    std::atomic_thread_fence(std::memory_order_acquire);
+
+    if (!valid || h.version!=tf::version ||
+        h.records_offset<sizeof(tf::file_header)+h.n_observables*tf::name_size ||
+        h.record_stride<sizeof(tf::record_header)+h.n_observables*sizeof(double) ||
+        h.records_offset+h.n_instances*h.record_stride>size)
+    {
+        munmap(const_cast<char *>(base),size);
+        throw telemetry_error("not a telemetry region, or incomplete: "+path);
+    }
+
+    n_inst=h.n_instances;
+    stride=h.record_stride;
+    offset=h.records_offset;
+    t_end_=h.t_end;
+
+    const char *name=base+sizeof(tf::file_header);
+    for (size_t o=0; o<h.n_observables; ++o, name+=tf::name_size)
+        names.emplace_back(name,strnlen(name,tf::name_size));
+}
+
+telemetry_reader::~telemetry_reader() {
+    munmap(const_cast<char *>(base),size);
+}
+
+bool telemetry_reader::read(size_t instance,snapshot &s,unsigned max_retries) const {
+    // records are only ever read through atomic loads
+    auto &r=*reinterpret_cast<tf::record_header *>(const_cast<char *>(base+offset+instance*stride));
+    const std::atomic<double> *values=reinterpret_cast<const std::atomic<double> *>(&r+1);
+
+    s.observables.resize(names.size());
+    for (unsigned attempt=0; attempt<=max_retries; ++attempt) {
+        uint64_t seq=r.seq.load(std::memory_order_acquire);
+        if (seq&1) continue;
+
+        s.status=(tf::status_type)r.status.load(std::memory_order_relaxed);
+        s.t=r.t.load(std::memory_order_relaxed);
+        s.n_events=r.n_events.load(std::memory_order_relaxed);
+        for (size_t o=0; o<names.size(); ++o) s.observables[o]=values[o].load(std::memory_order_relaxed);
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (r.seq.load(std::memory_order_relaxed)==seq) return true;
+    }
+    return false;
+}
+
+} // namespace rdmini
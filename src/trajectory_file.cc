@@ -0,0 +1,331 @@
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// public headers
+#include "rdmini/trajectory_file.h"
+
+namespace rdmini {
+
+namespace tf=trajectory_format;
+
+constexpr size_t trajectory_encoder::default_chunk_samples;
+
+trajectory_encoder::trajectory_encoder(const std::vector<std::string> &species,const std::vector<std::string> &cells,
+                                       size_t chunk_samples_,tf::chunk_encoding encoding_,size_t keyframe_interval_):
+    species_names(species), cell_names(cells), n_species(species.size()), n_cells(cells.size()),
+    chunk_samples(chunk_samples_?chunk_samples_:1), encoding(encoding_), keyframe_interval(keyframe_interval_)
+{}
+
+void trajectory_encoder::put(std::ostream &O,const void *data,size_t n) {
+    O.write(static_cast<const char *>(data),n);
+    offset+=n;
+}
+
+void trajectory_encoder::pad(std::ostream &O) {
+    static const char zeros[8]={0};
+    put(O,zeros,(8-offset%8)%8);
+}
+
+void trajectory_encoder::write_header(std::ostream &O) {
+    tf::file_header h;
+    std::memset(&h,0,sizeof(h));
+    std::memcpy(h.magic,tf::file_magic,sizeof(h.magic));
+    h.version=tf::version;
+    h.n_species=n_species;
+    h.n_cells=n_cells;
+    put(O,&h,sizeof(h));
+
+    for (const auto *names: {&species_names,&cell_names}) {
+        for (const auto &name: *names) {
+            uint32_t n=name.size();
+            put(O,&n,sizeof(n));
+            put(O,name.data(),n);
+        }
+    }
+    pad(O);
+    started=true;
+}
+
+void trajectory_encoder::write_chunk(std::ostream &O) {
+    if (rows.empty()) return;
+
+    // group by instance, keeping each instance's samples in append order
+    std::stable_sort(rows.begin(),rows.end(),[](const row &a,const row &b) { return a.instance<b.instance; });
+
+    size_t n=rows.size();
+    tf::chunk_entry entry;
+    std::memset(&entry,0,sizeof(entry));
+    entry.offset=offset;
+    entry.n_samples=n;
+    entry.encoding=encoding;
+
+    for (const auto &r: rows) put(O,&r.instance,sizeof(uint64_t));
+    for (const auto &r: rows) put(O,&r.t,sizeof(double));
+
+    if (encoding==tf::delta) {
+        std::vector<unsigned char> data;
+        std::vector<uint64_t> sample_offsets;
+        delta_encoder<count_type> E(width(),keyframe_interval);
+
+        for (size_t i=0; i<n; ++i) {
+            if (i==0 || rows[i].instance!=rows[i-1].instance) E.reset();
+            sample_offsets.push_back(data.size());
+            E.encode(data,&pending_counts[rows[i].counts_offset]);
+        }
+        sample_offsets.push_back(data.size());
+
+        put(O,sample_offsets.data(),sample_offsets.size()*sizeof(uint64_t));
+        put(O,data.data(),data.size());
+    }
+    else {
+        for (const auto &r: rows) put(O,&pending_counts[r.counts_offset],width()*sizeof(count_type));
+    }
+    pad(O);
+
+    entry.size=offset-entry.offset;
+
+    for (size_t i=0; i<n; ) {
+        size_t j=i+1;
+        while (j<n && rows[j].instance==rows[i].instance) ++j;
+        runs.push_back(tf::run_entry{rows[i].instance,chunks.size(),i,j-i,rows[i].t,rows[j-1].t});
+        i=j;
+    }
+    chunks.push_back(entry);
+
+    rows.clear();
+    pending_counts.clear();
+}
+
+void trajectory_encoder::finish(std::ostream &O) {
+    if (!started) write_header(O);
+    write_chunk(O);
+
+    std::stable_sort(runs.begin(),runs.end(),[](const tf::run_entry &a,const tf::run_entry &b) {
+        return a.instance<b.instance || (a.instance==b.instance && a.t_first<b.t_first);
+    });
+
+    tf::footer f;
+    std::memset(&f,0,sizeof(f));
+
+    f.n_chunks=chunks.size();
+    f.chunk_table_offset=offset;
+    if (!chunks.empty()) put(O,chunks.data(),chunks.size()*sizeof(tf::chunk_entry));
+
+    f.n_runs=runs.size();
+    f.run_table_offset=offset;
+    if (!runs.empty()) put(O,runs.data(),runs.size()*sizeof(tf::run_entry));
+
+    std::memcpy(f.magic,tf::index_magic,sizeof(f.magic));
+    put(O,&f,sizeof(f));
+    O.flush();
+}
+
+trajectory_file::trajectory_file(const std::string &path) {
+    int fd=open(path.c_str(),O_RDONLY);
+    if (fd<0) throw trajectory_io_error("unable to open trajectory file "+path);
+
+    struct stat st;
+    if (fstat(fd,&st)<0) {
+        close(fd);
+        throw trajectory_io_error("unable to stat trajectory file "+path);
+    }
+    size=st.st_size;
+
+    if (size<sizeof(tf::file_header)+sizeof(tf::footer)) {
+        close(fd);
+        throw trajectory_io_error("truncated trajectory file "+path);
+    }
+
+    void *p=mmap(nullptr,size,PROT_READ,MAP_PRIVATE,fd,0);
+    close(fd);
+    if (p==MAP_FAILED) throw trajectory_io_error("unable to map trajectory file "+path);
+    base=static_cast<const char *>(p);
+
+    try {
+        const auto &h=*reinterpret_cast<const tf::file_header *>(base);
+        if (std::memcmp(h.magic,tf::file_magic,sizeof(h.magic)))
+            throw trajectory_io_error("not a trajectory file: "+path);
+        if (h.version!=tf::version)
+            throw trajectory_io_error("unsupported trajectory file version in "+path);
+
+        const auto &f=*reinterpret_cast<const tf::footer *>(base+size-sizeof(tf::footer));
+        if (std::memcmp(f.magic,tf::index_magic,sizeof(f.magic)))
+            throw trajectory_io_error("missing index in trajectory file "+path);
+
+        size_t pos=sizeof(tf::file_header);
+        auto read_names=[&](size_t n,std::vector<std::string> &names) {
+            for (size_t i=0; i<n; ++i) {
+                uint32_t len;
+                if (pos+sizeof(len)>size) throw trajectory_io_error("truncated header in "+path);
+                std::memcpy(&len,base+pos,sizeof(len));
+                pos+=sizeof(len);
+                if (pos+len>size) throw trajectory_io_error("truncated header in "+path);
+                names.push_back(std::string(base+pos,len));
+                pos+=len;
+            }
+        };
+        read_names(h.n_species,species_names);
+        read_names(h.n_cells,cell_names);
+
+        size_t index_end=size-sizeof(tf::footer);
+        if (f.chunk_table_offset+f.n_chunks*sizeof(tf::chunk_entry)>index_end ||
+            f.run_table_offset+f.n_runs*sizeof(tf::run_entry)>index_end)
+            throw trajectory_io_error("corrupt index in trajectory file "+path);
+
+        chunk_table=reinterpret_cast<const tf::chunk_entry *>(base+f.chunk_table_offset);
+        n_chunk_entries=f.n_chunks;
+        run_table=reinterpret_cast<const tf::run_entry *>(base+f.run_table_offset);
+        n_run_entries=f.n_runs;
+
+        for (size_t k=0; k<n_chunk_entries; ++k) {
+            const auto &c=chunk_table[k];
+            size_t columns_size=c.n_samples*(sizeof(uint64_t)+sizeof(double));
+
+            size_t min_size;
+            if (c.encoding==tf::raw) min_size=columns_size+c.n_samples*width()*sizeof(count_type);
+            else if (c.encoding==tf::delta) min_size=columns_size+(c.n_samples+1)*sizeof(uint64_t);
+            else throw trajectory_io_error("unsupported chunk encoding in "+path);
+
+            if (c.offset+c.size>f.chunk_table_offset || c.size<min_size)
+                throw trajectory_io_error("corrupt chunk in trajectory file "+path);
+
+            if (c.encoding==tf::delta) {
+                const uint64_t *offsets=chunk_sample_offsets(k);
+                if (min_size+offsets[c.n_samples]>c.size || !std::is_sorted(offsets,offsets+c.n_samples+1))
+                    throw trajectory_io_error("corrupt chunk in trajectory file "+path);
+            }
+        }
+        for (size_t r=0; r<n_run_entries; ++r) {
+            const auto &run=run_table[r];
+            if (run.chunk>=n_chunk_entries || run.first+run.count>chunk_table[run.chunk].n_samples)
+                throw trajectory_io_error("corrupt index in trajectory file "+path);
+        }
+    }
+    catch (...) {
+        munmap(const_cast<char *>(base),size);
+        throw;
+    }
+}
+
+trajectory_file::~trajectory_file() {
+    munmap(const_cast<char *>(base),size);
+}
+
+size_t trajectory_file::n_samples() const {
+    size_t n=0;
+    for (size_t k=0; k<n_chunk_entries; ++k) n+=chunk_table[k].n_samples;
+    return n;
+}
+
+std::vector<uint64_t> trajectory_file::instances() const {
+    std::vector<uint64_t> ids;
+    for (size_t r=0; r<n_run_entries; ++r)
+        if (ids.empty() || ids.back()!=run_table[r].instance) ids.push_back(run_table[r].instance);
+    return ids;
+}
+
+const uint64_t *trajectory_file::chunk_instances(size_t k) const {
+    return reinterpret_cast<const uint64_t *>(base+chunk_table[k].offset);
+}
+
+const double *trajectory_file::chunk_times(size_t k) const {
+    return reinterpret_cast<const double *>(base+chunk_table[k].offset+chunk_table[k].n_samples*sizeof(uint64_t));
+}
+
+const trajectory_file::count_type *trajectory_file::chunk_counts(size_t k) const {
+    return reinterpret_cast<const count_type *>(base+chunk_table[k].offset+chunk_table[k].n_samples*(sizeof(uint64_t)+sizeof(double)));
+}
+
+const uint64_t *trajectory_file::chunk_sample_offsets(size_t k) const {
+    return reinterpret_cast<const uint64_t *>(chunk_counts(k));
+}
+
+const unsigned char *trajectory_file::chunk_sample_data(size_t k) const {
+    return reinterpret_cast<const unsigned char *>(chunk_sample_offsets(k)+chunk_table[k].n_samples+1);
+}
+
+void trajectory_file::read_counts(size_t k,size_t first,size_t n,std::vector<count_type> &out) const {
+    if (chunk_table[k].encoding==tf::raw) {
+        const count_type *counts=chunk_counts(k)+first*width();
+        out.insert(out.end(),counts,counts+n*width());
+        return;
+    }
+
+    // decode from the last keyframe at or before first
+    const uint64_t *offsets=chunk_sample_offsets(k);
+    const unsigned char *data=chunk_sample_data(k);
+    const unsigned char *end=data+offsets[chunk_table[k].n_samples];
+
+    size_t i=first;
+    while (i>0 && !delta_decoder<count_type>::is_keyframe(data+offsets[i])) --i;
+
+    delta_decoder<count_type> D(width());
+    const unsigned char *p=data+offsets[i];
+    try {
+        for (; i<first+n; ++i) {
+            const count_type *counts=D.decode(p,end);
+            if (i>=first) out.insert(out.end(),counts,counts+width());
+        }
+    }
+    catch (invalid_value &E) {
+        throw trajectory_io_error(std::string("corrupt chunk in trajectory file: ")+E.what());
+    }
+}
+
+void trajectory_file::read_chunk(size_t k,sample_columns &out) const {
+    size_t n=chunk_table[k].n_samples;
+    out.instance.assign(chunk_instances(k),chunk_instances(k)+n);
+    out.t.assign(chunk_times(k),chunk_times(k)+n);
+    out.counts.clear();
+    read_counts(k,0,n,out.counts);
+}
+
+std::pair<const tf::run_entry *,const tf::run_entry *> trajectory_file::runs_of(uint64_t instance) const {
+    return std::equal_range(run_table,run_table+n_run_entries,tf::run_entry{instance,0,0,0,0,0},
+        [](const tf::run_entry &a,const tf::run_entry &b) { return a.instance<b.instance; });
+}
+
+bool trajectory_file::read_instance(uint64_t instance,sample_columns &out) const {
+    out.instance.clear();
+    out.t.clear();
+    out.counts.clear();
+
+    auto runs=runs_of(instance);
+    for (auto r=runs.first; r!=runs.second; ++r) {
+        const double *t=chunk_times(r->chunk)+r->first;
+
+        out.instance.insert(out.instance.end(),r->count,instance);
+        out.t.insert(out.t.end(),t,t+r->count);
+        read_counts(r->chunk,r->first,r->count,out.counts);
+    }
+    return runs.first!=runs.second;
+}
+
+bool trajectory_file::find(uint64_t instance,double t,double &t_sample,count_type *counts) const {
+    auto runs=runs_of(instance);
+
+    // last run starting at or before t
+    auto r=std::upper_bound(runs.first,runs.second,t,
+        [](double t,const tf::run_entry &run) { return t<run.t_first; });
+    if (r==runs.first) return false;
+    --r;
+
+    const double *times=chunk_times(r->chunk)+r->first;
+    size_t i=std::upper_bound(times,times+r->count,t)-times-1;
+
+    std::vector<count_type> sample;
+    read_counts(r->chunk,r->first+i,1,sample);
+
+    t_sample=times[i];
+    std::copy(sample.begin(),sample.end(),counts);
+    return true;
+}
+
+} // namespace rdmini
@@ -0,0 +1,53 @@
+#ifndef MODEL_FIXTURES_H_
+#define MODEL_FIXTURES_H_
+
+/** Test helper: small models, as YAML, shared between tests. */
+
+#include <string>
+
+// Dimerisation and decay in one cell: model "dimer", species A and B.
+
+static const std::string two_species_model=
+    "---\n"
+    "model: dimer\n"
+    "cells:\n"
+    "    wmvol:\n"
+    "        volume: 1\n"
+    "species:\n"
+    "    name: A\n"
+    "    concentration: 20\n"
+    "species:\n"
+    "    name: B\n"
+    "    concentration: 0\n"
+    "reaction:\n"
+    "    left: [ A, A ]\n"
+    "    right: [ B ]\n"
+    "    rate: 0.5\n"
+    "reaction:\n"
+    "    left: [ B ]\n"
+    "    right: [ ]\n"
+    "    rate: 1\n"
+    "...\n";
+
+// Decay of 50 A in one cell: model "decay", with observable twice_A.
+
+static const std::string decay_model=
+    "---\n"
+    "model: decay\n"
+    "cells:\n"
+    "    wmvol:\n"
+    "        volume: 1\n"
+    "species:\n"
+    "    name: A\n"
+    "    concentration: 50\n"
+    "reaction:\n"
+    "    left: [ A ]\n"
+    "    right: [ ]\n"
+    "    rate: 1\n"
+    "observable:\n"
+    "    name: twice_A\n"
+    "    species: [ A ]\n"
+    "    weights: [ 2 ]\n"
+    "...\n";
+
+#endif // ndef MODEL_FIXTURES_H_
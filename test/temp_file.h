@@ -0,0 +1,31 @@
+#ifndef TEMP_FILE_H_
+#define TEMP_FILE_H_
+
+/** Test helper: a uniquely named file in /tmp, removed on destruction. */
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include <stdlib.h>
+#include <unistd.h>
+
+struct temp_file {
+    std::string path;
+
+    explicit temp_file(const std::string &prefix="test") {
+        std::string pattern="/tmp/"+prefix+"_XXXXXX";
+        std::vector<char> name(pattern.begin(),pattern.end());
+        name.push_back(0);
+
+        int fd=mkstemp(name.data());
+        if (fd>=0) close(fd);
+        path=name.data();
+    }
+    ~temp_file() { std::remove(path.c_str()); }
+
+    temp_file(const temp_file &)=delete;
+    temp_file &operator=(const temp_file &)=delete;
+};
+
+#endif // ndef TEMP_FILE_H_
@@ -0,0 +1,151 @@
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "rdmini/ssa_pp_procsys.h"
+#include "rdmini/util/arena.h"
+
+using rdmini::cache_line_size;
+
+static bool line_aligned(const void *p) {
+    return (reinterpret_cast<uintptr_t>(p)%cache_line_size)==0;
+}
+
+TEST(arena,round_up) {
+    EXPECT_EQ(0u,rdmini::round_up(0));
+    EXPECT_EQ(64u,rdmini::round_up(1));
+    EXPECT_EQ(64u,rdmini::round_up(64));
+    EXPECT_EQ(128u,rdmini::round_up(65));
+    EXPECT_EQ(12u,rdmini::round_up(9,4));
+}
+
+TEST(arena,aligned_arena) {
+    for (bool huge: {false,true}) {
+        rdmini::aligned_arena a(1000,huge);
+        ASSERT_TRUE(line_aligned(a.data()));
+        EXPECT_EQ(1000u,a.size());
+        std::memset(a.data(),7,a.size());
+
+        rdmini::aligned_arena b(a);
+        ASSERT_TRUE(line_aligned(b.data()));
+        EXPECT_EQ(0,std::memcmp(a.data(),b.data(),1000));
+
+        const char *p=a.data();
+        rdmini::aligned_arena c(std::move(a));
+        EXPECT_EQ(p,c.data());
+        EXPECT_EQ(nullptr,a.data());
+    }
+}
+
+TEST(arena,aligned_allocator) {
+    std::vector<double,rdmini::aligned_allocator<double>> v;
+    for (int i=0; i<100; ++i) {
+        v.push_back(i);
+        ASSERT_TRUE(line_aligned(v.data()));
+    }
+
+    struct alignas(cache_line_size) padded { int x; };
+    std::vector<padded,rdmini::aligned_allocator<padded>> w(3);
+    for (const auto &x: w) EXPECT_TRUE(line_aligned(&x));
+}
+
+struct test_proc {
+    std::vector<size_t> left_,right_;
+    double rate_;
+
+    const std::vector<size_t> &left() const { return left_; }
+    const std::vector<size_t> &right() const { return right_; }
+    double rate() const { return rate_; }
+};
+
+// Per-instance records are line aligned and padded, and growth of the
+// arena preserves counts and propensities.
+
+TEST(arena,procsys_records) {
+    rdmini::ssa_pp_procsys<3> sys(5);
+
+    sys.add(test_proc{{0},{1},1.0});
+    for (size_t j=0; j<5; ++j) sys.set_count(0,10+j,j);
+
+    for (size_t k=1; k<40; ++k) sys.add(test_proc{{k},{k+1},1.0});
+
+    EXPECT_EQ(0u,sys.instance_stride()%cache_line_size);
+    for (size_t j=0; j<5; ++j) {
+        EXPECT_TRUE(line_aligned(sys.counts(j).begin()));
+        EXPECT_EQ(41u,sys.counts(j).size());
+        EXPECT_EQ(10+j,sys.count(0,j));
+        EXPECT_EQ(0,sys.count(40,j));
+        EXPECT_EQ(10.0+j,sys.propensity(0,j));
+        EXPECT_EQ(0.0,sys.propensity(39,j));
+    }
+}
+
+// Processes and observables added in a batch extend the records once, and
+// take their propensities and values from the existing counts.
+
+TEST(arena,procsys_batch_add) {
+    rdmini::ssa_pp_procsys<3> sys(3);
+
+    sys.add(test_proc{{0},{1},1.0});
+    for (size_t j=0; j<3; ++j) sys.set_count(0,4+j,j);
+
+    std::vector<test_proc> batch;
+    batch.push_back(test_proc{{0,0},{2},0.5});
+    for (size_t k=2; k<50; ++k) batch.push_back(test_proc{{k},{k+1},1.0});
+    sys.add(batch.begin(),batch.end());
+
+    std::vector<std::vector<std::pair<size_t,double>>> terms={{{0,1.0},{1,2.0}},{{50,1.0}}};
+    EXPECT_EQ(0u,sys.add_observables(terms.begin(),terms.end()));
+
+    ASSERT_EQ(50u,sys.size());
+    ASSERT_EQ(2u,sys.n_observables());
+    for (size_t j=0; j<3; ++j) {
+        double c=4.0+j;
+        EXPECT_EQ(51u,sys.counts(j).size());
+        EXPECT_EQ(c,sys.propensity(0,j));
+        EXPECT_EQ(0.5*c*(c-1),sys.propensity(1,j));
+        EXPECT_EQ(0.0,sys.propensity(49,j));
+        EXPECT_EQ(c,sys.observable(0,j));
+        EXPECT_EQ(0.0,sys.observable(1,j));
+
+        sys.apply(1,j);
+        EXPECT_EQ(c-2,sys.observable(0,j));
+        EXPECT_EQ(0.5*(c-2)*(c-3),sys.propensity(1,j));
+        EXPECT_EQ(1,sys.count(2,j));
+    }
+}
+
+// Bytes reserved for the caller lie within each instance's record, and
+// move with it as the record grows.
+
+TEST(arena,procsys_instance_bytes) {
+    rdmini::ssa_pp_procsys<3> sys(4);
+
+    sys.add(test_proc{{0},{1},1.0});
+    sys.reserve_instance_bytes(3*sizeof(double));
+    for (size_t j=0; j<4; ++j) {
+        double *x=reinterpret_cast<double *>(sys.instance_bytes(j));
+        EXPECT_EQ(0.0,x[0]);
+        EXPECT_EQ(0.0,x[2]);
+        x[0]=j;
+        x[2]=-(double)j;
+        sys.set_count(0,j,j);
+    }
+
+    for (size_t k=1; k<40; ++k) sys.add(test_proc{{k},{k+1},1.0});
+
+    EXPECT_EQ(0u,sys.instance_stride()%cache_line_size);
+    for (size_t j=0; j<4; ++j) {
+        const char *record=reinterpret_cast<const char *>(sys.counts(j).begin());
+        const char *bytes=sys.instance_bytes(j);
+        EXPECT_LE(record,bytes);
+        EXPECT_LE(bytes+3*sizeof(double),record+sys.instance_stride());
+
+        const double *x=reinterpret_cast<const double *>(bytes);
+        EXPECT_EQ((double)j,x[0]);
+        EXPECT_EQ(-(double)j,x[2]);
+        EXPECT_EQ((int)j,sys.count(0,j));
+    }
+}
@@ -0,0 +1,110 @@
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <random>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "rdmini/delta_codec.h"
+
+typedef std::vector<unsigned char> bytes;
+
+TEST(delta_codec,zigzag) {
+    EXPECT_EQ(0u,rdmini::zigzag_encode(0));
+    EXPECT_EQ(1u,rdmini::zigzag_encode(-1));
+    EXPECT_EQ(2u,rdmini::zigzag_encode(1));
+    EXPECT_EQ(3u,rdmini::zigzag_encode(-2));
+
+    for (int64_t x: {(int64_t)0,(int64_t)-7,(int64_t)123456789,std::numeric_limits<int64_t>::min(),std::numeric_limits<int64_t>::max()})
+        EXPECT_EQ(x,rdmini::zigzag_decode(rdmini::zigzag_encode(x)));
+}
+
+TEST(delta_codec,varint) {
+    bytes b;
+    rdmini::put_varint(b,0);
+    rdmini::put_varint(b,127);
+    rdmini::put_varint(b,128);
+    rdmini::put_varint(b,~(uint64_t)0);
+    EXPECT_EQ(1u+1u+2u+10u,b.size());
+
+    const unsigned char *p=b.data(),*end=p+b.size();
+    EXPECT_EQ(0u,rdmini::get_varint(p,end));
+    EXPECT_EQ(127u,rdmini::get_varint(p,end));
+    EXPECT_EQ(128u,rdmini::get_varint(p,end));
+    EXPECT_EQ(~(uint64_t)0,rdmini::get_varint(p,end));
+    EXPECT_EQ(end,p);
+
+    EXPECT_THROW(rdmini::get_varint(p,end),rdmini::invalid_value);
+}
+
+// A sparse random walk: a few counts change per sample.
+
+TEST(delta_codec,round_trip) {
+    constexpr size_t width=200;
+    constexpr size_t n=500;
+    constexpr size_t interval=16;
+
+    std::minstd_rand R;
+    std::uniform_int_distribution<size_t> I(0,width-1);
+    std::uniform_int_distribution<int> D(-3,3);
+
+    std::vector<std::vector<int32_t>> samples;
+    std::vector<int32_t> x(width,1000);
+    for (size_t k=0; k<n; ++k) {
+        for (int j=0; j<3; ++j) x[I(R)]+=D(R);
+        samples.push_back(x);
+    }
+
+    bytes b;
+    std::vector<size_t> offsets;
+    rdmini::delta_encoder<int32_t> E(width,interval);
+    for (const auto &s: samples) {
+        offsets.push_back(b.size());
+        E.encode(b,s);
+    }
+
+    // much smaller than the raw counts
+    EXPECT_LT(b.size(),n*width*sizeof(int32_t)/10);
+
+    rdmini::delta_decoder<int32_t> Dec(width);
+    const unsigned char *p=b.data(),*end=p+b.size();
+    for (size_t k=0; k<n; ++k) {
+        EXPECT_EQ(k%interval==0,Dec.is_keyframe(p)) << "sample " << k;
+        const int32_t *counts=Dec.decode(p,end);
+        ASSERT_TRUE(std::equal(samples[k].begin(),samples[k].end(),counts)) << "sample " << k;
+    }
+    EXPECT_EQ(end,p);
+
+    // start decoding from a later keyframe
+    rdmini::delta_decoder<int32_t> Mid(width);
+    p=b.data()+offsets[3*interval];
+    for (size_t k=3*interval; k<4*interval+5; ++k) {
+        const int32_t *counts=Mid.decode(p,end);
+        ASSERT_TRUE(std::equal(samples[k].begin(),samples[k].end(),counts));
+    }
+
+    // but not from a delta
+    rdmini::delta_decoder<int32_t> Bad(width);
+    p=b.data()+offsets[1];
+    EXPECT_THROW(Bad.decode(p,end),rdmini::invalid_value);
+}
+
+TEST(delta_codec,dense_change_is_keyframe) {
+    rdmini::delta_encoder<int32_t> E(4);
+    bytes b;
+    E.encode(b,std::vector<int32_t>{1,2,3,4});
+    size_t second=b.size();
+    E.encode(b,std::vector<int32_t>{1,2,3,5});
+    size_t third=b.size();
+    E.encode(b,std::vector<int32_t>{0,0,3,5});
+
+    EXPECT_TRUE(rdmini::delta_decoder<int32_t>::is_keyframe(&b[0]));
+    EXPECT_FALSE(rdmini::delta_decoder<int32_t>::is_keyframe(&b[second]));
+    EXPECT_TRUE(rdmini::delta_decoder<int32_t>::is_keyframe(&b[third]));
+
+    E.reset();
+    size_t fourth=b.size();
+    E.encode(b,std::vector<int32_t>{0,0,3,5});
+    EXPECT_TRUE(rdmini::delta_decoder<int32_t>::is_keyframe(&b[fourth]));
+}
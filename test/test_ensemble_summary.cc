@@ -0,0 +1,114 @@
+#include <cmath>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "rdmini/ensemble_summary.h"
+
+// Rows of CSV output, after the header, split into fields.
+
+static std::vector<std::vector<std::string>> csv_rows(const std::string &text) {
+    std::vector<std::vector<std::string>> rows;
+    std::istringstream in(text);
+    std::string line;
+    std::getline(in,line);
+    while (std::getline(in,line)) {
+        std::vector<std::string> fields;
+        std::istringstream l(line);
+        std::string field;
+        while (std::getline(l,field,',')) fields.push_back(field);
+        rows.push_back(fields);
+    }
+    return rows;
+}
+
+// Samples inserted out of time order on one thread (as when a thread
+// runs a later slice of one instance before an earlier slice of
+// another) are reported at their own times.
+
+TEST(ensemble_summary,out_of_order) {
+    rdmini::ensemble_summary E({"x"},0.5,2);
+
+    E.insert(0,3.0,std::vector<double>{6});
+    E.insert(0,1.0,std::vector<double>{2});
+    E.insert(1,1.0,std::vector<double>{4});
+    E.insert(1,0.0,std::vector<double>{0});
+
+    std::ostringstream out;
+    E.write(out);
+    auto rows=csv_rows(out.str());
+
+    ASSERT_EQ(3u,rows.size());
+    EXPECT_EQ((std::vector<std::string>{"0","x","1","0"}),std::vector<std::string>(rows[0].begin(),rows[0].begin()+4));
+    EXPECT_EQ((std::vector<std::string>{"1","x","2","3"}),std::vector<std::string>(rows[1].begin(),rows[1].begin()+4));
+    EXPECT_EQ((std::vector<std::string>{"3","x","1","6"}),std::vector<std::string>(rows[2].begin(),rows[2].begin()+4));
+}
+
+TEST(ensemble_summary,histogram) {
+    rdmini::ensemble_summary E({"x","y"},1,1,2,0,10);
+    for (double v: {-1.0,1.0,6.0,12.0}) E.insert(0,2.0,std::vector<double>{v,2*v});
+
+    std::ostringstream out;
+    E.write(out);
+    auto rows=csv_rows(out.str());
+
+    size_t n_fields=7+rdmini::ensemble_summary::quantiles().size()+4;
+    ASSERT_EQ(2u,rows.size());
+    ASSERT_EQ(n_fields,rows[0].size());
+    EXPECT_EQ("x",rows[0][1]);
+    EXPECT_EQ((std::vector<std::string>{"1","1","1","1"}),std::vector<std::string>(rows[0].end()-4,rows[0].end()));
+    EXPECT_EQ("y",rows[1][1]);
+    EXPECT_EQ((std::vector<std::string>{"1","1","0","2"}),std::vector<std::string>(rows[1].end()-4,rows[1].end()));
+}
+
+// Summaries packed by one process and merged by another match summaries
+// reduced in one process.
+
+TEST(ensemble_summary,packed) {
+    std::minstd_rand R;
+    std::normal_distribution<double> N(20,5);
+
+    rdmini::ensemble_summary A({"x","y"},1,1,4,0,40),B({"x","y"},1,1,4,0,40);
+    rdmini::ensemble_summary whole({"x","y"},1,2,4,0,40);
+    for (int i=0; i<2000; ++i) {
+        for (double t: {0.0,1.0,2.0}) {
+            std::vector<double> v={N(R),t*N(R)};
+            if (i%2) A.insert(0,t,v);
+            else B.insert(0,t,v);
+            whole.insert(i%2,t,v);
+        }
+    }
+
+    // sized for more sample times than are used
+    std::vector<char> packed(A.packed_size(5));
+    A.pack(packed.data(),5);
+    B.merge_packed(packed.data(),5);
+
+    std::ostringstream out,expected;
+    B.write(out);
+    whole.write(expected);
+    auto rows=csv_rows(out.str()),expected_rows=csv_rows(expected.str());
+
+    ASSERT_EQ(6u,rows.size());
+    ASSERT_EQ(expected_rows.size(),rows.size());
+    size_t n_quantiles=rdmini::ensemble_summary::quantiles().size();
+    for (size_t r=0; r<rows.size(); ++r) {
+        const auto &x=rows[r],&y=expected_rows[r];
+        ASSERT_EQ(y.size(),x.size());
+        for (size_t i=0; i<x.size(); ++i) {
+            if (i<3 || i==5 || i==6 || i>=7+n_quantiles) EXPECT_EQ(y[i],x[i]) << "row " << r << " field " << i;
+            else EXPECT_NEAR(std::stod(y[i]),std::stod(x[i]),1e-3*std::abs(std::stod(y[i]))+0.5) << "row " << r << " field " << i;
+        }
+    }
+}
+
+TEST(ensemble_summary,pack_too_many_times) {
+    rdmini::ensemble_summary A({"x"},1,1);
+    A.insert(0,3.0,std::vector<double>{1});
+
+    std::vector<char> packed(A.packed_size(3));
+    EXPECT_THROW(A.pack(packed.data(),3),rdmini::invalid_value);
+}
@@ -0,0 +1,130 @@
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "rdmini/event_trace.h"
+#include "rdmini/parallel_ssa.h"
+#include "rdmini/rdmodel.h"
+
+#include "model_fixtures.h"
+#include "temp_file.h"
+
+using rdmini::event_recorder;
+using rdmini::event_trace;
+
+using ssa=rdmini::parallel_ssa<3>;
+using recording_ssa=rdmini::parallel_ssa<3,rdmini::event_recording_observer>;
+
+struct event {
+    uint32_t k;
+    double t;
+
+    bool operator==(const event &x) const { return k==x.k && t==x.t; }
+};
+
+TEST(event_trace,round_trip) {
+    temp_file tmp;
+
+    // interleave two slots, with chunks smaller than the runs
+    std::vector<event> expected[3];
+    std::minstd_rand R;
+    {
+        std::ofstream O(tmp.path,std::ios::binary);
+        event_recorder E(O,2,10,4,7);
+
+        E.start(0,0,0);
+        E.start(1,1,0.5);
+        double t[2]={0,0.5};
+        for (int i=0; i<40; ++i) {
+            size_t slot=i%2;
+            uint32_t k=R()%10;
+            t[slot]+=std::ldexp((double)(R()%1000),-10);
+            E.record(slot,k,t[slot]);
+            expected[slot].push_back(event{k,t[slot]});
+        }
+
+        // slot 0 continues with instance 2
+        E.start(0,2,1.0);
+        rdmini::event_recording_observer observer(&E);
+        observer.on_event(0,3u,1.0,0.5);
+        observer.on_event(0,9u,1e6,1e6-1.0);
+        expected[2]={event{3,1.0},event{9,1e6}};
+
+        E.finish();
+        EXPECT_EQ((uint64_t)O.tellp(),E.bytes_written());
+    }
+
+    event_trace F(tmp.path);
+    EXPECT_EQ(10u,F.n_processes());
+    EXPECT_EQ(4u,F.n_populations());
+    EXPECT_EQ((std::vector<uint64_t>{0,1,2}),F.instances());
+
+    for (uint64_t i=0; i<3; ++i) {
+        std::vector<event> events;
+        EXPECT_EQ(expected[i].size(),F.replay(i,[&](uint32_t k,double t) { events.push_back(event{k,t}); }));
+        EXPECT_EQ(expected[i].size(),F.n_events(i));
+        EXPECT_EQ(expected[i],events);
+    }
+    EXPECT_EQ(0u,F.n_events(3));
+}
+
+TEST(event_trace,bad_file) {
+    temp_file tmp;
+    {
+        std::ofstream O(tmp.path);
+        O << "not an event trace, but long enough to have a header";
+    }
+    EXPECT_THROW(event_trace F(tmp.path),rdmini::trajectory_io_error);
+    EXPECT_THROW(event_trace F(tmp.path+".missing"),rdmini::trajectory_io_error);
+}
+
+// Replaying the recorded events reproduces the simulated trajectory.
+
+TEST(event_trace,replay_trajectory) {
+    temp_file tmp;
+    rdmini::rd_model M=rdmini::rd_model_read(two_species_model,"dimer");
+
+    std::vector<int> simulated;
+    {
+        recording_ssa S(2,M);
+        std::ofstream O(tmp.path,std::ios::binary);
+        event_recorder E(O,S.instances(),S.process_count(),S.population_size(),16);
+        S.observer().recorder=&E;
+
+        std::minstd_rand g;
+        for (size_t i=0; i<S.instances(); ++i) E.start(i,i,0);
+        for (int n=1; n<=10; ++n) {
+            for (size_t i=0; i<S.instances(); ++i) {
+                S.advance(i,(double)n,g);
+                simulated.push_back(S.count(i,0,0));
+                simulated.push_back(S.count(i,1,0));
+            }
+        }
+        E.finish();
+    }
+
+    event_trace F(tmp.path);
+    ssa S(2,M);
+    ASSERT_EQ(S.process_count(),F.n_processes());
+    ASSERT_EQ(S.population_size(),F.n_populations());
+
+    std::vector<int> replayed(simulated.size());
+    for (size_t i=0; i<2; ++i) {
+        int n=1;
+        auto sample=[&]() {
+            replayed[4*(n-1)+2*i]=S.count(i,0,0);
+            replayed[4*(n-1)+2*i+1]=S.count(i,1,0);
+            ++n;
+        };
+
+        F.replay(i,[&](uint32_t k,double t) {
+            while (n<=10 && t>n) sample();
+            S.replay(i,k,t);
+        });
+        while (n<=10) sample();
+    }
+    EXPECT_EQ(simulated,replayed);
+}
@@ -0,0 +1,87 @@
+// Counting is compiled in for this translation unit only; no other
+// object in the test instantiates the simulator templates.
+#ifndef RDMINI_HOT_COUNTERS
+#define RDMINI_HOT_COUNTERS
+#endif
+
+#include <random>
+#include <sstream>
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include "rdmini/hot_counters.h"
+#include "rdmini/parallel_ssa.h"
+#include "rdmini/rdmodel.h"
+
+namespace hc=rdmini::hot_counters;
+
+std::string two_reaction_model=
+    "---\n"
+    "model: pair\n"
+    "cells:\n"
+    "    wmvol:\n"
+    "        volume: 1\n"
+    "species:\n"
+    "    name: A\n"
+    "    concentration: 100\n"
+    "species:\n"
+    "    name: B\n"
+    "    concentration: 0\n"
+    "reaction:\n"
+    "    name: forward\n"
+    "    left: [ A ]\n"
+    "    right: [ B ]\n"
+    "    rate: 1\n"
+    "reaction:\n"
+    "    left: [ B ]\n"
+    "    right: [ ]\n"
+    "    rate: 2\n"
+    "...\n";
+
+TEST(hot_counters,ssa_counts) {
+    ASSERT_TRUE(hc::enabled);
+
+    rdmini::rd_model M=rdmini::rd_model_read(two_reaction_model,"pair");
+    rdmini::parallel_ssa<3> S(1,M);
+
+    hc::reset();
+    std::minstd_rand g;
+    S.advance(0,1.0,g);
+    uint64_t n=S.event_count(0);
+    ASSERT_LT(0u,n);
+
+    hc::counters C=hc::collect();
+    EXPECT_EQ(n,C.count[hc::events]);
+    ASSERT_LE(1u,C.process_events.size());
+
+    // A->B fires once per A consumed; B->0 once per B consumed
+    int a=S.count(0,0,0),b=S.count(0,1,0);
+    EXPECT_EQ((uint64_t)(100-a),C.process_events[0]);
+    EXPECT_EQ((uint64_t)(100-a-b),C.process_events.size()>1? C.process_events[1]: 0);
+
+    // each event is drawn, and one more draw is pending past t_end
+    EXPECT_EQ(n+1,C.count[hc::draws]);
+    EXPECT_EQ(C.count[hc::draws],C.count[hc::selections]);
+    EXPECT_LE(C.count[hc::selections],C.count[hc::scan_steps]);
+    EXPECT_GE(2*C.count[hc::selections],C.count[hc::scan_steps]);
+
+    // A->B changes A and B, notifying both processes; B->0 notifies one
+    EXPECT_EQ(2*C.process_events[0],C.process_notifies[0]);
+    EXPECT_EQ(C.count[hc::notifies],C.count[hc::propensity_updates]);
+    EXPECT_EQ(0u,C.count[hc::stimulus_redraws]);
+
+    std::ostringstream report;
+    hc::print_report(report,C,S.process_count(),1,[&](size_t k) { return S.process_name(M,k); });
+    EXPECT_NE(std::string::npos,report.str().find("#  events "+std::to_string(n)+","));
+    EXPECT_NE(std::string::npos,report.str().find("of 2 processes"));
+    EXPECT_NE(std::string::npos,report.str().find("#top 1 of 2 active processes"));
+}
+
+TEST(hot_counters,process_names) {
+    rdmini::rd_model M=rdmini::rd_model_read(two_reaction_model,"pair");
+    rdmini::parallel_ssa<3> S(1,M);
+
+    EXPECT_EQ("forward in cell 0",S.process_name(M,0));
+    EXPECT_EQ(M.reactions[1].name+" in cell 0",S.process_name(M,1));
+}
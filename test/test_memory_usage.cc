@@ -0,0 +1,83 @@
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "rdmini/memory_usage.h"
+#include "rdmini/parallel_ssa.h"
+#include "rdmini/rdmodel.h"
+#include "rdmini/util/tracking_allocator.h"
+
+#include "model_fixtures.h"
+
+using rdmini::memory_usage;
+
+TEST(memory_usage,totals) {
+    memory_usage m(10);
+    m.add("a",100,8);
+    m.add("b",20,0);
+
+    memory_usage x;
+    x.add("c",5,2);
+    m.add("x.",x);
+
+    ASSERT_EQ(3u,m.entries.size());
+    EXPECT_EQ("x.c",m.entries[2].name);
+    EXPECT_EQ(125u,m.shared_bytes());
+    EXPECT_EQ(10u,m.per_instance_bytes());
+    EXPECT_EQ(225u,m.total_bytes());
+    EXPECT_EQ(0u,m.instances_within(124));
+    EXPECT_EQ(7u,m.instances_within(200));
+}
+
+TEST(memory_usage,heap_bytes) {
+    std::vector<int> v;
+    v.reserve(10);
+    EXPECT_EQ(10*sizeof(int),rdmini::heap_bytes(v));
+
+    std::vector<std::vector<double>> vv(2);
+    vv[1].reserve(3);
+    EXPECT_EQ(vv.capacity()*sizeof(std::vector<double>)+3*sizeof(double),rdmini::heap_bytes(vv));
+}
+
+struct test_tag {};
+
+TEST(tracking_allocator,counts) {
+    typedef rdmini::allocation_counter<test_tag> counter;
+    EXPECT_EQ(0u,counter::current());
+    {
+        std::vector<double,rdmini::tracking_allocator<double,test_tag>> v(100);
+        EXPECT_EQ(100*sizeof(double),counter::current());
+
+        // rebound allocators share the tag's counters
+        std::vector<std::vector<char,rdmini::tracking_allocator<char,test_tag>>> w(1);
+        w[0].resize(10);
+        EXPECT_EQ(100*sizeof(double)+10,counter::current());
+    }
+    EXPECT_EQ(0u,counter::current());
+    EXPECT_EQ(100*sizeof(double)+10,counter::peak());
+    EXPECT_EQ(2u,counter::allocations());
+}
+
+TEST(memory_usage,parallel_ssa) {
+    rdmini::rd_model M=rdmini::rd_model_read(decay_model,"decay");
+    rdmini::parallel_ssa<3> S(5,M);
+    memory_usage m=S.memory_report();
+    EXPECT_EQ(5u,m.n_instances);
+
+    // per-instance records hold instance and selector state too
+    size_t selector=0,state=0,record=0;
+    for (const auto &e: m.entries) {
+        if (e.name=="selector propensities") selector=e.per_instance;
+        if (e.name=="instance state") state=e.per_instance;
+        if (e.name=="pop_count" || e.name=="propensity_tbl" || e.name=="obs_value" || e.name=="record padding")
+            record+=e.per_instance;
+    }
+    EXPECT_EQ(S.process_count()*sizeof(double),selector);
+    EXPECT_LT(0u,state);
+    EXPECT_EQ(0u,(record+state+selector)%rdmini::cache_line_size);
+
+    memory_usage mm=M.memory_report();
+    EXPECT_EQ(M.n_cells()*sizeof(rdmini::cell_info),mm.entries[0].shared);
+    EXPECT_EQ(0u,mm.per_instance_bytes());
+}
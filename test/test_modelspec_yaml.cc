@@ -158,3 +158,129 @@ TEST(yamlSpec,negativeVolume) {
     ASSERT_THROW(rdmini::rd_model_read(negative_volume_spec,"modelTest5"),rdmini::invalid_model);
 }
 
+
+TEST(yamlSpec,observables) {
+    std::string observable_spec=
+        "---\n"
+        "model: modelTest6\n"
+        "cells:\n"
+        "    wmvol:\n"
+        "        name: left\n"
+        "        volume: 1\n"
+        "    wmvol:\n"
+        "        name: right\n"
+        "        volume: 1\n"
+        "species:\n"
+        "    name: A\n"
+        "species:\n"
+        "    name: B\n"
+        "observable:\n"
+        "    name: all\n"
+        "    species: [ A, B ]\n"
+        "    weights: [ 1, 2.5 ]\n"
+        "observable:\n"
+        "    name: right_B\n"
+        "    species: B\n"
+        "    cells: right\n"
+        "...\n";
+
+    rdmini::rd_model M=rdmini::rd_model_read(observable_spec,"modelTest6");
+    ASSERT_EQ(2u,M.n_observables());
+
+    const auto &all=M.observables["all"];
+    ASSERT_EQ(2u,all.species.size());
+    EXPECT_EQ(0u,all.species[0].first);
+    EXPECT_EQ(1.0,all.species[0].second);
+    EXPECT_EQ(1u,all.species[1].first);
+    EXPECT_EQ(2.5,all.species[1].second);
+    EXPECT_TRUE(all.cells.empty());
+
+    const auto &right_B=M.observables["right_B"];
+    ASSERT_EQ(1u,right_B.species.size());
+    EXPECT_EQ(1u,right_B.species[0].first);
+    EXPECT_EQ(std::vector<size_t>{1},right_B.cells);
+
+    // unknown species, unknown cell sets and mismatched weights are errors
+    std::string bad_species=observable_spec;
+    bad_species.replace(bad_species.find("species: B\n    cells"),10,"species: C");
+    ASSERT_THROW(rdmini::rd_model_read(bad_species,"modelTest6"),rdmini::model_io_error);
+
+    std::string bad_cells=observable_spec;
+    bad_cells.replace(bad_cells.find("cells: right"),12,"cells: middle");
+    ASSERT_THROW(rdmini::rd_model_read(bad_cells,"modelTest6"),rdmini::model_io_error);
+
+    std::string bad_weights=observable_spec;
+    bad_weights.replace(bad_weights.find("[ 1, 2.5 ]"),10,"[ 1 ]");
+    ASSERT_THROW(rdmini::rd_model_read(bad_weights,"modelTest6"),rdmini::model_io_error);
+}
+
+TEST(yamlSpec,stimuli) {
+    std::string stimulus_spec=
+        "---\n"
+        "model: modelTest7\n"
+        "cells:\n"
+        "    wmvol:\n"
+        "        name: left\n"
+        "        volume: 1\n"
+        "    wmvol:\n"
+        "        name: right\n"
+        "        volume: 1\n"
+        "species:\n"
+        "    name: A\n"
+        "species:\n"
+        "    name: B\n"
+        "reaction:\n"
+        "    name: r\n"
+        "    left: [ A ]\n"
+        "    right: [ B ]\n"
+        "    rate: 1\n"
+        "stimulus:\n"
+        "    time: 2\n"
+        "    inject: 10\n"
+        "    species: B\n"
+        "    cells: right\n"
+        "stimulus:\n"
+        "    time: 1.5\n"
+        "    remove: 3\n"
+        "    species: A\n"
+        "stimulus:\n"
+        "    time: 3\n"
+        "    reaction: r\n"
+        "    rate: 0.25\n"
+        "...\n";
+
+    rdmini::rd_model M=rdmini::rd_model_read(stimulus_spec,"modelTest7");
+    ASSERT_EQ(3u,M.n_stimuli());
+
+    // stimuli are kept in order of specification
+    const auto &inject=M.stimuli[0];
+    EXPECT_EQ(2.0,inject.t);
+    EXPECT_EQ(rdmini::stimulus_info::inject,inject.kind);
+    EXPECT_EQ(1u,inject.species_id);
+    EXPECT_EQ(10u,inject.count);
+    EXPECT_EQ(std::vector<size_t>{1},inject.cells);
+
+    const auto &remove=M.stimuli[1];
+    EXPECT_EQ(rdmini::stimulus_info::remove,remove.kind);
+    EXPECT_EQ(0u,remove.species_id);
+    EXPECT_EQ(3u,remove.count);
+    EXPECT_TRUE(remove.cells.empty());
+
+    const auto &set_rate=M.stimuli[2];
+    EXPECT_EQ(rdmini::stimulus_info::set_rate,set_rate.kind);
+    EXPECT_EQ(0u,set_rate.reaction_id);
+    EXPECT_EQ(0.25,set_rate.rate);
+
+    // unknown reactions, missing times and ambiguous stimuli are errors
+    std::string bad_reaction=stimulus_spec;
+    bad_reaction.replace(bad_reaction.find("reaction: r\n"),12,"reaction: s\n");
+    ASSERT_THROW(rdmini::rd_model_read(bad_reaction,"modelTest7"),rdmini::model_io_error);
+
+    std::string bad_time=stimulus_spec;
+    bad_time.replace(bad_time.find("time: 1.5"),9,"when: 1.5");
+    ASSERT_THROW(rdmini::rd_model_read(bad_time,"modelTest7"),rdmini::model_io_error);
+
+    std::string ambiguous=stimulus_spec;
+    ambiguous.replace(ambiguous.find("remove: 3"),9,"remove: 3\n    inject: 3");
+    ASSERT_THROW(rdmini::rd_model_read(ambiguous,"modelTest7"),rdmini::model_io_error);
+}
@@ -0,0 +1,94 @@
+#include <atomic>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "rdmini/ssa_pp_procsys.h"
+#include "rdmini/util/numa.h"
+
+TEST(numa,owned_block) {
+    for (size_t n: {0u,1u,5u,16u,1001u}) {
+        for (size_t n_workers: {1u,3u,4u,7u}) {
+            size_t next=0;
+            for (size_t w=0; w<n_workers; ++w) {
+                auto block=rdmini::owned_block(w,n_workers,n);
+                ASSERT_EQ(next,block.first);
+                ASSERT_LE(block.second-block.first,n/n_workers+1);
+                for (size_t j=block.first; j<block.second; ++j)
+                    ASSERT_EQ(w,rdmini::block_owner(j,n_workers,n));
+                next=block.second;
+            }
+            ASSERT_EQ(n,next);
+        }
+    }
+}
+
+TEST(numa,parallel_for_owned) {
+    constexpr size_t n=1000;
+    std::vector<std::atomic<int>> visits(n);
+    for (auto &v: visits) v=0;
+
+    size_t n_workers=rdmini::worker_count();
+    std::vector<size_t> owner(n);
+    rdmini::parallel_for_owned(n,[&](size_t j) {
+        ++visits[j];
+        owner[j]=rdmini::worker_id();
+    });
+
+    for (size_t j=0; j<n; ++j) {
+        EXPECT_EQ(1,visits[j]);
+        EXPECT_EQ(rdmini::block_owner(j,n_workers,n),owner[j]);
+    }
+}
+
+TEST(numa,topology) {
+    EXPECT_GE(rdmini::numa_node_count(),1);
+    EXPECT_GE(rdmini::current_numa_node(),0);
+    EXPECT_LT(rdmini::current_numa_node(),rdmini::numa_node_count());
+}
+
+struct test_proc {
+    std::vector<size_t> left_,right_;
+    double rate_;
+
+    const std::vector<size_t> &left() const { return left_; }
+    const std::vector<size_t> &right() const { return right_; }
+    double rate() const { return rate_; }
+};
+
+TEST(numa,replicate_tables) {
+    typedef rdmini::ssa_pp_procsys<3> procsys;
+    constexpr size_t n_instance=10;
+
+    std::vector<test_proc> procs={
+        {{0,0},{1},0.5},
+        {{1},{},1.0},
+        {{0,1},{2},2.0}
+    };
+
+    procsys A(n_instance),B(n_instance);
+    A.add(procs.begin(),procs.end());
+    B.add(procs.begin(),procs.end());
+
+    // replicate B's tables as if threads alternated between two nodes
+    B.replicate_tables(2,[](size_t w) { return w%2; });
+    EXPECT_EQ(2u,B.table_replicas());
+
+    for (size_t j=0; j<n_instance; ++j) {
+        for (size_t p=0; p<3; ++p) {
+            A.set_count(p,5+j+p,j);
+            B.set_count(p,5+j+p,j);
+        }
+        A.apply(0,j);
+        B.apply(0,j);
+        A.apply(2,j);
+        B.apply(2,j);
+
+        for (size_t p=0; p<3; ++p) EXPECT_EQ(A.count(p,j),B.count(p,j));
+        for (size_t k=0; k<3; ++k) EXPECT_EQ(A.propensity(k,j),B.propensity(k,j));
+    }
+
+    // adding a process drops replicas
+    B.add(test_proc{{2},{0},1.0});
+    EXPECT_EQ(1u,B.table_replicas());
+}
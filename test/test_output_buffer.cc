@@ -0,0 +1,100 @@
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <random>
+#include <sstream>
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include "rdmini/util/output_buffer.h"
+
+using rdmini::output_buffer;
+
+static std::string contents(const output_buffer &B) {
+    return std::string(B.data(),B.size());
+}
+
+TEST(output_buffer,integers) {
+    std::minstd_rand R;
+    std::uniform_int_distribution<int> digits(0,18);
+
+    output_buffer B(4);
+    std::ostringstream expected;
+    for (int i=0; i<2000; ++i) {
+        int64_t x=(int64_t)std::pow(10.0,digits(R))+R();
+        if (i%3==0) x=-x;
+        if (i%7==0) x=i%100;
+
+        B.put_int(x);
+        B.put(',');
+        expected << x << ',';
+    }
+
+    for (uint64_t x: {(uint64_t)0,(uint64_t)9,(uint64_t)10,(uint64_t)99,(uint64_t)100,std::numeric_limits<uint64_t>::max()}) {
+        B.put_uint(x);
+        expected << x;
+    }
+    B.put_int(std::numeric_limits<int64_t>::min());
+    expected << std::numeric_limits<int64_t>::min();
+
+    EXPECT_EQ(expected.str(),contents(B));
+}
+
+// Doubles format as std::ostream does by default.
+
+TEST(output_buffer,doubles) {
+    std::minstd_rand R;
+    std::uniform_real_distribution<double> U(-10,10);
+
+    output_buffer B;
+    std::ostringstream expected;
+    for (int i=0; i<1000; ++i) {
+        double x=std::pow(10.0,U(R));
+        B.put_double(x);
+        B.put(' ');
+        expected << x << ' ';
+    }
+
+    double inf=std::numeric_limits<double>::infinity();
+    for (double x: {0.0,-0.0,1.0,0.1,1e-7,123456.0,1234567.0,inf,-inf}) {
+        B.put_double(x);
+        B.put(' ');
+        expected << x << ' ';
+    }
+
+    EXPECT_EQ(expected.str(),contents(B));
+}
+
+TEST(output_buffer,stream) {
+    output_buffer A,B;
+    A.write("abc",3);
+    A.stream() << 12 << ':' << std::string("xyz");
+    EXPECT_EQ("abc12:xyz",contents(A));
+
+    // stream() stays attached to its buffer across swaps
+    A.swap(B);
+    EXPECT_TRUE(A.empty());
+    A.stream() << "new";
+    EXPECT_EQ("new",contents(A));
+    EXPECT_EQ("abc12:xyz",contents(B));
+}
+
+TEST(output_buffer,write_to) {
+    int fds[2];
+    ASSERT_EQ(0,pipe(fds));
+
+    output_buffer B;
+    B.write("hello\n");
+    B.write_to(fds[1]);
+    EXPECT_TRUE(B.empty());
+    close(fds[1]);
+
+    char buf[16];
+    ssize_t n=read(fds[0],buf,sizeof(buf));
+    close(fds[0]);
+    EXPECT_EQ("hello\n",std::string(buf,n));
+
+    B.write("lost");
+    EXPECT_THROW(B.write_to(-1),std::system_error);
+}
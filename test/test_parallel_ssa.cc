@@ -0,0 +1,359 @@
+#include <cmath>
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "rdmini/rdmodel.h"
+#include "rdmini/parallel_ssa.h"
+
+#include "model_fixtures.h"
+
+using ssa=rdmini::parallel_ssa<3>;
+
+// Record trajectory of total counts at unit time intervals.
+
+template <typename G>
+std::vector<int> trajectory(ssa &S,size_t instance,G &g,int n_samples) {
+    std::vector<int> counts;
+    for (int i=1; i<=n_samples; ++i) {
+        S.advance(instance,(double)i,g);
+        counts.push_back(S.count(instance,0,0));
+        counts.push_back(S.count(instance,1,0));
+    }
+    return counts;
+}
+
+TEST(parallel_ssa,initial_counts) {
+    rdmini::rd_model M=rdmini::rd_model_read(two_species_model,"dimer");
+    ssa S(3,M);
+
+    for (size_t i=0; i<S.instances(); ++i) {
+        EXPECT_EQ(20,S.count(i,0,0));
+        EXPECT_EQ(0,S.count(i,1,0));
+    }
+}
+
+TEST(parallel_ssa,independent_instances) {
+    rdmini::rd_model M=rdmini::rd_model_read(two_species_model,"dimer");
+    ssa S(2,M);
+
+    // advancing one instance must not affect the other
+    std::minstd_rand g(1);
+    S.advance(0,10.0,g);
+    EXPECT_EQ(20,S.count(1,0,0));
+    EXPECT_EQ(0,S.count(1,1,0));
+
+    // each instance's trajectory depends only on its own state
+    std::minstd_rand g0(2),g1(2);
+    S.reset_instance(0,0);
+    auto x0=trajectory(S,0,g0,5);
+    auto x1=trajectory(S,1,g1,5);
+    EXPECT_EQ(x0,x1);
+}
+
+TEST(parallel_ssa,exhaustion) {
+    rdmini::rd_model M=rdmini::rd_model_read(two_species_model,"dimer");
+    ssa S(1,M);
+
+    // A is consumed in pairs and B decays: the system must come to rest
+    // with both populations exactly zero.
+    std::minstd_rand g(3);
+    S.advance(0,1.0e6,g);
+    EXPECT_EQ(0,S.count(0,0,0));
+    EXPECT_EQ(0,S.count(0,1,0));
+}
+
+TEST(parallel_ssa,reset_instance) {
+    rdmini::rd_model M=rdmini::rd_model_read(two_species_model,"dimer");
+    ssa S(1,M);
+
+    std::minstd_rand g(4);
+    auto x=trajectory(S,0,g,5);
+
+    S.reset_instance(0,0);
+    EXPECT_EQ(20,S.count(0,0,0));
+    EXPECT_EQ(0,S.count(0,1,0));
+
+    // a recycled slot reproduces the trajectory of a fresh instance
+    g.seed(4);
+    auto y=trajectory(S,0,g,5);
+    EXPECT_EQ(x,y);
+}
+
+TEST(parallel_ssa,exhaustion_by_steps) {
+    rdmini::rd_model M=rdmini::rd_model_read(two_species_model,"dimer");
+    ssa S(1,M);
+
+    // stepping past exhaustion leaves the state unchanged at infinite time
+    std::minstd_rand g(5);
+    double t=0;
+    for (int i=0; i<100; ++i) t=S.advance(0,g);
+
+    EXPECT_EQ(std::numeric_limits<double>::infinity(),t);
+    EXPECT_EQ(0,S.count(0,0,0));
+    EXPECT_EQ(0,S.count(0,1,0));
+}
+
+std::string observable_model=
+    "---\n"
+    "model: diffusing_dimer\n"
+    "cells:\n"
+    "    grid:\n"
+    "        name: line\n"
+    "        extent: [[ 0, 0, 0 ], [ 3, 1, 1 ]]\n"
+    "        counts: [ 3, 1, 1 ]\n"
+    "    wmvol:\n"
+    "        name: box\n"
+    "        volume: 1\n"
+    "species:\n"
+    "    name: A\n"
+    "    concentration: 20\n"
+    "    diffusivity: 1\n"
+    "species:\n"
+    "    name: B\n"
+    "    concentration: 5\n"
+    "    diffusivity: 0.5\n"
+    "reaction:\n"
+    "    left: [ A, A ]\n"
+    "    right: [ B ]\n"
+    "    rate: [ 0.5, 2 ]\n"
+    "observable:\n"
+    "    name: total_A\n"
+    "    species: A\n"
+    "    cells: [ line, box ]\n"
+    "observable:\n"
+    "    name: bound\n"
+    "    species: [ A, B ]\n"
+    "    weights: [ 1, 2 ]\n"
+    "observable:\n"
+    "    name: box_B\n"
+    "    species: B\n"
+    "    weights: 0.25\n"
+    "    cells: box\n"
+    "...\n";
+
+// Observables track weighted sums of the counts as events are applied.
+
+TEST(parallel_ssa,observables) {
+    rdmini::rd_model M=rdmini::rd_model_read(observable_model,"diffusing_dimer");
+    ASSERT_EQ(3u,M.n_observables());
+    ssa S(2,M);
+    ASSERT_EQ(3u,S.n_observables());
+
+    auto expected=[&](size_t i) {
+        std::vector<double> x(3,0);
+        for (size_t c=0; c<M.n_cells(); ++c) {
+            x[0]+=S.count(i,0,c);
+            x[1]+=S.count(i,0,c)+2*S.count(i,1,c);
+        }
+        x[2]=0.25*S.count(i,1,3);
+        return x;
+    };
+
+    std::minstd_rand g(6);
+    for (int k=0; k<=10; ++k) {
+        for (size_t i=0; i<S.instances(); ++i) {
+            if (k>0) S.advance(i,0.1*k,g);
+
+            auto x=expected(i);
+            auto obs=S.observables(i);
+            ASSERT_EQ(3u,obs.size());
+            for (size_t o=0; o<3; ++o) {
+                EXPECT_EQ(x[o],obs[o]) << "instance " << i << ", observable " << o;
+                EXPECT_EQ(x[o],S.observable(i,o));
+            }
+        }
+    }
+
+    S.set_count(1,1,3,100);
+    EXPECT_EQ(expected(1),std::vector<double>(S.observables(1).begin(),S.observables(1).end()));
+
+    S.reset_instance(1,0);
+    EXPECT_EQ(20.0*4,S.observable(1,0));
+    EXPECT_EQ(1.25,S.observable(1,2));
+}
+
+std::string stimulus_model=
+    "---\n"
+    "model: stimulated\n"
+    "cells:\n"
+    "    wmvol:\n"
+    "        name: left\n"
+    "        volume: 1\n"
+    "    wmvol:\n"
+    "        name: right\n"
+    "        volume: 1\n"
+    "species:\n"
+    "    name: A\n"
+    "    concentration: 5\n"
+    "species:\n"
+    "    name: B\n"
+    "    concentration: 0\n"
+    "reaction:\n"
+    "    name: convert\n"
+    "    left: [ A ]\n"
+    "    right: [ B ]\n"
+    "    rate: 0\n"
+    "stimulus:\n"
+    "    time: 2\n"
+    "    reaction: convert\n"
+    "    rate: 1e9\n"
+    "stimulus:\n"
+    "    time: 1\n"
+    "    inject: 10\n"
+    "    species: A\n"
+    "    cells: left\n"
+    "stimulus:\n"
+    "    time: 3\n"
+    "    remove: 12\n"
+    "    species: B\n"
+    "...\n";
+
+// Stimuli are applied at their scheduled times within advance().
+
+TEST(parallel_ssa,stimuli) {
+    rdmini::rd_model M=rdmini::rd_model_read(stimulus_model,"stimulated");
+    ssa S(2,M);
+    ASSERT_EQ(3u,S.n_stimuli());
+
+    std::minstd_rand g;
+    S.advance(0,0.5,g);
+    EXPECT_EQ(5,S.count(0,0,0));
+
+    // injection in the left cell only; no conversion at rate zero
+    S.advance(0,1,g);
+    EXPECT_EQ(15,S.count(0,0,0));
+    EXPECT_EQ(5,S.count(0,0,1));
+    EXPECT_EQ(0,S.count(0,1,0));
+    EXPECT_EQ(0u,S.event_count(0));
+
+    // rate change takes effect from t=2 without a break in advance()
+    S.advance(0,2.5,g);
+    EXPECT_EQ(0,S.count(0,0,0));
+    EXPECT_EQ(15,S.count(0,1,0));
+    EXPECT_EQ(5,S.count(0,1,1));
+
+    // removal stops at zero
+    S.advance(0,4,g);
+    EXPECT_EQ(3,S.count(0,1,0));
+    EXPECT_EQ(0,S.count(0,1,1));
+
+    // other instances, and reset instances, follow their own schedule
+    EXPECT_EQ(5,S.count(1,0,0));
+    S.advance(1,10,g);
+    EXPECT_EQ(3,S.count(1,1,0));
+
+    S.reset_instance(0,0);
+    S.advance(0,1.5,g);
+    EXPECT_EQ(15,S.count(0,0,0));
+    EXPECT_EQ(0,S.count(0,1,0));
+}
+
+TEST(parallel_ssa,stimuli_by_steps) {
+    rdmini::rd_model M=rdmini::rd_model_read(stimulus_model,"stimulated");
+    ssa S(1,M);
+
+    // stimuli preceding the next event are applied by step
+    std::minstd_rand g;
+    double t=S.advance(0,g);
+    EXPECT_LE(2.0,t);
+    EXPECT_EQ(1u,S.event_count(0));
+    EXPECT_EQ(19,S.count(0,0,0)+S.count(0,0,1));
+
+    while (S.count(0,0,0)+S.count(0,0,1)>0) S.advance(0,g);
+    EXPECT_EQ(20u,S.event_count(0));
+
+    // with no further events, any remaining stimuli are applied
+    t=S.advance(0,g);
+    EXPECT_EQ(std::numeric_limits<double>::infinity(),t);
+    EXPECT_EQ(3,S.count(0,1,0));
+}
+
+// Observers see every event and population change of the event loop,
+// and may stop it.
+
+struct tally_observer: rdmini::null_observer {
+    std::vector<uint64_t> events;
+    std::vector<double> t_last;
+    std::vector<std::vector<long>> net_change;
+
+    tally_observer(size_t n_instances,size_t n_pop):
+        events(n_instances), t_last(n_instances), net_change(n_instances,std::vector<long>(n_pop)) {}
+
+    // intervals run from the last event, or from a later stimulus
+    template <typename K>
+    void on_event(size_t instance,K,double t,double dt) {
+        ++events[instance];
+        EXPECT_LT(0,dt);
+        auto near=[](double a,double b) { return std::abs(a-b)<1e-12; };
+        double t0=t-dt;
+        EXPECT_TRUE(near(t0,t_last[instance]) || near(t0,1) || near(t0,2) || near(t0,3));
+        t_last[instance]=t;
+    }
+
+    void on_population_change(size_t instance,size_t p,long delta) {
+        net_change[instance][p]+=delta;
+    }
+};
+
+TEST(parallel_ssa,observer) {
+    rdmini::rd_model M=rdmini::rd_model_read(stimulus_model,"stimulated");
+    rdmini::parallel_ssa<3,tally_observer> S(2,M,0,false,tally_observer(2,4));
+
+    std::vector<int> initial;
+    for (size_t c=0; c<2; ++c)
+        for (size_t s=0; s<2; ++s) initial.push_back(S.count(0,s,c));
+
+    std::minstd_rand g;
+    // intervals span the ends of advance() calls
+    for (double t_end: {0.5,1.5,2.0000000001,2.5,10.0}) S.advance(0,t_end,g);
+    for (int i=0; i<5; ++i) S.advance(1,g);
+
+    const tally_observer &O=S.observer();
+    EXPECT_EQ(S.event_count(0),O.events[0]);
+    EXPECT_EQ(5u,O.events[1]);
+
+    // population changes include those of stimuli
+    for (size_t c=0; c<2; ++c) {
+        for (size_t s=0; s<2; ++s) {
+            size_t p=S.species_to_pop_id(s,c);
+            EXPECT_EQ(S.count(0,s,c),initial[p]+O.net_change[0][p]);
+            EXPECT_EQ(S.count(1,s,c),initial[p]+O.net_change[1][p]);
+        }
+    }
+}
+
+struct threshold_observer: rdmini::null_observer {
+    size_t pop;
+    long count,threshold;
+
+    threshold_observer(size_t pop_,long count_,long threshold_): pop(pop_), count(count_), threshold(threshold_) {}
+
+    void on_population_change(size_t,size_t p,long delta) {
+        if (p==pop) count+=delta;
+    }
+
+    bool stop(size_t) const { return count>=threshold; }
+};
+
+TEST(parallel_ssa,observer_stop) {
+    rdmini::rd_model M=rdmini::rd_model_read(two_species_model,"dimer");
+    rdmini::parallel_ssa<3,threshold_observer> S(1,M,0,false,threshold_observer(1,0,5));
+
+    // B is produced one at a time: stop at the event that makes five
+    std::minstd_rand g(6);
+    double t=S.advance(0,1.0e6,g);
+    EXPECT_GT(1.0e6,t);
+    EXPECT_EQ(t,S.time(0));
+    EXPECT_EQ(5,S.count(0,1,0));
+
+    // once the rule no longer applies, the instance runs on to t_end
+    S.observer().threshold=1000;
+    t=S.advance(0,1.0e6,g);
+    EXPECT_EQ(1.0e6,t);
+    EXPECT_EQ(0,S.count(0,0,0));
+    EXPECT_EQ(0,S.count(0,1,0));
+}
@@ -0,0 +1,114 @@
+#include <cstdint>
+#include <random>
+#include <sstream>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "rdmini/philox.h"
+#include "rdmini/ssa_direct.h"
+
+// Known answer tests from the Random123 distribution (kat_vectors).
+
+TEST(philox,known_answers) {
+    struct kat {
+        uint32_t ctr[4];
+        uint32_t key[2];
+        uint32_t expected[4];
+    } tests[]={
+        {{0,0,0,0}, {0,0}, {0x6627e8d5,0xe169c58d,0xbc57ac4c,0x9b00dbd8}},
+        {{0xffffffff,0xffffffff,0xffffffff,0xffffffff}, {0xffffffff,0xffffffff}, {0x408f276d,0x41c83b0e,0xa20bc7c6,0x6d5451fd}},
+        {{0x243f6a88,0x85a308d3,0x13198a2e,0x03707344}, {0xa4093822,0x299f31d0}, {0xd16cfe09,0x94fdcceb,0x5001e420,0x24126ea1}}
+    };
+
+    for (const auto &t: tests) {
+        uint32_t x[4]={t.ctr[0],t.ctr[1],t.ctr[2],t.ctr[3]};
+        rdmini::philox4x32_10(x,t.key[0],t.key[1]);
+        for (int i=0; i<4; ++i) EXPECT_EQ(t.expected[i],x[i]);
+
+        uint32_t y[4];
+        uint64_t block=t.ctr[0]|((uint64_t)t.ctr[1]<<32);
+        rdmini::philox4x32_10_blocks(t.key[0],t.key[1],block,t.ctr[2],t.ctr[3],1,y);
+        for (int i=0; i<4; ++i) EXPECT_EQ(t.expected[i],y[i]);
+    }
+}
+
+TEST(philox,discard) {
+    rdmini::philox_engine a(17,3,1),b(17,3,1);
+
+    for (int n: {0,1,3,4,5,11,1000}) {
+        for (int i=0; i<n; ++i) a();
+        b.discard(n);
+        EXPECT_EQ(a.position(),b.position());
+        EXPECT_EQ(a(),b());
+        EXPECT_EQ(a,b);
+    }
+}
+
+TEST(philox,generate) {
+    // bulk generation must match the scalar stream, for any alignment
+    for (size_t offset: {0,1,2,3}) {
+        for (size_t n: {0,1,7,64,101}) {
+            rdmini::philox_engine a(5,7),b(5,7);
+            a.discard(offset);
+            b.discard(offset);
+
+            std::vector<uint32_t> bulk(n);
+            a.generate(bulk.data(),n);
+            for (size_t i=0; i<n; ++i) ASSERT_EQ(b(),bulk[i]);
+
+            EXPECT_EQ(a,b);
+            EXPECT_EQ(a(),b());
+        }
+    }
+}
+
+TEST(philox,streams) {
+    // different instances and streams give different sequences
+    rdmini::philox_engine a(1,0,0),b(1,1,0),c(1,0,1),d(2,0,0);
+    std::vector<uint32_t> x[4];
+    for (int i=0; i<8; ++i) {
+        x[0].push_back(a());
+        x[1].push_back(b());
+        x[2].push_back(c());
+        x[3].push_back(d());
+    }
+    for (int i=0; i<4; ++i)
+        for (int j=0; j<i; ++j) EXPECT_NE(x[i],x[j]);
+}
+
+TEST(philox,checkpoint) {
+    rdmini::philox_engine a(123456789012345ull,42,2);
+    a.discard(12345);
+
+    std::stringstream s;
+    s << a;
+
+    rdmini::philox_engine b;
+    s >> b;
+    EXPECT_EQ(a,b);
+    EXPECT_EQ(a(),b());
+}
+
+TEST(philox,urng) {
+    rdmini::philox_engine g(9);
+
+    std::uniform_real_distribution<double> U(0,1);
+    double sum=0;
+    const int n=100000;
+    for (int i=0; i<n; ++i) {
+        double u=U(g);
+        ASSERT_TRUE(u>=0 && u<1);
+        sum+=u;
+    }
+    EXPECT_NEAR(0.5,sum/n,0.01);
+
+    // usable as the generator for SSA event selection
+    rdmini::ssa_direct<size_t,double> ssa(2);
+    ssa.update(0,1.0);
+    ssa.update(1,3.0);
+
+    int count1=0;
+    for (int i=0; i<n; ++i) count1+=ssa.next(g).key()==1;
+    EXPECT_NEAR(0.75,(double)count1/n,0.01);
+}
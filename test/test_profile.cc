@@ -0,0 +1,194 @@
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "rdmini/parallel_ssa.h"
+#include "rdmini/rdmodel.h"
+#include "rdmini/timer.h"
+
+#include "model_fixtures.h"
+
+namespace timer=rdmini::timer;
+
+const timer::profile_node *find_child(const timer::profile_node &n,const std::string &name) {
+    for (const auto &c: n.children)
+        if (c.name==name) return &c;
+    return nullptr;
+}
+
+struct profile_test: ::testing::Test {
+    void SetUp() override {
+        timer::profile_reset();
+        timer::profile_enable();
+    }
+    void TearDown() override {
+        timer::profile_enable(false);
+        timer::profile_reset();
+    }
+};
+
+TEST(profile,tsc) {
+    uint64_t t0=timer::tsc();
+    uint64_t t1=timer::tsc();
+    EXPECT_LE(t0,t1);
+    EXPECT_LT(0,timer::tsc_rate());
+}
+
+TEST_F(profile_test,nesting) {
+    auto outer=timer::profile_region("outer");
+    auto inner=timer::profile_region("inner");
+    EXPECT_EQ(outer,timer::profile_region("outer"));
+
+    for (int i=0; i<3; ++i) {
+        timer::profile_scope _(outer);
+        for (int j=0; j<2; ++j) timer::profile_scope _(inner);
+        timer::profile_add(timer::profile_region("counted"),1000,5);
+    }
+    {
+        // the same region in a different context is a distinct node
+        timer::profile_scope _(inner);
+    }
+
+    timer::profile_node root=timer::profile_report();
+    ASSERT_EQ(2u,root.children.size());
+
+    const auto *o=find_child(root,"outer");
+    ASSERT_TRUE(o);
+    EXPECT_EQ(3u,o->calls);
+    EXPECT_EQ(1u,o->threads);
+
+    const auto *i=find_child(*o,"inner");
+    ASSERT_TRUE(i);
+    EXPECT_EQ(6u,i->calls);
+    EXPECT_LE(i->seconds,o->seconds);
+
+    const auto *c=find_child(*o,"counted");
+    ASSERT_TRUE(c);
+    EXPECT_EQ(15u,c->calls);
+
+    const auto *top_inner=find_child(root,"inner");
+    ASSERT_TRUE(top_inner);
+    EXPECT_EQ(1u,top_inner->calls);
+}
+
+TEST_F(profile_test,disabled) {
+    timer::profile_enable(false);
+    {
+        timer::profile_scope _(timer::profile_region("outer"));
+    }
+    EXPECT_TRUE(timer::profile_report().children.empty());
+}
+
+TEST_F(profile_test,threads_merged) {
+    auto work=timer::profile_region("work");
+
+    std::vector<std::thread> threads;
+    for (int t=0; t<4; ++t)
+        threads.emplace_back([=]() { for (int i=0; i<10; ++i) timer::profile_scope _(work); });
+    for (auto &t: threads) t.join();
+
+    timer::profile_node root=timer::profile_report();
+    const auto *w=find_child(root,"work");
+    ASSERT_TRUE(w);
+    EXPECT_EQ(40u,w->calls);
+    EXPECT_EQ(4u,w->threads);
+}
+
+TEST_F(profile_test,reports) {
+    {
+        timer::profile_scope _(timer::profile_region("quoted \"name\""));
+    }
+
+    std::ostringstream text,json;
+    timer::print_profile(text);
+    timer::write_profile_json(json);
+
+    EXPECT_NE(std::string::npos,text.str().find("quoted \"name\""));
+    EXPECT_NE(std::string::npos,json.str().find("{\"name\":\"quoted \\\"name\\\"\",\"calls\":1,"));
+    EXPECT_EQ(0u,json.str().find("{\"tsc_rate\":"));
+}
+
+TEST_F(profile_test,parallel_ssa) {
+    rdmini::rd_model M=rdmini::rd_model_read(decay_model,"decay");
+    rdmini::parallel_ssa<3> S(1,M);
+
+    std::minstd_rand g;
+    S.advance(0,1.0,g);
+    S.advance(0,2.0,g);
+
+    timer::profile_node root=timer::profile_report();
+    EXPECT_TRUE(find_child(root,"initialise"));
+
+    const auto *a=find_child(root,"advance");
+    ASSERT_TRUE(a);
+    EXPECT_EQ(2u,a->calls);
+
+    const auto *apply=find_child(*a,"apply");
+    const auto *select=find_child(*a,"select");
+    ASSERT_TRUE(apply && select);
+    EXPECT_EQ(S.event_count(0),apply->calls);
+    EXPECT_LE(apply->calls,select->calls);
+
+    // single events are timed only as a sequence
+    S.advance_events(0,5,g);
+    S.advance(0,g);
+    root=timer::profile_report();
+
+    const auto *steps=find_child(root,"steps");
+    ASSERT_TRUE(steps);
+    EXPECT_EQ(1u,steps->calls);
+    EXPECT_FALSE(find_child(root,"step"));
+}
+
+// Counters may be unavailable (e.g. in a virtual machine); either way,
+// reads must be consistent with the reported availability.
+
+TEST(perf_counters,group) {
+    timer::perf_counter_group G;
+
+    timer::perf_counts c0,c1;
+    G.read(c0);
+    volatile double x=0;
+    for (int i=0; i<100000; ++i) x+=i;
+    G.read(c1);
+
+    for (int e=0; e<timer::n_perf_events; ++e) {
+        auto id=(timer::perf_event_id)e;
+        EXPECT_EQ(G.available(id),c1.has(id));
+        if (c1.has(id)) {
+            EXPECT_LE(c0.value[e],c1.value[e]);
+        }
+    }
+    EXPECT_EQ(G.available(),c1.valid!=0);
+
+    {
+        auto _=timer::guard(G);
+        x+=1;
+    }
+    timer::perf_counts a=G.counts();
+    EXPECT_EQ(c1.valid,a.valid);
+    if (a.has(timer::perf_instructions)) {
+        EXPECT_LT(0u,a.value[timer::perf_instructions]);
+    }
+}
+
+TEST_F(profile_test,counters) {
+    timer::profile_enable(true,true);
+    EXPECT_TRUE(timer::profile_counting());
+    {
+        timer::profile_scope _(timer::profile_region("counted region"));
+    }
+
+    timer::profile_node root=timer::profile_report();
+    const auto *r=find_child(root,"counted region");
+    ASSERT_TRUE(r);
+    EXPECT_EQ(1u,r->calls);
+    EXPECT_EQ(timer::this_thread_counters().available(),r->counts.valid!=0);
+
+    timer::profile_enable(true,false);
+    EXPECT_FALSE(timer::profile_counting());
+}
@@ -0,0 +1,159 @@
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "rdmini/qmc.h"
+#include "rdmini/ssa_direct.h"
+
+using rdmini::sobol_generator;
+
+TEST(qmc,reverse_bits) {
+    EXPECT_EQ(0ull,rdmini::reverse_bits(0));
+    EXPECT_EQ(1ull<<63,rdmini::reverse_bits(1));
+    EXPECT_EQ(3ull<<62,rdmini::reverse_bits(3));
+    EXPECT_EQ(0x8000000000000001ull,rdmini::reverse_bits(0x8000000000000001ull));
+
+    uint64_t x=0x0123456789abcdefull;
+    EXPECT_EQ(x,rdmini::reverse_bits(rdmini::reverse_bits(x)));
+}
+
+TEST(qmc,vdc_base2) {
+    double expected[]={0,0.5,0.25,0.75,0.125,0.625,0.375,0.875};
+    for (unsigned i=0; i<8; ++i) EXPECT_EQ(expected[i],rdmini::radical_inverse_base2(i));
+
+    // one generator call per uniform_real_distribution sample
+    rdmini::vdc_base2_generator G;
+    std::uniform_real_distribution<double> U;
+    for (unsigned i=0; i<8; ++i) EXPECT_EQ(expected[i],U(G));
+    EXPECT_EQ(8u,G.index());
+}
+
+TEST(qmc,sobol_first_points) {
+    sobol_generator G(2);
+
+    // points 0..3 in Gray code order are Sobol points 0, 1, 3, 2.
+    double expected[][2]={{0,0},{0.5,0.5},{0.75,0.25},{0.25,0.75}};
+    for (auto &p: expected) {
+        double x[2];
+        G.next_point(x);
+        EXPECT_EQ(p[0],x[0]);
+        EXPECT_EQ(p[1],x[1]);
+    }
+    EXPECT_EQ(4u,G.index());
+}
+
+TEST(qmc,sobol_seek) {
+    for (unsigned dims: {1u,3u,sobol_generator::max_dimension}) {
+        sobol_generator G(dims,sobol_generator::owen,7);
+        sobol_generator H(dims,sobol_generator::owen,7);
+
+        std::vector<uint64_t> seq;
+        for (unsigned i=0; i<1000*dims; ++i) seq.push_back(G());
+
+        for (unsigned k: {0u,1u,17u,256u,999u}) {
+            H.seek(k);
+            for (unsigned j=0; j<dims; ++j) EXPECT_EQ(seq[k*dims+j],H());
+        }
+
+        H.seek(0);
+        H.discard(123);
+        EXPECT_EQ(seq[123],H());
+    }
+}
+
+TEST(qmc,sobol_bad_dimension) {
+    EXPECT_THROW(sobol_generator(0),rdmini::invalid_value);
+    EXPECT_THROW(sobol_generator(sobol_generator::max_dimension+1),rdmini::invalid_value);
+}
+
+// Each one-dimensional projection of the first 2^m points has exactly one
+// point in each interval [k/2^m,(k+1)/2^m); this is preserved by scrambling.
+
+TEST(qmc,sobol_stratification) {
+    constexpr unsigned m=10;
+    constexpr unsigned n=1u<<m;
+    constexpr unsigned dims=sobol_generator::max_dimension;
+
+    for (auto scramble: {sobol_generator::no_scramble,sobol_generator::digital_shift,sobol_generator::owen}) {
+        sobol_generator G(dims,scramble,12345);
+        std::vector<std::vector<unsigned>> bins(dims,std::vector<unsigned>(n));
+
+        for (unsigned i=0; i<n; ++i)
+            for (unsigned j=0; j<dims; ++j) ++bins[j][G()>>(64-m)];
+
+        for (unsigned j=0; j<dims; ++j)
+            for (unsigned k=0; k<n; ++k) ASSERT_EQ(1u,bins[j][k]) << "dimension " << j << " scramble " << scramble;
+    }
+}
+
+// The first two dimensions form a (0,m,2)-net: every elementary interval
+// of volume 2^-m contains exactly one of the first 2^m points.
+
+TEST(qmc,sobol_net) {
+    constexpr unsigned m=8;
+    constexpr unsigned n=1u<<m;
+
+    for (auto scramble: {sobol_generator::no_scramble,sobol_generator::digital_shift,sobol_generator::owen}) {
+        sobol_generator G(2,scramble,99);
+        std::vector<uint64_t> x(n),y(n);
+        for (unsigned i=0; i<n; ++i) { x[i]=G(); y[i]=G(); }
+
+        for (unsigned k=0; k<=m; ++k) {
+            std::vector<unsigned> cells(n);
+            for (unsigned i=0; i<n; ++i) {
+                uint64_t cx=k?x[i]>>(64-k):0;
+                uint64_t cy=k<m?y[i]>>(64-(m-k)):0;
+                ++cells[(cx<<(m-k))|cy];
+            }
+            for (unsigned c=0; c<n; ++c) ASSERT_EQ(1u,cells[c]) << "k=" << k << " scramble " << scramble;
+        }
+    }
+}
+
+TEST(qmc,sobol_scramble_seeds) {
+    sobol_generator A(2,sobol_generator::owen,1);
+    sobol_generator B(2,sobol_generator::owen,2);
+    sobol_generator C(2,sobol_generator::owen,1);
+
+    unsigned differ=0;
+    for (unsigned i=0; i<64; ++i) {
+        uint64_t a=A(),b=B(),c=C();
+        EXPECT_EQ(a,c);
+        differ+=a!=b;
+    }
+    EXPECT_GT(differ,60u);
+}
+
+// A two-dimensional Sobol generator supplies the uniform variate for
+// process selection and the variate for the exponential waiting time of
+// each event through ssa_direct::next(g).
+
+TEST(qmc,ssa_direct_next) {
+    constexpr size_t n_proc=8;
+    rdmini::ssa_direct<size_t,double> ssa(n_proc);
+    double total=0;
+    for (size_t i=0; i<n_proc; ++i) {
+        ssa.update(i,i+1.0);
+        total+=i+1.0;
+    }
+
+    constexpr unsigned n=1u<<14;
+    sobol_generator G(2,sobol_generator::owen,5);
+    std::vector<unsigned> freq(n_proc);
+    double dt_sum=0;
+    for (unsigned i=0; i<n; ++i) {
+        auto ev=ssa.next(G);
+        ++freq[ev.key()];
+        dt_sum+=ev.dt();
+        ASSERT_EQ(0u,G.coordinate());
+    }
+
+    // selection integrates a step function: error O(n_proc/n)
+    for (size_t i=0; i<n_proc; ++i)
+        EXPECT_NEAR((i+1)/total,(double)freq[i]/n,(double)n_proc/n);
+
+    EXPECT_NEAR(1/total,dt_sum/n,0.01/total);
+}
@@ -0,0 +1,73 @@
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "rdmini/running_stats.h"
+
+// Statistics of a sample merged from parts match those of the whole.
+
+TEST(running_stats,merge) {
+    std::minstd_rand R;
+    std::normal_distribution<double> N(50,10);
+
+    std::vector<double> x(1000);
+    for (auto &v: x) v=N(R);
+
+    rdmini::running_stats whole;
+    for (auto v: x) whole.insert(v);
+
+    for (size_t split: {0,1,137,500,999,1000}) {
+        rdmini::running_stats a,b;
+        for (size_t i=0; i<split; ++i) a.insert(x[i]);
+        for (size_t i=split; i<x.size(); ++i) b.insert(x[i]);
+
+        a.merge(b);
+        EXPECT_EQ(whole.count(),a.count());
+        EXPECT_NEAR(whole.mean(),a.mean(),1e-12*std::abs(whole.mean()));
+        EXPECT_NEAR(whole.variance(),a.variance(),1e-10*whole.variance());
+        EXPECT_EQ(whole.min(),a.min());
+        EXPECT_EQ(whole.max(),a.max());
+    }
+}
+
+TEST(running_cov,merge) {
+    std::minstd_rand R;
+    std::normal_distribution<double> N;
+
+    rdmini::running_cov whole,a,b;
+    for (int i=0; i<1000; ++i) {
+        double x=N(R),y=0.5*x+N(R);
+        whole.insert(x,y);
+        (i%3?a:b).insert(x,y);
+    }
+
+    a.merge(b);
+    EXPECT_EQ(whole.n,a.n);
+    EXPECT_NEAR(whole.covariance(),a.covariance(),1e-12);
+    EXPECT_NEAR(0.5,whole.covariance(),0.1);
+}
+
+TEST(fixed_histogram,bins) {
+    rdmini::fixed_histogram H(0,10,5);
+    ASSERT_EQ(5u,H.n_bins());
+    EXPECT_EQ(4.0,H.lower(2));
+    EXPECT_EQ(10.0,H.upper(4));
+
+    for (double x: {-1.0,0.0,1.9,2.0,9.99,10.0,25.0}) H.insert(x);
+    EXPECT_EQ(1u,H.underflow());
+    EXPECT_EQ(2u,H.bin(0));
+    EXPECT_EQ(1u,H.bin(1));
+    EXPECT_EQ(1u,H.bin(4));
+    EXPECT_EQ(2u,H.overflow());
+    EXPECT_EQ(7u,H.count());
+
+    rdmini::fixed_histogram G(0,10,5);
+    G.insert(3);
+    H.merge(G);
+    EXPECT_EQ(2u,H.bin(1));
+
+    EXPECT_THROW(H.merge(rdmini::fixed_histogram(0,10,4)),rdmini::invalid_value);
+    EXPECT_THROW(rdmini::fixed_histogram(1,1,4),rdmini::invalid_value);
+}
@@ -0,0 +1,61 @@
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "rdmini/util/spsc_queue.h"
+
+TEST(spsc_queue,capacity) {
+    rdmini::spsc_queue<int> Q(5);
+    EXPECT_EQ(8u,Q.capacity());
+
+    for (int i=0; i<8; ++i) ASSERT_TRUE(Q.try_push(i));
+    EXPECT_FALSE(Q.try_push(8));
+
+    int x;
+    ASSERT_TRUE(Q.try_pop(x));
+    EXPECT_EQ(0,x);
+    EXPECT_TRUE(Q.try_push(8));
+}
+
+TEST(spsc_queue,fifo) {
+    rdmini::spsc_queue<int> Q(4);
+    EXPECT_TRUE(Q.empty());
+    EXPECT_EQ(nullptr,Q.front());
+
+    // wrap around the ring several times
+    int next_in=0,next_out=0;
+    for (int round=0; round<10; ++round) {
+        for (int i=0; i<3; ++i) ASSERT_TRUE(Q.try_push(next_in++));
+
+        ASSERT_NE(nullptr,Q.front());
+        EXPECT_EQ(next_out,*Q.front());
+
+        int x;
+        while (Q.try_pop(x)) EXPECT_EQ(next_out++,x);
+    }
+    EXPECT_EQ(next_in,next_out);
+    EXPECT_TRUE(Q.empty());
+}
+
+TEST(spsc_queue,concurrent) {
+    constexpr unsigned n=100000;
+    rdmini::spsc_queue<unsigned> Q(64);
+
+    std::thread producer([&]() {
+        for (unsigned i=0; i<n; ++i)
+            while (!Q.try_push(i)) std::this_thread::yield();
+    });
+
+    std::vector<unsigned> got;
+    got.reserve(n);
+    while (got.size()<n) {
+        unsigned x;
+        if (Q.try_pop(x)) got.push_back(x);
+        else std::this_thread::yield();
+    }
+    producer.join();
+
+    for (unsigned i=0; i<n; ++i) ASSERT_EQ(i,got[i]);
+    EXPECT_TRUE(Q.empty());
+}
@@ -10,6 +10,7 @@
 #include <stdexcept>
 
 #include "rdmini/vandercorput.h"
+#include "rdmini/qmc.h"
 #include "rdmini/ssa_direct.h"
 
 #include "gtest/gtest.h"
@@ -25,21 +26,30 @@ namespace KHineq {
     // (0,1)-sequences", Electronic journal of combinatorial number theory 2005:
     //      Dstar(x1,...,xN) <= f_b * logN/N + c_b * 1/N
     // This value is then used in Koksma-Hlawka inequality.
-    constexpr size_t base = 10;
-    constexpr double a_b  = (base%2)?((base-1.)/4.):((base*base)/(4.*(base+1.)));
-    constexpr double f_b  = a_b/std::log(base);
-    constexpr double c_b  = (2.0>1.0+1.0/base+a_b)?(2.0):(1.0+1.0/base+a_b);
-    
-    template <typename Fun>
-    void kh_test(const rdmini::ssa_direct<size_t,double>& ssa, const Fun& f, double V_f, double exact_mu, std::size_t n_events) {
+    template <size_t base>
+    struct kritzer_bound {
+        static constexpr double a_b  = (base%2)?((base-1.)/4.):((base*base)/(4.*(base+1.)));
+        static constexpr double f_b  = a_b/std::log(base);
+        static constexpr double c_b  = (2.0>1.0+1.0/base+a_b)?(2.0):(1.0+1.0/base+a_b);
+    };
+
+    // Sample U(0,1) values from the base-10 sequence by default.
+    struct vdc_base10_sampler {
         rdmini::counting_generator Rlin;
-        rdmini::vdc_uniform_real_distribution<double> U_vdc(0.,1.);
+        rdmini::vdc_uniform_real_distribution<double> U_vdc{0.,1.};
+
+        double operator()() { return U_vdc(Rlin); }
+    };
+
+    template <size_t base=10, typename Fun, typename Sampler=vdc_base10_sampler>
+    void kh_test(const rdmini::ssa_direct<size_t,double>& ssa, const Fun& f, double V_f, double exact_mu, std::size_t n_events, Sampler sample=Sampler()) {
+        typedef kritzer_bound<base> bound;
         double approx_mu =0.;
         double err_bound_theory = 0.;
         std::ostringstream os;
         for (std::size_t N=1; N<=n_events; ++N) {
-            approx_mu       = ( approx_mu*(N-1) + f(ssa.inverse_cdf(U_vdc(Rlin))) )/N;
-            err_bound_theory  =  V_f*(f_b*std::log(N)/N+c_b/N);
+            approx_mu       = ( approx_mu*(N-1) + f(ssa.inverse_cdf(sample())) )/N;
+            err_bound_theory  =  V_f*(bound::f_b*std::log(N)/N+bound::c_b/N);
             if (std::abs(approx_mu-exact_mu) > err_bound_theory) {
                 os << "After " << N << " iterations:"
                     << " expected max error " << err_bound_theory
@@ -99,3 +109,31 @@ TEST(SsaDistribution, MomentTest) {
 
 }
 
+TEST(SsaDistribution, MomentTestBase2) {
+    std::minstd_rand R;
+
+    constexpr size_t n_proc = 20;
+    std::vector<double> prop(n_proc);
+    for (size_t i=0; i<n_proc; ++i) prop[i] = i+1;
+    std::shuffle(prop.begin(),prop.end(),R);
+    double total = std::accumulate(prop.begin(),prop.end(),0.0);
+
+    double exact_mu1 = 0.;
+    for (size_t j=0; j<n_proc; ++j) exact_mu1 += double(j) * prop[j] / total;
+
+    rdmini::ssa_direct<size_t,double> ssa(prop.size());
+    for (size_t i=0; i<prop.size(); ++i) ssa.update(i,prop[i]);
+
+    // Base-2 radical inverse through the standard distribution: one
+    // generator call per sample, so the bound for (0,1)-sequences in base 2
+    // applies as for the base-10 sequence above.
+    rdmini::vdc_base2_generator G;
+    std::uniform_real_distribution<double> U(0.,1.);
+
+    try {
+        KHineq::kh_test<2>(ssa, [](size_t j){return j;}, n_proc, exact_mu1, 1000*1000, [&]() { return U(G); });
+    }
+    catch (const std::runtime_error& err) {
+        FAIL() << err.what();
+    }
+}
@@ -0,0 +1,89 @@
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "rdmini/tdigest.h"
+
+static double exact_quantile(std::vector<double> x,double q) {
+    std::sort(x.begin(),x.end());
+    return x[std::min(x.size()-1,(size_t)(q*x.size()))];
+}
+
+TEST(tdigest,empty) {
+    rdmini::tdigest D;
+    EXPECT_TRUE(D.empty());
+    EXPECT_TRUE(std::isnan(D.quantile(0.5)));
+
+    D.insert(3);
+    EXPECT_EQ(3,D.quantile(0));
+    EXPECT_EQ(3,D.quantile(0.5));
+    EXPECT_EQ(3,D.quantile(1));
+}
+
+TEST(tdigest,quantiles) {
+    std::minstd_rand R;
+    std::exponential_distribution<double> E(0.1);
+
+    std::vector<double> x(100000);
+    for (auto &v: x) v=E(R);
+
+    rdmini::tdigest D;
+    for (auto v: x) D.insert(v);
+
+    EXPECT_EQ(x.size(),D.count());
+    EXPECT_LE(D.centroids().size(),100u);
+    EXPECT_EQ(*std::min_element(x.begin(),x.end()),D.quantile(0));
+    EXPECT_EQ(*std::max_element(x.begin(),x.end()),D.quantile(1));
+
+    // rank error is smallest in the tails
+    for (double q: {0.001,0.01,0.1,0.25,0.5,0.75,0.9,0.99,0.999}) {
+        double estimate=D.quantile(q);
+        double rank=std::count_if(x.begin(),x.end(),[=](double v) { return v<estimate; })/(double)x.size();
+        EXPECT_NEAR(q,rank,0.002+0.02*q*(1-q)) << "q=" << q;
+    }
+}
+
+// Digests of parts of a sample merge into a digest of the whole.
+
+TEST(tdigest,merge) {
+    std::minstd_rand R;
+    std::normal_distribution<double> N(100,15);
+
+    std::vector<double> x;
+    std::vector<rdmini::tdigest> parts(8);
+    for (int i=0; i<40000; ++i) {
+        double v=N(R);
+        x.push_back(v);
+        parts[i%parts.size()].insert(v);
+    }
+
+    rdmini::tdigest D;
+    for (const auto &p: parts) D.merge(p);
+
+    EXPECT_EQ(x.size(),D.count());
+    EXPECT_LE(D.centroids().size(),100u);
+    for (double q: {0.01,0.1,0.5,0.9,0.99})
+        EXPECT_NEAR(exact_quantile(x,q),D.quantile(q),0.5) << "q=" << q;
+}
+
+// A digest rebuilt from stored centroids and extrema is the digest merged.
+
+TEST(tdigest,merge_centroids) {
+    std::minstd_rand R;
+    std::lognormal_distribution<double> L(0,1);
+
+    rdmini::tdigest A,B;
+    for (int i=0; i<20000; ++i) A.insert(L(R));
+    EXPECT_LE(A.centroids().size(),A.max_centroids());
+
+    std::vector<rdmini::tdigest::centroid> stored=A.centroids();
+    B.merge(stored.begin(),stored.end(),A.min(),A.max());
+
+    EXPECT_EQ(A.count(),B.count());
+    EXPECT_EQ(A.min(),B.min());
+    EXPECT_EQ(A.max(),B.max());
+    for (double q: {0.0,0.01,0.5,0.99,1.0}) EXPECT_EQ(A.quantile(q),B.quantile(q)) << "q=" << q;
+}
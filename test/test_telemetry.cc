@@ -0,0 +1,121 @@
+#include <atomic>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "rdmini/parallel_ssa.h"
+#include "rdmini/rdmodel.h"
+#include "rdmini/telemetry.h"
+
+#include "model_fixtures.h"
+#include "temp_file.h"
+
+using rdmini::telemetry_reader;
+using rdmini::telemetry_writer;
+namespace tf=rdmini::telemetry_format;
+
+TEST(telemetry,round_trip) {
+    temp_file tmp;
+    telemetry_writer W(tmp.path,3,{"x","a_rather_long_observable_name_truncated"},10.0);
+    EXPECT_EQ(3u,W.n_instances());
+    EXPECT_EQ(2u,W.n_observables());
+
+    telemetry_reader R(tmp.path);
+    EXPECT_EQ(3u,R.n_instances());
+    EXPECT_EQ(10.0,R.t_end());
+    ASSERT_EQ(2u,R.n_observables());
+    EXPECT_EQ("x",R.observable_names()[0]);
+    EXPECT_EQ(tf::name_size-1,R.observable_names()[1].size());
+
+    telemetry_reader::snapshot s;
+    ASSERT_TRUE(R.read(0,s));
+    EXPECT_EQ(tf::pending,s.status);
+
+    // published records are visible through an existing mapping
+    std::vector<double> obs={1.5,-2};
+    W.publish(1,tf::running,2.5,17,obs.begin());
+    ASSERT_TRUE(R.read(1,s));
+    EXPECT_EQ(tf::running,s.status);
+    EXPECT_EQ(2.5,s.t);
+    EXPECT_EQ(17u,s.n_events);
+    EXPECT_EQ(obs,s.observables);
+
+    W.publish(1,tf::complete,10,20,obs.rbegin());
+    ASSERT_TRUE(R.read(1,s));
+    EXPECT_EQ(tf::complete,s.status);
+    EXPECT_EQ(20u,s.n_events);
+    EXPECT_EQ((std::vector<double>{-2,1.5}),s.observables);
+}
+
+TEST(telemetry,bad_file) {
+    temp_file tmp;
+    EXPECT_THROW(telemetry_reader R(tmp.path),rdmini::telemetry_error);
+    EXPECT_THROW(telemetry_reader R(tmp.path+".missing"),rdmini::telemetry_error);
+}
+
+// A reader concurrent with a writer sees only whole records.
+
+TEST(telemetry,consistent_reads) {
+    temp_file tmp;
+    const size_t n_obs=6;
+    telemetry_writer W(tmp.path,1,std::vector<std::string>(n_obs,"o"));
+    telemetry_reader R(tmp.path);
+
+    // the writer waits halfway for a first read, so that the reader
+    // overlaps it however the threads are scheduled
+    std::atomic<bool> done(false),read_once(false);
+    std::thread writer([&]() {
+        std::vector<double> obs(n_obs);
+        for (uint64_t n=1; n<=200000; ++n) {
+            obs.assign(n_obs,(double)n);
+            W.publish(0,tf::running,(double)n,n,obs.begin());
+            if (n==100000) while (!read_once) std::this_thread::yield();
+        }
+        done=true;
+    });
+
+    telemetry_reader::snapshot s;
+    size_t n_read=0;
+    while (!done) {
+        if (!R.read(0,s)) continue;
+        ++n_read;
+        read_once=true;
+        EXPECT_EQ(s.t,(double)s.n_events);
+        for (double v: s.observables) EXPECT_EQ(s.t,v);
+    }
+    writer.join();
+
+    ASSERT_TRUE(R.read(0,s));
+    EXPECT_EQ(200000u,s.n_events);
+    EXPECT_LT(0u,n_read);
+}
+
+TEST(telemetry,parallel_ssa_publish) {
+    rdmini::rd_model M=rdmini::rd_model_read(decay_model,"decay");
+    rdmini::parallel_ssa<3> S(2,M);
+
+    temp_file tmp;
+    telemetry_writer W(tmp.path,4,{"twice_A"});
+
+    std::minstd_rand g;
+    S.advance(1,0.5,g);
+    uint64_t n=S.event_count(1);
+    EXPECT_EQ((uint64_t)(50-S.count(1,0,0)),n);
+    EXPECT_EQ(0u,S.event_count(0));
+
+    S.publish(1,W,3);
+
+    telemetry_reader R(tmp.path);
+    telemetry_reader::snapshot s;
+    ASSERT_TRUE(R.read(3,s));
+    EXPECT_EQ(tf::running,s.status);
+    EXPECT_EQ(0.5,s.t);
+    EXPECT_EQ(n,s.n_events);
+    EXPECT_EQ((std::vector<double>{2.0*S.count(1,0,0)}),s.observables);
+
+    S.reset_instance(1,0);
+    EXPECT_EQ(0u,S.event_count(1));
+}
@@ -0,0 +1,73 @@
+#include <sstream>
+#include <string>
+#include <thread>
+
+#include <gtest/gtest.h>
+
+#include "rdmini/timeline.h"
+
+namespace timeline=rdmini::timeline;
+
+size_t count_of(const std::string &s,const std::string &x) {
+    size_t n=0;
+    for (size_t i=s.find(x); i!=std::string::npos; i=s.find(x,i+1)) ++n;
+    return n;
+}
+
+// Tracing state is global: these tests run in order in one process.
+
+TEST(timeline,disabled) {
+    EXPECT_FALSE(timeline::enabled());
+    EXPECT_EQ(0u,timeline::now());
+    {
+        timeline::span _("unseen");
+    }
+
+    std::ostringstream O;
+    timeline::write_chrome_trace(O);
+    EXPECT_EQ(std::string::npos,O.str().find("unseen"));
+}
+
+TEST(timeline,spans) {
+    timeline::enable(4);
+    timeline::name_thread("main");
+
+    {
+        timeline::span _("outer");
+        timeline::span inner("inner",7);
+    }
+    std::thread([]() {
+        timeline::name_thread("other");
+        timeline::span _("elsewhere");
+    }).join();
+
+    std::ostringstream O;
+    timeline::write_chrome_trace(O);
+    std::string trace=O.str();
+
+    EXPECT_EQ(0u,trace.find("{\"displayTimeUnit\":\"ms\",\"traceEvents\":["));
+    EXPECT_NE(std::string::npos,trace.find("\"args\":{\"name\":\"main\"}"));
+    EXPECT_NE(std::string::npos,trace.find("\"args\":{\"name\":\"other\"}"));
+    EXPECT_EQ(1u,count_of(trace,"\"name\":\"outer\",\"ph\":\"X\",\"pid\":0,\"tid\":0,"));
+    EXPECT_EQ(1u,count_of(trace,"\"name\":\"elsewhere\",\"ph\":\"X\",\"pid\":0,\"tid\":1,"));
+    EXPECT_NE(std::string::npos,trace.find("\"args\":{\"instance\":7}"));
+    EXPECT_NE(std::string::npos,trace.find("\"dropped_spans\":0"));
+}
+
+TEST(timeline,ring_overflow) {
+    // this thread's buffer holds 4 spans, of which 2 are used above
+    for (int i=0; i<5; ++i) timeline::span _("repeated");
+
+    std::ostringstream O;
+    timeline::write_chrome_trace(O);
+    std::string trace=O.str();
+
+    EXPECT_EQ(0u,count_of(trace,"\"name\":\"outer\""));
+    EXPECT_EQ(4u,count_of(trace,"\"name\":\"repeated\""));
+    EXPECT_NE(std::string::npos,trace.find("\"dropped_spans\":3"));
+
+    timeline::disable();
+    uint64_t t0=timeline::now();
+    EXPECT_EQ(0u,t0);
+    timeline::record("not recorded",t0);
+}
@@ -0,0 +1,153 @@
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "rdmini/trajectory_file.h"
+
+#include "temp_file.h"
+
+using rdmini::trajectory_encoder;
+using rdmini::trajectory_file;
+
+// sample k of instance i: time k/2, counts (i, k, i+k, -k) over 2 cells x 2 species
+
+static void make_sample(unsigned i,unsigned k,double &t,int counts[4]) {
+    t=0.5*k;
+    counts[0]=i;
+    counts[1]=k;
+    counts[2]=i+k;
+    counts[3]=-(int)k;
+}
+
+static void write_test_file(const std::string &path,unsigned n_instances,unsigned n_samples,size_t chunk_samples,
+                            rdmini::trajectory_format::chunk_encoding encoding=rdmini::trajectory_format::delta)
+{
+    std::ofstream O(path,std::ios::binary);
+    trajectory_encoder E({"A","B"},{"c0","c1"},chunk_samples,encoding,3);
+
+    // interleave instances, as from a parallel run
+    for (unsigned k=0; k<n_samples; ++k) {
+        for (unsigned i=0; i<n_instances; ++i) {
+            double t;
+            int counts[4];
+            make_sample(i,k,t,counts);
+            E.append(O,i,t,counts);
+        }
+    }
+    E.finish(O);
+    EXPECT_EQ((uint64_t)O.tellp(),E.bytes_written());
+}
+
+TEST(trajectory_file,header) {
+    temp_file tmp;
+    write_test_file(tmp.path,3,5,4);
+
+    trajectory_file F(tmp.path);
+    EXPECT_EQ((std::vector<std::string>{"A","B"}),F.species());
+    EXPECT_EQ((std::vector<std::string>{"c0","c1"}),F.cells());
+    EXPECT_EQ(4u,F.width());
+    EXPECT_EQ(15u,F.n_samples());
+    EXPECT_EQ(4u,F.n_chunks());
+    EXPECT_EQ((std::vector<uint64_t>{0,1,2}),F.instances());
+}
+
+TEST(trajectory_file,read_instance) {
+    for (auto encoding: {rdmini::trajectory_format::raw,rdmini::trajectory_format::delta}) {
+        temp_file tmp;
+        write_test_file(tmp.path,3,10,7,encoding);
+
+        trajectory_file F(tmp.path);
+        trajectory_file::sample_columns S;
+        for (unsigned i=0; i<3; ++i) {
+            ASSERT_TRUE(F.read_instance(i,S));
+            ASSERT_EQ(10u,S.size());
+            for (unsigned k=0; k<10; ++k) {
+                double t;
+                int counts[4];
+                make_sample(i,k,t,counts);
+                EXPECT_EQ(i,S.instance[k]);
+                EXPECT_EQ(t,S.t[k]);
+                for (unsigned j=0; j<4; ++j) EXPECT_EQ(counts[j],S.sample_counts(k,4)[j]);
+            }
+        }
+        EXPECT_FALSE(F.read_instance(3,S));
+        EXPECT_EQ(0u,S.size());
+    }
+}
+
+TEST(trajectory_file,read_chunk) {
+    temp_file tmp;
+    write_test_file(tmp.path,2,3,4);
+
+    trajectory_file F(tmp.path);
+    trajectory_file::sample_columns S;
+    F.read_chunk(0,S);
+
+    // first chunk: samples 0,1 of instance 0 and 1, grouped by instance
+    ASSERT_EQ(4u,S.size());
+    EXPECT_EQ((std::vector<uint64_t>{0,0,1,1}),S.instance);
+    EXPECT_EQ((std::vector<double>{0,0.5,0,0.5}),S.t);
+}
+
+TEST(trajectory_file,find) {
+    for (auto encoding: {rdmini::trajectory_format::raw,rdmini::trajectory_format::delta}) {
+        temp_file tmp;
+        write_test_file(tmp.path,4,20,9,encoding);
+
+        trajectory_file F(tmp.path);
+        int counts[4];
+        double t;
+
+        ASSERT_TRUE(F.find(2,3.7,t,counts));
+        EXPECT_EQ(3.5,t);
+        EXPECT_EQ(2,counts[0]);
+        EXPECT_EQ(7,counts[1]);
+
+        ASSERT_TRUE(F.find(1,0,t,counts));
+        EXPECT_EQ(0,t);
+
+        ASSERT_TRUE(F.find(3,100,t,counts));
+        EXPECT_EQ(9.5,t);
+
+        // within a run, away from its keyframe
+        ASSERT_TRUE(F.find(0,8.2,t,counts));
+        EXPECT_EQ(8,t);
+        EXPECT_EQ(16,counts[1]);
+        EXPECT_EQ(-16,counts[3]);
+
+        EXPECT_FALSE(F.find(3,-1,t,counts));
+        EXPECT_FALSE(F.find(4,1,t,counts));
+    }
+}
+
+TEST(trajectory_file,empty) {
+    temp_file tmp;
+    write_test_file(tmp.path,0,0,4);
+
+    trajectory_file F(tmp.path);
+    EXPECT_EQ(0u,F.n_samples());
+    EXPECT_TRUE(F.instances().empty());
+}
+
+TEST(trajectory_file,bad_file) {
+    temp_file tmp;
+    EXPECT_THROW(trajectory_file(tmp.path+".missing"),rdmini::trajectory_io_error);
+
+    {
+        std::ofstream O(tmp.path);
+        O << "instance,time,cell,A\n0,0,0,3\n0,1,0,2\n1,0,0,3\n1,1,0,2\n";
+    }
+    EXPECT_THROW(trajectory_file F(tmp.path),rdmini::trajectory_io_error);
+
+    // truncated: index missing
+    write_test_file(tmp.path,2,10,4);
+    {
+        std::ifstream I(tmp.path,std::ios::binary);
+        std::string data((std::istreambuf_iterator<char>(I)),std::istreambuf_iterator<char>());
+        std::ofstream O(tmp.path,std::ios::binary);
+        O.write(data.data(),data.size()-8);
+    }
+    EXPECT_THROW(trajectory_file F(tmp.path),rdmini::trajectory_io_error);
+}
@@ -0,0 +1,85 @@
+#include <cmath>
+#include <limits>
+#include <random>
+
+#include <gtest/gtest.h>
+
+#include "rdmini/philox.h"
+#include "rdmini/ssa_direct.h"
+#include "rdmini/variates.h"
+
+TEST(variates,fast_log) {
+    std::minstd_rand R;
+    std::uniform_real_distribution<double> U(-700,700);
+
+    // error within a small multiple of machine epsilon, relative to max(1,|log x|)
+    const double tol=4*std::numeric_limits<double>::epsilon();
+    for (int i=0; i<100000; ++i) {
+        double x=std::exp(U(R));
+        double expected=std::log(x);
+        EXPECT_NEAR(expected,rdmini::fast_log(x),tol*std::max(1.0,std::abs(expected)));
+    }
+
+    for (double x: {1.0,2.0,0.5,std::sqrt(2.0),1.0/9007199254740992.0,std::numeric_limits<double>::max()}) {
+        double expected=std::log(x);
+        EXPECT_NEAR(expected,rdmini::fast_log(x),tol*std::max(1.0,std::abs(expected)));
+    }
+    EXPECT_EQ(0.0,rdmini::fast_log(1.0));
+}
+
+template <typename G>
+void check_moments(rdmini::buffered_variates<G> &V) {
+    const int n=200000;
+    double su=0,se=0,se2=0;
+    for (int i=0; i<n; ++i) {
+        double u=V.uniform();
+        ASSERT_TRUE(u>=0 && u<1);
+        su+=u;
+
+        double e=V.exponential();
+        ASSERT_TRUE(e>=0 && std::isfinite(e));
+        se+=e;
+        se2+=e*e;
+    }
+
+    EXPECT_NEAR(0.5,su/n,0.005);
+    EXPECT_NEAR(1.0,se/n,0.01);
+    EXPECT_NEAR(1.0,se2/n-(se/n)*(se/n),0.03);
+}
+
+TEST(variates,bulk_moments) {
+    static_assert(rdmini::has_bulk_generate<rdmini::philox_engine>::value,"philox_engine supports bulk generation");
+
+    rdmini::buffered_variates<rdmini::philox_engine> V(rdmini::philox_engine(11));
+    check_moments(V);
+}
+
+TEST(variates,generic_moments) {
+    static_assert(!rdmini::has_bulk_generate<std::minstd_rand>::value,"minstd_rand has no bulk generation");
+
+    rdmini::buffered_variates<std::minstd_rand> V;
+    check_moments(V);
+}
+
+TEST(variates,ssa_direct) {
+    rdmini::ssa_direct<size_t,double> ssa(3);
+    ssa.update(0,1.0);
+    ssa.update(1,2.0);
+    ssa.update(2,5.0);
+
+    rdmini::buffered_variates<rdmini::philox_engine> V(rdmini::philox_engine(3));
+
+    const int n=200000;
+    int count[3]={0,0,0};
+    double dt_sum=0;
+    for (int i=0; i<n; ++i) {
+        auto ev=ssa.next(V);
+        ++count[ev.key()];
+        dt_sum+=ev.dt();
+    }
+
+    EXPECT_NEAR(1.0/8,(double)count[0]/n,0.005);
+    EXPECT_NEAR(2.0/8,(double)count[1]/n,0.005);
+    EXPECT_NEAR(5.0/8,(double)count[2]/n,0.005);
+    EXPECT_NEAR(1.0/8,dt_sum/n,0.002);
+}
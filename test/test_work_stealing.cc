@@ -0,0 +1,57 @@
+#include <atomic>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "rdmini/util/work_stealing.h"
+
+struct counted_task {
+    size_t id;
+    size_t pieces_left;
+};
+
+TEST(work_stealing,deques) {
+    rdmini::work_stealing_deques<int> D(2);
+    for (int i=0; i<4; ++i) D.push(0,i);
+
+    int x;
+    // owner takes from the back
+    ASSERT_TRUE(D.take(0,x));
+    EXPECT_EQ(3,x);
+
+    // thief takes from the front
+    ASSERT_TRUE(D.take(1,x));
+    EXPECT_EQ(0,x);
+
+    ASSERT_TRUE(D.take(1,x));
+    ASSERT_TRUE(D.take(1,x));
+    EXPECT_FALSE(D.take(0,x));
+    EXPECT_FALSE(D.take(1,x));
+}
+
+TEST(work_stealing,run_to_completion) {
+    constexpr size_t n=200;
+    std::vector<counted_task> tasks;
+    for (size_t i=0; i<n; ++i) tasks.push_back(counted_task{i,1+(i*7)%23});
+
+    // record the order of pieces run for each task
+    std::vector<std::vector<size_t>> pieces(n);
+    std::vector<std::atomic<int>> running(n);
+    for (auto &r: running) r=0;
+    std::atomic<bool> overlap(false);
+
+    rdmini::run_work_stealing(tasks,
+        [&](counted_task &t,size_t) {
+            if (running[t.id]++) overlap=true;
+            pieces[t.id].push_back(t.pieces_left);
+            --running[t.id];
+            return --t.pieces_left>0;
+        });
+
+    EXPECT_FALSE(overlap);
+    for (size_t i=0; i<n; ++i) {
+        size_t k=tasks[i].pieces_left;
+        ASSERT_EQ(k,pieces[i].size());
+        for (size_t j=0; j<k; ++j) EXPECT_EQ(k-j,pieces[i][j]);
+    }
+}